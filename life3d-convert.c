@@ -0,0 +1,860 @@
+/************************************************** INFO **************************************************/
+/**
+ * \brief		Converter between the text and the binary formats of the cells of the 3D version
+ *				of the Game of Life by John Conway, for the Parallel and Distributed Computing course
+ *				at IST 16/17 2nd Semester taught by Professor José Monteiro and Professor Luís Guerra e Silva
+ *
+ *				Text files are either input files, with the size of the cube in the first line, or
+ *				output files, with only the cells. Binary files start with a header with the size,
+ *				the generation and the number of cells, followed by the sorted keys of the cells,
+ *				((x * size) + y) * size + z, either as 8 byte little endian integers or, with the
+ *				delta flag, as varints with the difference to the previous key
+ *
+ * \author		Group 				#25
+ * \author		André Mendes		#66943
+ * \author		Nuno Venturinha		#67682
+ * \author		Daniel Sousa		#79129
+ * \version		1.0
+ * \date 		18/10/2026
+ */
+/************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/************************************************** DEFINE **************************************************/
+/************************************************** CONSTANTS **************************************************/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define RADIX_BITS 			16		/** \def 	Number of bits sorted by each radix sort pass 	*/
+
+/************************************************** PROTOTYPES **************************************************/
+struct 				input;
+struct 				output;
+void 				alloc_check 				(void *ptr);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+void 				cells_sort 					(uint64_t *cells, uint64_t *buffer, size_t count, int size);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int flags, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_write 				(int fd, char *data, size_t length);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, char **output_filename,
+													int *flags, int *size, uint64_t *generation, int *print_size);
+uint64_t * 			read_text 					(struct input *input, size_t *count, int *size);
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
+
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text or keys not written yet 						*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	uint64_t 		key; 				/**<	Last key written, for the delta encoding 					*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			fd; 				/**<	File descriptor where the output is written 				*/
+	int 			flags; 				/**<	Flags written in the header of the binary format 			*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** ALLOC_CHECK **************************************************/
+/**
+ * Checks if a given memory allocation was successful
+ *
+ * @param ptr		Pointer to the memory that was allocated
+ */
+void alloc_check(void *ptr)
+{
+	if(ptr == NULL)
+	{
+		fprintf(stderr, "Error with memory allocation\n");
+		abort();
+	}
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** CELLS_SORT **************************************************/
+/**
+ * Sorts the keys of the cells, which orders them by x, then y and then z,
+ * with a LSD radix sort that only goes over the bits the keys can use
+ *
+ * @param cells 	Keys of the cells
+ * @param buffer 	Buffer with room for count keys
+ * @param count 	Number of cells
+ * @param size 		Size of the sides of the cube
+ */
+void cells_sort(uint64_t *cells, uint64_t *buffer, size_t count, int size)
+{
+	uint64_t 	*from 		= NULL; 	/**< 	Keys sorted up to the previous pass 	*/
+	uint64_t 	*to 		= NULL; 	/**< 	Keys sorted up to the current pass 		*/
+	uint64_t 	*aux 		= NULL; 	/**< 	Auxilliary pointer 						*/
+	uint64_t 	largest 	= 0; 		/**< 	Largest key of the cube 				*/
+	size_t 		*offsets 	= NULL; 	/**< 	Position of each digit in the output 	*/
+	size_t 		i 			= 0; 		/**< 	Index of the cell 						*/
+	size_t 		tmp 		= 0; 		/**< 	Temporary variable to swap the offsets 	*/
+	size_t 		total 		= 0; 		/**< 	Running sum of the offsets 				*/
+	int 		digit 		= 0; 		/**< 	Value of the digit 						*/
+	int 		shift 		= 0; 		/**< 	Position of the digit in the keys 		*/
+
+	offsets = (size_t *) calloc(1 << RADIX_BITS, sizeof(size_t));
+	alloc_check(offsets);
+
+	largest = (uint64_t) size * size * size - 1;
+	from = cells;
+	to = buffer;
+	for(shift = 0; (shift < 64) && ((largest >> shift) != 0); shift += RADIX_BITS)
+	{
+		memset(offsets, 0, (1 << RADIX_BITS) * sizeof(size_t));
+		for(i = 0; i < count; i++)
+		{
+			offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++;
+		}
+		total = 0;
+		for(digit = 0; digit < (1 << RADIX_BITS); digit++)
+		{
+			tmp = offsets[digit];
+			offsets[digit] = total;
+			total += tmp;
+		}
+		for(i = 0; i < count; i++)
+		{
+			to[offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++] = from[i];
+		}
+		aux = from;
+		from = to;
+		to = aux;
+	}
+	/* An odd number of passes leaves the result in the buffer */
+	if(from != cells)
+	{
+		memcpy(cells, from, count * sizeof(uint64_t));
+	}
+
+	free(offsets);
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
+	{
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
+		{
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
+		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output or, in the binary format,
+ * writes its key, either as is or as a varint with the difference to the previous key
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	unsigned char 	*bytes 	= NULL; 	/**< 	Where to write the next byte of the key 	*/
+	char 			*ptr 	= NULL; 	/**< 	Where to format the next character 			*/
+	uint64_t 		delta 	= 0; 		/**< 	Difference to the previous key 				*/
+	uint64_t 		key 	= 0; 		/**< 	Key of the cell 							*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		key = ((uint64_t) x * output->size + y) * output->size + z;
+		bytes = (unsigned char *) &(output->buffer[output->length]);
+		if(output->flags & BINARY_DELTA)
+		{
+			delta = key - output->key;
+			while(delta >= 0x80)
+			{
+				*(bytes++) = (unsigned char) (delta | 0x80);
+				delta >>= 7;
+			}
+			*(bytes++) = (unsigned char) delta;
+		}
+		else
+		{
+			binary_put(bytes, key, 8);
+			bytes += 8;
+		}
+		output->key = key;
+		output->length = (char *) bytes - output->buffer;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
+ * @param flags 	Flags of the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int flags, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->flags = flags;
+	output->generation = generation;
+	output->key = 0;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], output->flags, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** READ_ARGUMENTS **************************************************/
+/**
+ * Checks if the arguments given to the program are valid
+ *
+ * @param argc 				Number of arguments
+ * @param argv 				Arguments
+ * @param input_filename 	Name of the input file
+ * @param output_filename 	Name of the output file, - for stdout
+ * @param flags 			Flags of the binary format to write
+ * @param size 				Size of the cube given in the arguments, 0 if none
+ * @param generation 		Generation given in the arguments
+ * @param print_size 		Whether to write the size of the cube as the first line of text files
+ */
+void read_arguments(int argc, char *argv[], char **input_filename, char **output_filename,
+						int *flags, int *size, uint64_t *generation, int *print_size)
+{
+	int 	i 	= 0;
+
+	if(argc < 3)
+	{
+		fprintf(stderr, "Program is run with ./life3d-convert [input-file] [output-file] [--delta] [--size n] [--generation n] [--no-size]\n");
+		exit(-1);
+	}
+
+	(*input_filename) = argv[1];
+	(*output_filename) = argv[2];
+	(*flags) = 0;
+	(*size) = 0;
+	(*generation) = 0;
+	(*print_size) = 1;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--delta") == 0)
+		{
+			(*flags) |= BINARY_DELTA;
+		}
+		else if(strcmp(argv[i], "--no-size") == 0)
+		{
+			(*print_size) = 0;
+		}
+		else if((strcmp(argv[i], "--size") == 0) && (i + 1 < argc))
+		{
+			(*size) = atoi(argv[++i]);
+			if(((*size) <= 0) || ((*size) > BINARY_MAX_SIZE))
+			{
+				fprintf(stderr, "The size of the cube must be between 1 and %d\n", BINARY_MAX_SIZE);
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--generation") == 0) && (i + 1 < argc))
+		{
+			(*generation) = strtoull(argv[++i], NULL, 10);
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+}
+
+/************************************************** READ_TEXT **************************************************/
+/**
+ * Reads a text file and returns the keys of its cells, in the order of the file.
+ * Input files start with a line with the size of the cube, output files
+ * only have cells so their size must be given in the arguments
+ *
+ * @param input 			Mapped input file
+ * @param count 			Number of cells read
+ * @param size 				Size of the sides of the cube, given in the arguments or 0
+ * @return 					Keys of the cells
+ */
+uint64_t * read_text(struct input *input, size_t *count, int *size)
+{
+	uint64_t 	*cells 			= NULL; 			/**< 	Keys of the cells read 				*/
+	char 		*next 			= NULL; 			/**< 	Start of the next line 				*/
+	int 		coordinates[3] 	= {0}; 				/**< 	Coordinates of the current line 	*/
+
+	/* A first line with a single integer is the size of the cube */
+	if((input->cursor < input->end) && (input_scan(input->cursor, input->end, coordinates, 3) == NULL))
+	{
+		next = input_scan(input->cursor, input->end, coordinates, 1);
+		if(next == NULL)
+		{
+			input_error(input, input->cursor);
+		}
+		if((*size) == 0)
+		{
+			(*size) = coordinates[0];
+		}
+		input->cursor = next;
+	}
+	if(((*size) <= 0) || ((*size) > BINARY_MAX_SIZE))
+	{
+		fprintf(stderr, "The size of the cube must be given with --size and be between 1 and %d\n", BINARY_MAX_SIZE);
+		exit(-1);
+	}
+
+	/* Every line takes at least 6 bytes, so the length of the file bounds the number of cells */
+	cells = (uint64_t *) malloc(((input->end - input->cursor) / 6 + 1) * sizeof(uint64_t));
+	alloc_check(cells);
+
+	(*count) = 0;
+	while(input->cursor < input->end)
+	{
+		next = input_scan(input->cursor, input->end, coordinates, 3);
+		if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= (*size)) || (coordinates[1] < 0) || (coordinates[1] >= (*size)) || (coordinates[2] < 0) || (coordinates[2] >= (*size)))
+		{
+			input_error(input, input->cursor);
+		}
+		cells[(*count)++] = ((uint64_t) coordinates[0] * (*size) + coordinates[1]) * (*size) + coordinates[2];
+		input->cursor = next;
+	}
+
+	return cells;
+}
+
+/************************************************** MAIN **************************************************/
+int main(int argc, char *argv[])
+{
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer 								*/
+	uint64_t 		*buffer 			= NULL; 	/**< 	Buffer for the radix sort 					*/
+	uint64_t 		*cells 				= NULL; 	/**< 	Keys of the cells of a text file 			*/
+	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	char 			*output_filename 	= NULL; 	/**< 	Name of the output file 					*/
+	char 			header[16] 			= {0}; 		/**< 	First line of the text format 				*/
+	uint64_t 		generation 			= 0; 		/**< 	Generation given in the arguments 			*/
+	uint64_t 		i 					= 0; 		/**< 	Index of the cell 							*/
+	size_t 			count 				= 0; 		/**< 	Number of cells 							*/
+	size_t 			unique 				= 0; 		/**< 	Number of cells without repetitions 		*/
+	int 			coordinates[3] 		= {0}; 		/**< 	Coordinates of a cell 						*/
+	int 			fd 					= 0; 		/**< 	File descriptor of the output file 			*/
+	int 			flags 				= 0; 		/**< 	Flags of the binary format to write 		*/
+	int 			print_size 			= 0; 		/**< 	Whether to write the size in text files 	*/
+	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
+
+	/* Read the arguments given to the program */
+	read_arguments(argc, argv, &input_filename, &output_filename, &flags, &size, &generation, &print_size);
+	input = input_map(input_filename);
+	if(strcmp(output_filename, "-") == 0)
+	{
+		fd = STDOUT_FILENO;
+	}
+	else
+	{
+		fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+		{
+			fprintf(stderr, "Error opening the output file\n");
+			exit(-1);
+		}
+	}
+
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
+	{
+		/* Binary to text, the keys are already sorted */
+		size = binary_read_header(input);
+		output = output_create(fd, 0, 0, size, 0);
+		if(print_size)
+		{
+			output_write(fd, header, sprintf(header, "%d\n", size));
+		}
+		for(i = 0; i < input->count; i++)
+		{
+			binary_read_cell(input, coordinates, size);
+			output_cell(output, coordinates[0], coordinates[1], coordinates[2]);
+		}
+	}
+	else
+	{
+		/* Text to binary, sorting the keys and removing the repeated ones */
+		cells = read_text(input, &count, &size);
+		buffer = (uint64_t *) malloc((count + 1) * sizeof(uint64_t));
+		alloc_check(buffer);
+		cells_sort(cells, buffer, count, size);
+		for(i = 0; i < count; i++)
+		{
+			if((unique == 0) || (cells[i] != cells[unique - 1]))
+			{
+				cells[unique++] = cells[i];
+			}
+		}
+
+		output = output_create(fd, 1, flags, size, generation);
+		output_header(output, unique);
+		for(i = 0; i < unique; i++)
+		{
+			binary_split(cells[i], coordinates, size);
+			output_cell(output, coordinates[0], coordinates[1], coordinates[2]);
+		}
+		free(cells);
+		free(buffer);
+	}
+
+	output_destroy(output);
+	input_unmap(input);
+	if(fd != STDOUT_FILENO)
+	{
+		close(fd);
+	}
+
+	return 0;
+}
@@ -0,0 +1,1181 @@
+/************************************************** INFO **************************************************/
+/**
+ * \brief		Bit-packed implementation of a 3D version of the Game of Life by John Conway
+ *				for the Parallel and Distributed Computing course at IST 16/17 2nd Semester
+ *				taught by Professor José Monteiro and Professor Luís Guerra e Silva
+ *
+ *				Meant for dense cubes, where the lists of the other versions are mostly overhead.
+ *				Every cell is a single bit and the z-coordinates of each [x][y] column are packed
+ *				in 64-bit words, so the 6 neighbors of 64 cells are counted at once with bit-sliced
+ *				adders and the rule is applied as boolean logic (vectorized with AVX2/SSE2 when available)
+ *
+ * \author		Group 				#25
+ * \author		André Mendes		#66943
+ * \author		Nuno Venturinha		#67682
+ * \author		Daniel Sousa		#79129
+ * \version		1.0
+ * \date 		18/10/2026
+ */
+/************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/************************************************** DEFINE **************************************************/
+/************************************************** CONSTANTS **************************************************/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define RULE_DEFAULT 		0x1c0c	/** \def 	Lookup table of the rule B23/S234 				*/
+#define WORD_BITS 			64		/** \def 	Number of cells packed in each word 			*/
+
+/************************************************** OPERATORS **************************************************/
+#define MOD(a, b) 			(((a) < 0) ? ((a) % (b) + (b)) : ((a) % (b)))
+#define RULE_NEXT(rule, alive, count) 	(((rule) >> (((alive) << 3) | (count))) & 1)
+#define WORDS(size) 		(((size) + WORD_BITS - 1) / WORD_BITS)
+
+/************************************************** PROTOTYPES **************************************************/
+struct 				input;
+struct 				output;
+void 				alloc_check 				(void *ptr);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+void 				column_shift 				(uint64_t *column, uint64_t *above, uint64_t *below, int size, int words);
+uint64_t * 			cube_create 				(int size);
+void 				cube_print 					(struct output *output, uint64_t *cube, int size);
+void 				determine_next_generation 	(uint64_t *cube, uint64_t *next, uint64_t *above, uint64_t *below, int size, int rule);
+void 				generation_kernel 			(uint64_t *next, uint64_t *alive, uint64_t *x_prev, uint64_t *x_next,
+													uint64_t *y_prev, uint64_t *y_next, uint64_t *above, uint64_t *below, int length, int rule);
+void 				generation_kernel_rule 		(uint64_t *next, uint64_t *alive, uint64_t *x_prev, uint64_t *x_next,
+													uint64_t *y_prev, uint64_t *y_next, uint64_t *above, uint64_t *below, int length, int rule);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_write 				(int fd, char *data, size_t length);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *rule);
+void 				read_coordinates 			(struct input *input, uint64_t *cube, int size);
+int 				read_rule 					(char *text);
+int 				read_size 					(struct input *input);
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
+
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text not written yet 								*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	int 			fd; 				/**<	File descriptor where the text is written 					*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** ALLOC_CHECK **************************************************/
+/**
+ * Checks if a given memory allocation was successful
+ *
+ * @param ptr		Pointer to the memory that was allocated
+ */
+void alloc_check(void *ptr)
+{
+	if(ptr == NULL)
+	{
+		fprintf(stderr, "Error with memory allocation\n");
+		abort();
+	}
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** COLUMN_SHIFT **************************************************/
+/**
+ * Shifts the cells of a column by one in z, wrapping around the ends of the cube,
+ * so that bit z of above holds the cell at z+1 and bit z of below holds the cell at z-1
+ *
+ * @param column 	Words of the column
+ * @param above 	Words where to store the cells at z+1
+ * @param below 	Words where to store the cells at z-1
+ * @param size 		Size of the sides of the cube
+ * @param words 	Number of words of each column
+ */
+void column_shift(uint64_t *column, uint64_t *above, uint64_t *below, int size, int words)
+{
+	uint64_t 	last 	= 0; 		/**< 	Bit of the cell at z=size-1 			*/
+	uint64_t 	first 	= 0; 		/**< 	Bit of the cell at z=0 					*/
+	int 		w 		= 0; 		/**< 	Index of the word 						*/
+
+	first = column[0] & 1;
+	last = (column[words - 1] >> ((size - 1) % WORD_BITS)) & 1;
+
+	for(w = 0; w < (words - 1); w++)
+	{
+		above[w] = (column[w] >> 1) | (column[w+1] << (WORD_BITS - 1));
+	}
+	above[words - 1] = (column[words - 1] >> 1) | (first << ((size - 1) % WORD_BITS));
+
+	below[0] = (column[0] << 1) | last;
+	for(w = 1; w < words; w++)
+	{
+		below[w] = (column[w] << 1) | (column[w-1] >> (WORD_BITS - 1));
+	}
+	/* The cell at size-1 was shifted past the end of the cube */
+	if((size % WORD_BITS) != 0)
+	{
+		below[words - 1] &= (((uint64_t) 1) << (size % WORD_BITS)) - 1;
+	}
+}
+
+/************************************************** CUBE_CREATE **************************************************/
+/**
+ * Creates a size by size by size cube of bits with all the cells dead and returns it.
+ * Column [x][y] starts at word (x * size + y) * WORDS(size)
+ *
+ * @param size 		Size of the sides of the cube
+ * @return 			Cube
+ */
+uint64_t * cube_create(int size)
+{
+	uint64_t 	*cube 	= NULL;
+
+	cube = (uint64_t *) calloc((size_t) size * size * WORDS(size), sizeof(uint64_t));
+	alloc_check(cube);
+
+	return cube;
+}
+
+/************************************************** CUBE_PRINT **************************************************/
+/**
+ * Prints the solution of the problem to the given output.
+ * In the binary format the alive cells are counted first, one word at a time
+ *
+ * @param output 	Output buffer
+ * @param cube 		Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ */
+void cube_print(struct output *output, uint64_t *cube, int size)
+{
+	uint64_t 		*column 	= NULL; 	/**< 	Words of the column being printed 	*/
+	uint64_t 		count 		= 0; 		/**< 	Number of alive cells 				*/
+	uint64_t 		word 		= 0; 		/**< 	Cells not yet printed of a word 	*/
+	size_t 			i 			= 0; 		/**< 	Index of the word in the cube 		*/
+	int 			w 			= 0; 		/**< 	Index of the word 					*/
+	int 			words 		= 0; 		/**< 	Number of words of each column 		*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 						*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 						*/
+
+	words = WORDS(size);
+	if(output->binary)
+	{
+		for(i = 0; i < (size_t) size * size * words; i++)
+		{
+			count += __builtin_popcountll(cube[i]);
+		}
+		output_header(output, count);
+	}
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &cube[((size_t) x * size + y) * words];
+			for(w = 0; w < words; w++)
+			{
+				word = column[w];
+				while(word != 0)
+				{
+					output_cell(output, x, y, (w * WORD_BITS) + __builtin_ctzll(word));
+					/* Clear the lowest bit set */
+					word &= word - 1;
+				}
+			}
+		}
+	}
+}
+
+/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
+/**
+ * Computes the next generation of the whole cube, one x-slice at a time.
+ * The columns of each slice are contiguous, so the neighbors in y are the same
+ * slice offset by one column, except for the first and last columns that wrap around
+ *
+ * @param cube 		Structure that contains the cells
+ * @param next 		Structure where to store the next generation
+ * @param above 	Buffer with room for a slice, used for the cells at z+1
+ * @param below 	Buffer with room for a slice, used for the cells at z-1
+ * @param size 		Size of the sides of the cube
+ * @param rule 		Lookup table of the rule
+ */
+void determine_next_generation(uint64_t *cube, uint64_t *next, uint64_t *above, uint64_t *below, int size, int rule)
+{
+	uint64_t 	*slice 		= NULL; 	/**< 	Slice being processed 						*/
+	uint64_t 	*x_prev 	= NULL; 	/**< 	Slice with the previous x-coordinate 		*/
+	uint64_t 	*x_next 	= NULL; 	/**< 	Slice with the next x-coordinate 			*/
+	uint64_t 	*out 		= NULL; 	/**< 	Slice of the next generation 				*/
+	size_t 		slice_size 	= 0; 		/**< 	Number of words of each slice 				*/
+	int 		last 		= 0; 		/**< 	Offset of the last column of a slice 		*/
+	int 		words 		= 0; 		/**< 	Number of words of each column 				*/
+	int 		x 			= 0; 		/**< 	x-Coordinate 								*/
+	int 		y 			= 0; 		/**< 	y-Coordinate 								*/
+
+	words = WORDS(size);
+	slice_size = (size_t) size * words;
+	last = (size - 1) * words;
+
+	for(x = 0; x < size; x++)
+	{
+		slice = &cube[x * slice_size];
+		x_prev = &cube[MOD((x-1), size) * slice_size];
+		x_next = &cube[MOD((x+1), size) * slice_size];
+		out = &next[x * slice_size];
+
+		for(y = 0; y < size; y++)
+		{
+			column_shift(&slice[y * words], &above[y * words], &below[y * words], size, words);
+		}
+
+		if(size == 1)
+		{
+			generation_kernel(out, slice, x_prev, x_next, slice, slice, above, below, words, rule);
+		}
+		else
+		{
+			/* First column, its previous neighbor in y is the last one */
+			generation_kernel(out, slice, x_prev, x_next, &slice[last], &slice[words], above, below, words, rule);
+			/* Inner columns */
+			generation_kernel(&out[words], &slice[words], &x_prev[words], &x_next[words], slice, &slice[2 * words],
+								&above[words], &below[words], last - words, rule);
+			/* Last column, its next neighbor in y is the first one */
+			generation_kernel(&out[last], &slice[last], &x_prev[last], &x_next[last], &slice[last - words], slice,
+								&above[last], &below[last], words, rule);
+		}
+
+		/* Rules with B0 bring to life the bits past the end of the columns, which are not cells */
+		if(((size % WORD_BITS) != 0) && RULE_NEXT(rule, 0, 0))
+		{
+			for(y = 0; y < size; y++)
+			{
+				out[y * words + words - 1] &= (((uint64_t) 1) << (size % WORD_BITS)) - 1;
+			}
+		}
+	}
+}
+
+/************************************************** GENERATION_KERNEL **************************************************/
+/**
+ * Applies the rules of the game to a sequence of words, 64 cells at a time.
+ * The 6 neighbors are added with bit-sliced full adders into a 3-bit count (b2 b1 b0)
+ * and the cell is alive in the next generation if it was alive with 2 to 4 neighbors
+ * or dead with 2 or 3 neighbors, that is (~b2 & b1) | (alive & b2 & ~b1 & ~b0).
+ * This is the default rule B23/S234 written out, any other rule is handed to generation_kernel_rule
+ *
+ * @param next 		Words of the next generation
+ * @param alive 	Words of the current generation
+ * @param x_prev 	Neighbors at x-1
+ * @param x_next 	Neighbors at x+1
+ * @param y_prev 	Neighbors at y-1
+ * @param y_next 	Neighbors at y+1
+ * @param above 	Neighbors at z+1
+ * @param below 	Neighbors at z-1
+ * @param length 	Number of words to process
+ * @param rule 		Lookup table of the rule
+ */
+void generation_kernel(uint64_t *next, uint64_t *alive, uint64_t *x_prev, uint64_t *x_next,
+						uint64_t *y_prev, uint64_t *y_next, uint64_t *above, uint64_t *below, int length, int rule)
+{
+	uint64_t 	s0 	= 0;
+	uint64_t 	s1 	= 0;
+	uint64_t 	c0 	= 0;
+	uint64_t 	c1 	= 0;
+	uint64_t 	c2 	= 0;
+	uint64_t 	b0 	= 0;
+	uint64_t 	b1 	= 0;
+	uint64_t 	b2 	= 0;
+	int 		i 	= 0;
+
+	if(rule != RULE_DEFAULT)
+	{
+		generation_kernel_rule(next, alive, x_prev, x_next, y_prev, y_next, above, below, length, rule);
+		return;
+	}
+
+#if defined(__AVX2__)
+	__m256i 	a 	= _mm256_setzero_si256();
+	__m256i 	b 	= _mm256_setzero_si256();
+	__m256i 	c 	= _mm256_setzero_si256();
+	__m256i 	d 	= _mm256_setzero_si256();
+	__m256i 	e 	= _mm256_setzero_si256();
+	__m256i 	f 	= _mm256_setzero_si256();
+	__m256i 	v0 	= _mm256_setzero_si256();
+	__m256i 	v1 	= _mm256_setzero_si256();
+	__m256i 	v2 	= _mm256_setzero_si256();
+
+	for(; (i + 4) <= length; i += 4)
+	{
+		a = _mm256_loadu_si256((__m256i *) &x_prev[i]);
+		b = _mm256_loadu_si256((__m256i *) &x_next[i]);
+		c = _mm256_loadu_si256((__m256i *) &y_prev[i]);
+		d = _mm256_loadu_si256((__m256i *) &y_next[i]);
+		e = _mm256_loadu_si256((__m256i *) &above[i]);
+		f = _mm256_loadu_si256((__m256i *) &below[i]);
+		/* Two full adders over (a, b, c) and (d, e, f) */
+		v0 = _mm256_xor_si256(a, b);
+		v1 = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, v0));
+		v0 = _mm256_xor_si256(v0, c);
+		v2 = _mm256_xor_si256(d, e);
+		a = _mm256_or_si256(_mm256_and_si256(d, e), _mm256_and_si256(f, v2));
+		v2 = _mm256_xor_si256(v2, f);
+		/* Add the two sums and then the three carries of weight 2 */
+		b = _mm256_and_si256(v0, v2);
+		v0 = _mm256_xor_si256(v0, v2);
+		c = _mm256_xor_si256(v1, a);
+		v2 = _mm256_or_si256(_mm256_and_si256(v1, a), _mm256_and_si256(b, c));
+		v1 = _mm256_xor_si256(c, b);
+		/* Apply the rule */
+		d = _mm256_loadu_si256((__m256i *) &alive[i]);
+		e = _mm256_andnot_si256(v2, v1);
+		f = _mm256_and_si256(d, _mm256_andnot_si256(_mm256_or_si256(v1, v0), v2));
+		_mm256_storeu_si256((__m256i *) &next[i], _mm256_or_si256(e, f));
+	}
+#elif defined(__SSE2__)
+	__m128i 	a 	= _mm_setzero_si128();
+	__m128i 	b 	= _mm_setzero_si128();
+	__m128i 	c 	= _mm_setzero_si128();
+	__m128i 	d 	= _mm_setzero_si128();
+	__m128i 	e 	= _mm_setzero_si128();
+	__m128i 	f 	= _mm_setzero_si128();
+	__m128i 	v0 	= _mm_setzero_si128();
+	__m128i 	v1 	= _mm_setzero_si128();
+	__m128i 	v2 	= _mm_setzero_si128();
+
+	for(; (i + 2) <= length; i += 2)
+	{
+		a = _mm_loadu_si128((__m128i *) &x_prev[i]);
+		b = _mm_loadu_si128((__m128i *) &x_next[i]);
+		c = _mm_loadu_si128((__m128i *) &y_prev[i]);
+		d = _mm_loadu_si128((__m128i *) &y_next[i]);
+		e = _mm_loadu_si128((__m128i *) &above[i]);
+		f = _mm_loadu_si128((__m128i *) &below[i]);
+		/* Two full adders over (a, b, c) and (d, e, f) */
+		v0 = _mm_xor_si128(a, b);
+		v1 = _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, v0));
+		v0 = _mm_xor_si128(v0, c);
+		v2 = _mm_xor_si128(d, e);
+		a = _mm_or_si128(_mm_and_si128(d, e), _mm_and_si128(f, v2));
+		v2 = _mm_xor_si128(v2, f);
+		/* Add the two sums and then the three carries of weight 2 */
+		b = _mm_and_si128(v0, v2);
+		v0 = _mm_xor_si128(v0, v2);
+		c = _mm_xor_si128(v1, a);
+		v2 = _mm_or_si128(_mm_and_si128(v1, a), _mm_and_si128(b, c));
+		v1 = _mm_xor_si128(c, b);
+		/* Apply the rule */
+		d = _mm_loadu_si128((__m128i *) &alive[i]);
+		e = _mm_andnot_si128(v2, v1);
+		f = _mm_and_si128(d, _mm_andnot_si128(_mm_or_si128(v1, v0), v2));
+		_mm_storeu_si128((__m128i *) &next[i], _mm_or_si128(e, f));
+	}
+#endif
+
+	/* Remaining words, or all of them when no vector instructions are available */
+	for(; i < length; i++)
+	{
+		/* Two full adders over the neighbors in x and y and over the neighbors in z */
+		s0 = x_prev[i] ^ x_next[i] ^ y_prev[i];
+		c0 = (x_prev[i] & x_next[i]) | (y_prev[i] & (x_prev[i] ^ x_next[i]));
+		s1 = y_next[i] ^ above[i] ^ below[i];
+		c1 = (y_next[i] & above[i]) | (below[i] & (y_next[i] ^ above[i]));
+		/* Add the two sums and then the three carries of weight 2 */
+		b0 = s0 ^ s1;
+		c2 = s0 & s1;
+		b1 = c0 ^ c1 ^ c2;
+		b2 = (c0 & c1) | (c2 & (c0 ^ c1));
+		/* Apply the rule */
+		next[i] = (~b2 & b1) | (alive[i] & b2 & ~b1 & ~b0);
+	}
+}
+
+/************************************************** GENERATION_KERNEL_RULE **************************************************/
+/**
+ * Applies any rule to a sequence of words, 64 cells at a time. The neighbors are counted with
+ * the same bit-sliced adders as generation_kernel, and the lookup table of the rule, spread to
+ * a word of all ones or all zeros per entry, is indexed with a tree of bitwise multiplexers
+ * over b0, b1, b2 and the state of the cells, so every cell gets its own entry without branches
+ *
+ * @param next 		Words of the next generation
+ * @param alive 	Words of the current generation
+ * @param x_prev 	Neighbors at x-1
+ * @param x_next 	Neighbors at x+1
+ * @param y_prev 	Neighbors at y-1
+ * @param y_next 	Neighbors at y+1
+ * @param above 	Neighbors at z+1
+ * @param below 	Neighbors at z-1
+ * @param length 	Number of words to process
+ * @param rule 		Lookup table of the rule
+ */
+void generation_kernel_rule(uint64_t *next, uint64_t *alive, uint64_t *x_prev, uint64_t *x_next,
+						uint64_t *y_prev, uint64_t *y_next, uint64_t *above, uint64_t *below, int length, int rule)
+{
+	uint64_t 	table[16] 	= {0}; 		/**< 	Entries of the lookup table spread to whole words 	*/
+	uint64_t 	entries[8] 	= {0}; 		/**< 	Entries left after each level of the tree 			*/
+	uint64_t 	s0 			= 0;
+	uint64_t 	s1 			= 0;
+	uint64_t 	c0 			= 0;
+	uint64_t 	c1 			= 0;
+	uint64_t 	c2 			= 0;
+	uint64_t 	b0 			= 0;
+	uint64_t 	b1 			= 0;
+	uint64_t 	b2 			= 0;
+	int 		i 			= 0;
+	int 		k 			= 0;
+
+	for(k = 0; k < 16; k++)
+	{
+		table[k] = -((uint64_t) ((rule >> k) & 1));
+	}
+
+	for(i = 0; i < length; i++)
+	{
+		/* Two full adders over the neighbors in x and y and over the neighbors in z */
+		s0 = x_prev[i] ^ x_next[i] ^ y_prev[i];
+		c0 = (x_prev[i] & x_next[i]) | (y_prev[i] & (x_prev[i] ^ x_next[i]));
+		s1 = y_next[i] ^ above[i] ^ below[i];
+		c1 = (y_next[i] & above[i]) | (below[i] & (y_next[i] ^ above[i]));
+		/* Add the two sums and then the three carries of weight 2 */
+		b0 = s0 ^ s1;
+		c2 = s0 & s1;
+		b1 = c0 ^ c1 ^ c2;
+		b2 = (c0 & c1) | (c2 & (c0 ^ c1));
+		/* Each level keeps, for every cell, the entry of each pair whose next bit of the index matches the cell */
+		for(k = 0; k < 8; k++)
+		{
+			entries[k] = table[2 * k] ^ (b0 & (table[2 * k] ^ table[2 * k + 1]));
+		}
+		for(k = 0; k < 4; k++)
+		{
+			entries[k] = entries[2 * k] ^ (b1 & (entries[2 * k] ^ entries[2 * k + 1]));
+		}
+		for(k = 0; k < 2; k++)
+		{
+			entries[k] = entries[2 * k] ^ (b2 & (entries[2 * k] ^ entries[2 * k + 1]));
+		}
+		next[i] = entries[0] ^ (alive[i] & (entries[0] ^ entries[1]));
+	}
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
+	{
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
+		{
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
+		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, writing the buffer out first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL; 	/**< 	Where to format the next character 	*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** READ_ARGUMENTS **************************************************/
+/**
+ * Checks if the command line arguments verify the specifications
+ *
+ * @param argc 				Command line argument count
+ * @param argv				Command line arguments
+ * @param input_filename	Name of the file specified in the arguments
+ * @param iterations 		Number of iterations specified in the arguments
+ * @param binary 			Whether to print the solution in the binary format
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
+ */
+void read_arguments(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *rule)
+{
+	FILE 	*input_fd 	= NULL;
+	int 	i 			= 0;
+
+	if(argc < 3)
+	{
+		fprintf(stderr, "Program is run with ./life3d-dense [name-of-input-file] [number-of-iterations] [--rule B../S..] [--binary]\n");
+		exit(-1);
+	}
+
+	(*binary) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			/* Every cell is computed, so unlike the other versions the rule may bring cells to life without neighbors */
+			(*rule) = read_rule(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
+	(*input_filename) = argv[1];
+	input_fd = fopen((*input_filename), "r");
+	if(input_fd == NULL)
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+	fclose(input_fd);
+
+	(*iterations) = atoi(argv[2]);
+	if((*iterations) <= 0)
+	{
+		fprintf(stderr, "The number of iterations must be >= 1\n");
+		exit(-1);
+	}
+}
+
+/************************************************** READ_COORDINATES **************************************************/
+/**
+ * Reads the input file, in text or in the binary format, and stores the given cells in the cube
+ *
+ * @param input 			Mapped input file
+ * @param cube 				Structure that contains the cells
+ * @param size 				Size of the sides of the cube
+ */
+void read_coordinates(struct input *input, uint64_t *cube, int size)
+{
+	char 		*next 			= NULL;
+	char 		*ptr 			= input->cursor;
+	uint64_t 	i 				= 0;
+	int 		coordinates[3] 	= {0};
+	int 		words 			= 0;
+
+	words = WORDS(size);
+	if(input->binary)
+	{
+		for(i = 0; i < input->count; i++)
+		{
+			binary_read_cell(input, coordinates, size);
+			cube[((size_t) coordinates[0] * size + coordinates[1]) * words + (coordinates[2] / WORD_BITS)] |= ((uint64_t) 1) << (coordinates[2] % WORD_BITS);
+		}
+		return;
+	}
+	while(ptr < input->end)
+	{
+		next = input_scan(ptr, input->end, coordinates, 3);
+		if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
+		{
+			input_error(input, ptr);
+		}
+		cube[((size_t) coordinates[0] * size + coordinates[1]) * words + (coordinates[2] / WORD_BITS)] |= ((uint64_t) 1) << (coordinates[2] % WORD_BITS);
+		ptr = next;
+	}
+	input->cursor = ptr;
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
+{
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
+
+	if((*ptr) == 'B')
+	{
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+		{
+			rule |= 1 << ((*ptr) - '0');
+		}
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
+		{
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
+		}
+	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
+}
+
+/************************************************** READ_SIZE **************************************************/
+/**
+ * Reads the input file and returns the declared size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return size 			Size of the sides of the cube
+ */
+int read_size(struct input *input)
+{
+	char 	*next 	= NULL;
+	int 	size 	= 0;
+
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
+	{
+		return binary_read_header(input);
+	}
+
+	next = input_scan(input->cursor, input->end, &size, 1);
+	if(next == NULL)
+	{
+		input_error(input, input->cursor);
+	}
+	input->cursor = next;
+
+	return size;
+}
+
+/************************************************** MAIN **************************************************/
+int main(int argc, char *argv[])
+{
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer for stdout 					*/
+	uint64_t 		*cube 				= NULL; 	/**< 	Cells of the current generation 			*/
+	uint64_t 		*next 				= NULL; 	/**< 	Cells of the next generation 				*/
+	uint64_t 		*above 				= NULL; 	/**< 	Cells at z+1 of the slice being processed 	*/
+	uint64_t 		*below 				= NULL; 	/**< 	Cells at z-1 of the slice being processed 	*/
+	uint64_t 		*aux 				= NULL; 	/**< 	Auxilliary pointer 							*/
+	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	int 			binary 				= 0; 		/**< 	Whether to print in the binary format 		*/
+	int 			iterations 			= 0; 		/**< 	Number of iterations to run the problem 	*/
+	int 			rule 				= 0; 		/**< 	Lookup table of the rule 					*/
+	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
+
+	/* Read the arguments given to the program */
+	read_arguments(argc, argv, &input_filename, &iterations, &binary, &rule);
+	/* Read the size of the problem */
+	input = input_map(input_filename);
+	size = read_size(input);
+	output = output_create(STDOUT_FILENO, binary, size, input->generation + iterations);
+	/* Create the data structures */
+	cube = cube_create(size);
+	next = cube_create(size);
+	above = (uint64_t *) calloc((size_t) size * WORDS(size), sizeof(uint64_t));
+	below = (uint64_t *) calloc((size_t) size * WORDS(size), sizeof(uint64_t));
+	alloc_check(above);
+	alloc_check(below);
+	/* Reads the input file and stores the given cells in the cube */
+	read_coordinates(input, cube, size);
+	input_unmap(input);
+
+	/* Process the given problem, swapping the current and next generations every iteration */
+	while(iterations > 0)
+	{
+		determine_next_generation(cube, next, above, below, size, rule);
+		aux = cube;
+		cube = next;
+		next = aux;
+		iterations--;
+	}
+
+	/* Print the solution to stdout */
+	cube_print(output, cube, size);
+	output_destroy(output);
+	/* Destroy the data structures */
+	free(cube);
+	free(next);
+	free(above);
+	free(below);
+
+	return 0;
+}
@@ -0,0 +1,1590 @@
+/************************************************** INFO **************************************************/
+/**
+ * \brief		Hash table implementation of a 3D version of the Game of Life by John Conway
+ *				for the Parallel and Distributed Computing course at IST 16/17 2nd Semester
+ *				taught by Professor José Monteiro and Professor Luís Guerra e Silva
+ *
+ *				Meant for huge and very sparse cubes, where even the size by size matrix of
+ *				columns of the other versions does not fit in memory. The cells are identified by
+ *				their coordinates packed in a 64-bit key and stored in an open addressing hash table,
+ *				so the memory used is proportional to the number of alive cells
+ *
+ * \author		Group 				#25
+ * \author		André Mendes		#66943
+ * \author		Nuno Venturinha		#67682
+ * \author		Daniel Sousa		#79129
+ * \version		1.0
+ * \date 		18/10/2026
+ */
+/************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/************************************************** DEFINE **************************************************/
+/************************************************** CONSTANTS **************************************************/
+#define ALIVE 				0x80	/** \def 	Flag that marks the alive cells in the table 	*/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
+#define COORDINATE_BITS 	21		/** \def 	Number of bits of each coordinate in a key 		*/
+#define CYCLE_HISTORY 		64		/** \def 	Number of generations whose hash is remembered 	*/
+#define EMPTY 				UINT64_MAX	/** \def 	Key of the empty slots of the table 		*/
+#define ENGINE_FULL 		0		/** \def 	Engine that recounts every generation 			*/
+#define ENGINE_INCREMENTAL 	1		/** \def 	Engine that only applies the changes 			*/
+#define MARKED 				0x40	/** \def 	Flag of the cells to evaluate in the table 		*/
+#define NEIGHBORS 			0x3f	/** \def 	Mask of the neighbor count in the table 		*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define RADIX_BITS 			16		/** \def 	Number of bits sorted by each radix sort pass 	*/
+#define RULE_DEFAULT 		0x1c0c	/** \def 	Lookup table of the rule B23/S234 				*/
+#define TABLE_MIN_SIZE 		1024	/** \def 	Minimum number of slots of the table 			*/
+
+/************************************************** OPERATORS **************************************************/
+#define COORDINATE_MASK 	((((uint64_t) 1) << COORDINATE_BITS) - 1)
+#define KEY(x, y, z) 		((((uint64_t) (x)) << (2 * COORDINATE_BITS)) | (((uint64_t) (y)) << COORDINATE_BITS) | ((uint64_t) (z)))
+#define KEY_X(key) 			((int) (((key) >> (2 * COORDINATE_BITS)) & COORDINATE_MASK))
+#define KEY_Y(key) 			((int) (((key) >> COORDINATE_BITS) & COORDINATE_MASK))
+#define KEY_Z(key) 			((int) ((key) & COORDINATE_MASK))
+#define RULE_NEXT(rule, alive, count) 	(((rule) >> (((alive) << 3) | (count))) & 1)
+
+/************************************************** PROTOTYPES **************************************************/
+struct 				cycle;
+struct 				input;
+struct 				output;
+struct 				table;
+void 				alloc_check 				(void *ptr);
+int 				apply_changes 				(struct table *table, uint64_t *changes, int count, size_t **touched, int *capacity, int size);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+uint64_t 			cells_hash 					(uint64_t *cells, int count);
+void 				cells_print 				(struct output *output, uint64_t *cells, int count);
+void 				cells_sort 					(uint64_t *cells, uint64_t *buffer, int count);
+struct cycle * 		cycle_create 				(void);
+void 				cycle_destroy 				(struct cycle *cycle);
+int 				cycle_update 				(struct cycle *cycle, uint64_t hash, uint64_t generation);
+int 				cycle_verify 				(struct cycle *cycle, uint64_t *cells, int count, uint64_t generation);
+int 				determine_next_changes 		(struct table *table, size_t *touched, int count, uint64_t *changes, int rule);
+int 				determine_next_generation 	(struct table *table, uint64_t *cells, int count, uint64_t **next, int *capacity, int size, int rule);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_write 				(int fd, char *data, size_t length);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations, int *engine, int *binary, int *rule);
+uint64_t * 			read_coordinates 			(struct input *input, struct table *table, int *count, int *capacity, int size);
+int 				read_rule 					(char *text);
+int 				read_size 					(struct input *input);
+size_t 				table_add 					(struct table *table, uint64_t key, unsigned char value);
+int 				table_alive 				(struct table *table, uint64_t **cells, int *capacity);
+struct table * 		table_create 				(void);
+void 				table_destroy 				(struct table *table);
+void 				table_reserve 				(struct table *table, size_t count);
+void 				table_reset 				(struct table *table, size_t count);
+
+/************************************************** STRUCT CYCLE **************************************************/
+/** \struct
+ * Structure that looks for generations that repeat. The hash of the alive cells of the last
+ * generations is remembered, and when one repeats the cells of that generation are kept and
+ * compared with the ones a period later, so that a collision of the hashes is never taken for a cycle
+ */
+struct cycle
+{
+	uint64_t 		hashes[CYCLE_HISTORY]; 	/**<	Hash of the last generations, indexed by generation 		*/
+	uint64_t 		*snapshot; 			/**<	Keys of the cells of the generation that repeated, sorted 	*/
+	uint64_t 		*buffer; 			/**<	Buffer used to sort the snapshot 							*/
+	uint64_t 		generation; 		/**<	Generation of the snapshot 									*/
+	int 			capacity; 			/**<	Number of keys the snapshot and the buffer have room for 	*/
+	int 			count; 				/**<	Number of cells of the snapshot, -1 if it is not taken yet 	*/
+	int 			period; 			/**<	Period being verified, 0 if none 							*/
+};
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
+
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text not written yet 								*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	int 			fd; 				/**<	File descriptor where the text is written 					*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** STRUCT TABLE **************************************************/
+/** \struct
+ * Open addressing hash table with linear probing that holds the cells of a generation
+ * and the neighbor count of each one. Keys and counts are kept in separate arrays so
+ * that probing only touches the keys. The incremental engine keeps the table from one
+ * generation to the next instead of emptying it
+ */
+struct table
+{
+	uint64_t 		*keys; 				/**<	Packed coordinates of the cells, EMPTY for free slots 		*/
+	unsigned char 	*values; 			/**<	Neighbor count of each cell plus the ALIVE flag 			*/
+	size_t 			capacity; 			/**<	Number of slots, always a power of 2 						*/
+	size_t 			count; 				/**<	Number of slots in use 										*/
+	int 			shift; 				/**<	Shift that turns a 64-bit hash into a slot 					*/
+};
+
+/************************************************** ALLOC_CHECK **************************************************/
+/**
+ * Checks if a given memory allocation was successful
+ *
+ * @param ptr		Pointer to the memory that was allocated
+ */
+void alloc_check(void *ptr)
+{
+	if(ptr == NULL)
+	{
+		fprintf(stderr, "Error with memory allocation\n");
+		abort();
+	}
+}
+
+/************************************************** APPLY_CHANGES **************************************************/
+/**
+ * Applies the cells that changed in the last generation to the table kept by the incremental
+ * engine. Each of them flips its ALIVE flag and adds 1 to the count of its 6 neighbors if it
+ * was born or subtracts 1 if it died. The cells whose state or count changed are the only
+ * ones whose next state can differ from the current one, so they are marked to be evaluated
+ *
+ * @param table 	Table with the neighbor count of the current generation
+ * @param changes 	Keys of the cells born or dead in the last generation
+ * @param count 	Number of changes
+ * @param touched 	Array where to store the slots of the marked cells, grown if needed
+ * @param capacity 	Number of slots the touched array has room for
+ * @param size 		Size of the sides of the cube
+ * @return 			Number of marked cells
+ */
+int apply_changes(struct table *table, uint64_t *changes, int count, size_t **touched, int *capacity, int size)
+{
+	uint64_t 		neighbors[7] 	= {0}; 		/**< 	Key of the cell followed by the keys of its neighbors 	*/
+	uint64_t 		key 			= 0;
+	size_t 			slot 			= 0;
+	int 			delta 			= 0; 		/**< 	1 if the cell was born, -1 if it died 					*/
+	int 			i 				= 0;
+	int 			j 				= 0;
+	int 			length 			= 0;
+	int 			x 				= 0;
+	int 			y 				= 0;
+	int 			z 				= 0;
+
+	/* Each change touches at most 7 slots, the table is only grown here so the slots stay put until the changes are evaluated */
+	table_reserve(table, (size_t) count * 7);
+	if((*capacity) < (count * 7))
+	{
+		(*capacity) = count * 7;
+		(*touched) = (size_t *) realloc((*touched), (*capacity) * sizeof(size_t));
+		alloc_check((*touched));
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		key = changes[i];
+		x = KEY_X(key);
+		y = KEY_Y(key);
+		z = KEY_Z(key);
+		neighbors[0] = key;
+		neighbors[1] = KEY(((x == (size - 1)) ? 0 : (x + 1)), y, z);
+		neighbors[2] = KEY(((x == 0) ? (size - 1) : (x - 1)), y, z);
+		neighbors[3] = KEY(x, ((y == (size - 1)) ? 0 : (y + 1)), z);
+		neighbors[4] = KEY(x, ((y == 0) ? (size - 1) : (y - 1)), z);
+		neighbors[5] = KEY(x, y, ((z == (size - 1)) ? 0 : (z + 1)));
+		neighbors[6] = KEY(x, y, ((z == 0) ? (size - 1) : (z - 1)));
+
+		for(j = 0; j < 7; j++)
+		{
+			slot = table_add(table, neighbors[j], 0);
+			if(j == 0)
+			{
+				table->values[slot] ^= ALIVE;
+				delta = (table->values[slot] & ALIVE) ? 1 : -1;
+			}
+			else
+			{
+				table->values[slot] += delta;
+			}
+			if(!(table->values[slot] & MARKED))
+			{
+				table->values[slot] |= MARKED;
+				(*touched)[length++] = slot;
+			}
+		}
+	}
+
+	return length;
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** CELLS_HASH **************************************************/
+/**
+ * Returns the Zobrist hash of the given cells, the xor of a pseudo-random value per cell.
+ * The keys are too many to draw the values from a table, so they are mixed with the
+ * finalizer of splitmix64 instead. As xor is its own inverse the hash of a generation is
+ * also updated by hashing the cells that were born or died and xoring the result
+ *
+ * @param cells 	Keys of the cells
+ * @param count 	Number of cells
+ * @return 			Hash of the cells
+ */
+uint64_t cells_hash(uint64_t *cells, int count)
+{
+	uint64_t 	hash 	= 0;
+	uint64_t 	value 	= 0;
+	int 		i 		= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		value = cells[i] + 0x9E3779B97F4A7C15ULL;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+		hash ^= value ^ (value >> 31);
+	}
+
+	return hash;
+}
+
+/************************************************** CELLS_PRINT **************************************************/
+/**
+ * Prints the given cells to the given output
+ *
+ * @param output 	Output buffer
+ * @param cells 	Keys of the alive cells, sorted
+ * @param count 	Number of cells
+ */
+void cells_print(struct output *output, uint64_t *cells, int count)
+{
+	int 	i 	= 0;
+
+	if(output->binary)
+	{
+		output_header(output, count);
+	}
+	for(i = 0; i < count; i++)
+	{
+		output_cell(output, KEY_X(cells[i]), KEY_Y(cells[i]), KEY_Z(cells[i]));
+	}
+}
+
+/************************************************** CELLS_SORT **************************************************/
+/**
+ * Sorts the given cells by x, then y and then z. As the coordinates are packed
+ * from the most to the least significant bits this is a plain LSD radix sort of the keys
+ *
+ * @param cells 	Keys of the cells
+ * @param buffer 	Buffer with room for count keys
+ * @param count 	Number of cells
+ */
+void cells_sort(uint64_t *cells, uint64_t *buffer, int count)
+{
+	uint64_t 	*from 		= NULL; 	/**< 	Keys sorted up to the previous pass 	*/
+	uint64_t 	*to 		= NULL; 	/**< 	Keys sorted up to the current pass 		*/
+	uint64_t 	*aux 		= NULL; 	/**< 	Auxilliary pointer 						*/
+	int 		*offsets 	= NULL; 	/**< 	Position of each digit in the output 	*/
+	int 		digit 		= 0;
+	int 		i 			= 0;
+	int 		shift 		= 0;
+	int 		total 		= 0;
+
+	offsets = (int *) calloc(1 << RADIX_BITS, sizeof(int));
+	alloc_check(offsets);
+
+	from = cells;
+	to = buffer;
+	for(shift = 0; shift < (3 * COORDINATE_BITS); shift += RADIX_BITS)
+	{
+		memset(offsets, 0, (1 << RADIX_BITS) * sizeof(int));
+		for(i = 0; i < count; i++)
+		{
+			offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++;
+		}
+		total = 0;
+		for(digit = 0; digit < (1 << RADIX_BITS); digit++)
+		{
+			i = offsets[digit];
+			offsets[digit] = total;
+			total += i;
+		}
+		for(i = 0; i < count; i++)
+		{
+			to[offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++] = from[i];
+		}
+		aux = from;
+		from = to;
+		to = aux;
+	}
+	/* An odd number of passes leaves the result in the buffer */
+	if(from != cells)
+	{
+		memcpy(cells, from, count * sizeof(uint64_t));
+	}
+
+	free(offsets);
+}
+
+/************************************************** CYCLE_CREATE **************************************************/
+/**
+ * Creates a structure that looks for cycles and returns it
+ *
+ * @return 			Cycle finder
+ */
+struct cycle * cycle_create(void)
+{
+	struct cycle 	*cycle 	= NULL;
+
+	cycle = (struct cycle *) calloc(1, sizeof(struct cycle));
+	alloc_check(cycle);
+	cycle->count = -1;
+
+	return cycle;
+}
+
+/************************************************** CYCLE_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for a cycle finder
+ *
+ * @param cycle 	Cycle finder
+ */
+void cycle_destroy(struct cycle *cycle)
+{
+	free(cycle->snapshot);
+	free(cycle->buffer);
+	free(cycle);
+}
+
+/************************************************** CYCLE_UPDATE **************************************************/
+/**
+ * Remembers the hash of a generation, which must follow the one given before, and looks for
+ * it among the last generations. Returns whether the cells of this generation must be given
+ * to cycle_verify, either to keep them because the hash repeated or to compare them with the ones kept
+ *
+ * @param cycle 		Cycle finder
+ * @param hash 			Hash of the alive cells
+ * @param generation 	Generation of the cells, counted from 0
+ * @return 				1 if cycle_verify must be called, 0 otherwise
+ */
+int cycle_update(struct cycle *cycle, uint64_t hash, uint64_t generation)
+{
+	int 	period 	= 0;
+	int 	found 	= 0; 		/**< 	Period of the last generation with the same hash 	*/
+
+	if(cycle->period == 0)
+	{
+		for(period = 1; (period < CYCLE_HISTORY) && ((uint64_t) period <= generation); period++)
+		{
+			if(cycle->hashes[(generation - period) % CYCLE_HISTORY] == hash)
+			{
+				found = period;
+				break;
+			}
+		}
+	}
+	cycle->hashes[generation % CYCLE_HISTORY] = hash;
+
+	if(found > 0)
+	{
+		cycle->period = found;
+		cycle->count = -1;
+		return 1;
+	}
+	return (cycle->period > 0) && (generation == cycle->generation + cycle->period);
+}
+
+/************************************************** CYCLE_VERIFY **************************************************/
+/**
+ * Keeps the cells of the generation whose hash repeated or, a period later, compares them
+ * with the ones kept. The cells are never repeated, so two generations are the same if they
+ * have as many cells and every cell of one is found in the other
+ *
+ * @param cycle 		Cycle finder
+ * @param cells 		Keys of the alive cells, in any order
+ * @param count 		Number of alive cells
+ * @param generation 	Generation of the cells
+ * @return 				Period of the cycle if it is confirmed, 0 otherwise
+ */
+int cycle_verify(struct cycle *cycle, uint64_t *cells, int count, uint64_t generation)
+{
+	int 	period 	= cycle->period;
+	int 	first 	= 0;
+	int 	last 	= 0;
+	int 	middle 	= 0;
+	int 	i 		= 0;
+
+	if(cycle->count < 0)
+	{
+		if(cycle->capacity < count)
+		{
+			cycle->capacity = count;
+			cycle->snapshot = (uint64_t *) realloc(cycle->snapshot, cycle->capacity * sizeof(uint64_t));
+			cycle->buffer = (uint64_t *) realloc(cycle->buffer, cycle->capacity * sizeof(uint64_t));
+			alloc_check(cycle->snapshot);
+			alloc_check(cycle->buffer);
+		}
+		memcpy(cycle->snapshot, cells, count * sizeof(uint64_t));
+		cells_sort(cycle->snapshot, cycle->buffer, count);
+		cycle->count = count;
+		cycle->generation = generation;
+		return 0;
+	}
+
+	/* Whatever the outcome the next repeated hash starts over */
+	cycle->period = 0;
+	if(count != cycle->count)
+	{
+		return 0;
+	}
+	for(i = 0; i < count; i++)
+	{
+		first = 0;
+		last = count;
+		while(first < last)
+		{
+			middle = first + (last - first) / 2;
+			if(cycle->snapshot[middle] < cells[i])
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle;
+			}
+		}
+		if((first == count) || (cycle->snapshot[first] != cells[i]))
+		{
+			return 0;
+		}
+	}
+
+	return period;
+}
+
+/************************************************** DETERMINE_NEXT_CHANGES **************************************************/
+/**
+ * Evaluates the rule on the cells marked by apply_changes and returns the ones
+ * that are born or die in the next generation, clearing their marks
+ *
+ * @param table 	Table with the neighbor count of the current generation
+ * @param touched 	Slots of the marked cells
+ * @param count 	Number of marked cells
+ * @param changes 	Array with room for count keys where to store the changes
+ * @param rule 		Lookup table of the rule
+ * @return 			Number of cells born or dead in the next generation
+ */
+int determine_next_changes(struct table *table, size_t *touched, int count, uint64_t *changes, int rule)
+{
+	unsigned char 	value 		= 0;
+	int 			alive 		= 0; 		/**< 	Whether the cell is alive in the current generation */
+	int 			i 			= 0;
+	int 			length 		= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		value = table->values[touched[i]];
+		alive = ((value & ALIVE) != 0);
+		/* The cell changes when the rule gives it a state other than its current one */
+		if(RULE_NEXT(rule, alive, value & NEIGHBORS) != alive)
+		{
+			changes[length++] = table->keys[touched[i]];
+		}
+		table->values[touched[i]] = value & ~MARKED;
+	}
+
+	return length;
+}
+
+/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
+/**
+ * Computes the next generation. Every alive cell is added to the table along with
+ * its 6 neighbors, whose count is incremented, and then the table is scanned to
+ * collect the cells that are alive in the next generation
+ *
+ * @param table 	Table used to count the neighbors
+ * @param cells 	Keys of the cells alive in the current generation
+ * @param count 	Number of alive cells
+ * @param next 		Array where to store the cells alive in the next generation, grown if needed
+ * @param capacity 	Number of keys the next array has room for
+ * @param size 		Size of the sides of the cube
+ * @param rule 		Lookup table of the rule
+ * @return 			Number of cells alive in the next generation
+ */
+int determine_next_generation(struct table *table, uint64_t *cells, int count, uint64_t **next, int *capacity, int size, int rule)
+{
+	uint64_t 		key 		= 0;
+	unsigned char 	value 		= 0;
+	size_t 			slot 		= 0;
+	int 			i 			= 0;
+	int 			length 		= 0;
+	int 			x 			= 0;
+	int 			y 			= 0;
+	int 			z 			= 0;
+
+	/* Each alive cell touches at most 7 slots */
+	table_reset(table, (size_t) count * 7);
+
+	for(i = 0; i < count; i++)
+	{
+		key = cells[i];
+		x = KEY_X(key);
+		y = KEY_Y(key);
+		z = KEY_Z(key);
+		table_add(table, key, ALIVE);
+		table_add(table, KEY(((x == (size - 1)) ? 0 : (x + 1)), y, z), 1);
+		table_add(table, KEY(((x == 0) ? (size - 1) : (x - 1)), y, z), 1);
+		table_add(table, KEY(x, ((y == (size - 1)) ? 0 : (y + 1)), z), 1);
+		table_add(table, KEY(x, ((y == 0) ? (size - 1) : (y - 1)), z), 1);
+		table_add(table, KEY(x, y, ((z == (size - 1)) ? 0 : (z + 1))), 1);
+		table_add(table, KEY(x, y, ((z == 0) ? (size - 1) : (z - 1))), 1);
+	}
+
+	if((*capacity) < (count * 7))
+	{
+		(*capacity) = count * 7;
+		(*next) = (uint64_t *) realloc((*next), (*capacity) * sizeof(uint64_t));
+		alloc_check((*next));
+	}
+
+	for(slot = 0; slot < table->capacity; slot++)
+	{
+		if(table->keys[slot] == EMPTY)
+		{
+			continue;
+		}
+		value = table->values[slot];
+		/* Every key is stored and only kept when the rule gives an alive cell, so there is no branch on the rule */
+		(*next)[length] = table->keys[slot];
+		length += RULE_NEXT(rule, (value & ALIVE) != 0, value & NEIGHBORS);
+	}
+
+	return length;
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
+	{
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
+		{
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
+		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, writing the buffer out first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL; 	/**< 	Where to format the next character 	*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** READ_ARGUMENTS **************************************************/
+/**
+ * Checks if the command line arguments verify the specifications
+ *
+ * @param argc 				Command line argument count
+ * @param argv				Command line arguments
+ * @param input_filename	Name of the file specified in the arguments
+ * @param iterations 		Number of iterations specified in the arguments
+ * @param engine 			Engine specified in the arguments, the full recount by default
+ * @param binary 			Whether to print the solution in the binary format
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
+ */
+void read_arguments(int argc, char *argv[], char **input_filename, int *iterations, int *engine, int *binary, int *rule)
+{
+	FILE 	*input_fd 	= NULL;
+	int 	i 			= 0;
+
+	if(argc < 3)
+	{
+		fprintf(stderr, "Program is run with ./life3d-hash [name-of-input-file] [number-of-iterations] [--engine full|incremental] [--rule B../S..] [--binary]\n");
+		exit(-1);
+	}
+
+	(*engine) = ENGINE_FULL;
+	(*binary) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if((strcmp(argv[i], "--engine") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if(strcmp(argv[i], "full") == 0)
+			{
+				(*engine) = ENGINE_FULL;
+			}
+			else if(strcmp(argv[i], "incremental") == 0)
+			{
+				(*engine) = ENGINE_INCREMENTAL;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown engine %s\n", argv[i]);
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			(*rule) = read_rule(argv[++i]);
+			/* Only the cells next to alive ones are ever looked at, so none can be born without neighbors */
+			if(RULE_NEXT((*rule), 0, 0))
+			{
+				fprintf(stderr, "Rules with B0 are only supported by life3d-dense\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
+	(*input_filename) = argv[1];
+	input_fd = fopen((*input_filename), "r");
+	if(input_fd == NULL)
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+	fclose(input_fd);
+
+	(*iterations) = atoi(argv[2]);
+	if((*iterations) <= 0)
+	{
+		fprintf(stderr, "The number of iterations must be >= 1\n");
+		exit(-1);
+	}
+}
+
+/************************************************** READ_COORDINATES **************************************************/
+/**
+ * Reads the input file, in text or in the binary format, and returns the keys of the given cells, without repetitions
+ *
+ * @param input 			Mapped input file
+ * @param table 			Table used to remove the repeated cells
+ * @param count 			Number of cells read
+ * @param capacity 			Number of keys the returned array has room for
+ * @param size 				Size of the sides of the cube
+ * @return 					Keys of the cells
+ */
+uint64_t * read_coordinates(struct input *input, struct table *table, int *count, int *capacity, int size)
+{
+	uint64_t 	*cells 			= NULL;
+	char 		*next 			= NULL;
+	char 		*ptr 			= input->cursor;
+	size_t 		slot 			= 0;
+	int 		coordinates[3] 	= {0};
+	int 		length 			= 0;
+
+	/* Every line takes at least 6 bytes, so the length of the file bounds the number of cells */
+	(*capacity) = input->binary ? (int) input->count + 1 : (input->end - ptr) / 6 + 1;
+	cells = (uint64_t *) malloc((*capacity) * sizeof(uint64_t));
+	alloc_check(cells);
+
+	if(input->binary)
+	{
+		while((uint64_t) length < input->count)
+		{
+			binary_read_cell(input, coordinates, size);
+			cells[length++] = KEY(coordinates[0], coordinates[1], coordinates[2]);
+		}
+	}
+	else
+	{
+		while(ptr < input->end)
+		{
+			next = input_scan(ptr, input->end, coordinates, 3);
+			if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
+			{
+				input_error(input, ptr);
+			}
+			cells[length++] = KEY(coordinates[0], coordinates[1], coordinates[2]);
+			ptr = next;
+		}
+		input->cursor = ptr;
+	}
+
+	/* Remove the repeated cells by adding all of them to the table */
+	table_reset(table, length);
+	for(slot = 0; slot < (size_t) length; slot++)
+	{
+		table_add(table, cells[slot], ALIVE);
+	}
+	(*count) = 0;
+	for(slot = 0; slot < table->capacity; slot++)
+	{
+		if(table->keys[slot] != EMPTY)
+		{
+			cells[(*count)++] = table->keys[slot];
+		}
+	}
+
+	return cells;
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
+{
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
+
+	if((*ptr) == 'B')
+	{
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+		{
+			rule |= 1 << ((*ptr) - '0');
+		}
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
+		{
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
+		}
+	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
+}
+
+/************************************************** READ_SIZE **************************************************/
+/**
+ * Reads the input file and returns the declared size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return size 			Size of the sides of the cube
+ */
+int read_size(struct input *input)
+{
+	char 	*next 	= NULL;
+	int 	size 	= 0;
+
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
+	{
+		return binary_read_header(input);
+	}
+
+	next = input_scan(input->cursor, input->end, &size, 1);
+	if(next == NULL)
+	{
+		input_error(input, input->cursor);
+	}
+	input->cursor = next;
+	if((size <= 0) || (size > (1 << COORDINATE_BITS)))
+	{
+		fprintf(stderr, "The size of the cube must be between 1 and %d\n", 1 << COORDINATE_BITS);
+		exit(-1);
+	}
+
+	return size;
+}
+
+/************************************************** TABLE_ADD **************************************************/
+/**
+ * Adds a value to the cell with the given key, inserting it if it is not in the table yet
+ *
+ * @param table 	Table
+ * @param key 		Key of the cell
+ * @param value 	Value to add, either 1 to count a neighbor or the ALIVE flag
+ * @return 			Slot of the cell
+ */
+size_t table_add(struct table *table, uint64_t key, unsigned char value)
+{
+	size_t 		mask 	= 0;
+	size_t 		slot 	= 0;
+
+	mask = table->capacity - 1;
+	/* Fibonacci hashing, the high bits of the product are the best mixed ones */
+	slot = (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> table->shift);
+	while((table->keys[slot] != key) && (table->keys[slot] != EMPTY))
+	{
+		slot = (slot + 1) & mask;
+	}
+	if(table->keys[slot] == EMPTY)
+	{
+		table->keys[slot] = key;
+		table->values[slot] = 0;
+		table->count++;
+	}
+	table->values[slot] |= (value & ALIVE);
+	table->values[slot] += (value & NEIGHBORS);
+
+	return slot;
+}
+
+/************************************************** TABLE_ALIVE **************************************************/
+/**
+ * Collects the keys of the alive cells of the table kept by the incremental engine
+ *
+ * @param table 	Table
+ * @param cells 	Array where to store the keys, grown if needed
+ * @param capacity 	Number of keys the array has room for
+ * @return 			Number of alive cells
+ */
+int table_alive(struct table *table, uint64_t **cells, int *capacity)
+{
+	size_t 		slot 	= 0;
+	int 		count 	= 0;
+
+	for(slot = 0; slot < table->capacity; slot++)
+	{
+		if((table->keys[slot] != EMPTY) && (table->values[slot] & ALIVE))
+		{
+			count++;
+		}
+	}
+
+	if((*capacity) < count)
+	{
+		(*capacity) = count;
+		(*cells) = (uint64_t *) realloc((*cells), (*capacity) * sizeof(uint64_t));
+		alloc_check((*cells));
+	}
+
+	count = 0;
+	for(slot = 0; slot < table->capacity; slot++)
+	{
+		if((table->keys[slot] != EMPTY) && (table->values[slot] & ALIVE))
+		{
+			(*cells)[count++] = table->keys[slot];
+		}
+	}
+
+	return count;
+}
+
+/************************************************** TABLE_CREATE **************************************************/
+/**
+ * Creates an empty table and returns it
+ *
+ * @return 			Table
+ */
+struct table * table_create(void)
+{
+	struct table 	*table 	= NULL;
+
+	table = (struct table *) calloc(1, sizeof(struct table));
+	alloc_check(table);
+
+	table->keys = NULL;
+	table->values = NULL;
+	table->capacity = 0;
+	table->count = 0;
+	table->shift = 64;
+
+	return table;
+}
+
+/************************************************** TABLE_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for a table
+ *
+ * @param table 	Table
+ */
+void table_destroy(struct table *table)
+{
+	free(table->keys);
+	free(table->values);
+	free(table);
+}
+
+/************************************************** TABLE_RESERVE **************************************************/
+/**
+ * Guarantees that the given number of cells can be inserted in the table kept by the incremental
+ * engine while it stays at most half full. The dead cells without neighbors are never removed
+ * from it, so when it runs out of room they are dropped and the others are hashed again
+ *
+ * @param table 	Table
+ * @param count 	Number of cells that may be inserted
+ */
+void table_reserve(struct table *table, size_t count)
+{
+	uint64_t 		*keys 		= NULL; 	/**< 	Keys of the old table 				*/
+	unsigned char 	*values 	= NULL; 	/**< 	Values of the old table 			*/
+	size_t 			capacity 	= 0; 		/**< 	Number of slots of the old table 	*/
+	size_t 			slot 		= 0;
+	size_t 			used 		= 0; 		/**< 	Number of cells worth keeping 		*/
+
+	if(2 * (table->count + count) <= table->capacity)
+	{
+		return;
+	}
+
+	keys = table->keys;
+	values = table->values;
+	capacity = table->capacity;
+	for(slot = 0; slot < capacity; slot++)
+	{
+		if((keys[slot] != EMPTY) && (values[slot] != 0))
+		{
+			used++;
+		}
+	}
+
+	/* Leave room for twice as many cells so that the table is not hashed again right away */
+	table->keys = NULL;
+	table->values = NULL;
+	table->capacity = 0;
+	table_reset(table, 2 * (used + count));
+	for(slot = 0; slot < capacity; slot++)
+	{
+		if((keys[slot] != EMPTY) && (values[slot] != 0))
+		{
+			table_add(table, keys[slot], values[slot]);
+		}
+	}
+
+	free(keys);
+	free(values);
+}
+
+/************************************************** TABLE_RESET **************************************************/
+/**
+ * Empties the table and guarantees that it can hold the given number of cells
+ * while staying at most half full. The table only grows, so after a few
+ * generations it no longer allocates memory
+ *
+ * @param table 	Table
+ * @param count 	Number of cells the table must be able to hold
+ */
+void table_reset(struct table *table, size_t count)
+{
+	size_t 		capacity 	= 0;
+	int 		bits 		= 0;
+
+	capacity = TABLE_MIN_SIZE;
+	bits = 10;
+	while(capacity < (2 * count))
+	{
+		capacity *= 2;
+		bits++;
+	}
+
+	if(capacity > table->capacity)
+	{
+		free(table->keys);
+		free(table->values);
+		table->keys = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+		table->values = (unsigned char *) malloc(capacity * sizeof(unsigned char));
+		alloc_check(table->keys);
+		alloc_check(table->values);
+		table->capacity = capacity;
+		table->shift = 64 - bits;
+	}
+
+	/* Every byte of EMPTY is 0xff */
+	memset(table->keys, 0xff, table->capacity * sizeof(uint64_t));
+	table->count = 0;
+}
+
+/************************************************** MAIN **************************************************/
+int main(int argc, char *argv[])
+{
+	struct cycle 	*cycle 				= NULL; 	/**< 	Finder of the cycles of the generations 	*/
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer for stdout 					*/
+	struct table 	*table 				= NULL; 	/**< 	Table used to count the neighbors 			*/
+	uint64_t 		*cells 				= NULL; 	/**< 	Cells alive in the current generation 		*/
+	uint64_t 		*next 				= NULL; 	/**< 	Cells alive in the next generation 			*/
+	uint64_t 		*aux 				= NULL; 	/**< 	Auxilliary pointer 							*/
+	size_t 			*touched 			= NULL; 	/**< 	Slots of the cells to evaluate 				*/
+	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	uint64_t 		generation 			= 0; 		/**< 	Current generation, counted from 0 			*/
+	uint64_t 		hash 				= 0; 		/**< 	Hash of the alive cells 					*/
+	int 			alive 				= 0; 		/**< 	Number of cells alive in the table 			*/
+	int 			binary 				= 0; 		/**< 	Whether to print in the binary format 		*/
+	int 			capacity 			= 0; 		/**< 	Number of keys cells has room for 			*/
+	int 			capacity_next 		= 0; 		/**< 	Number of keys next has room for 			*/
+	int 			capacity_touched 	= 0; 		/**< 	Number of slots touched has room for 		*/
+	int 			count 				= 0; 		/**< 	Number of alive cells 						*/
+	int 			engine 				= 0; 		/**< 	Engine used to solve the problem 			*/
+	int 			iterations 			= 0; 		/**< 	Number of iterations to run the problem 	*/
+	int 			length 				= 0; 		/**< 	Number of cells to evaluate 				*/
+	int 			period 				= 0; 		/**< 	Period of the cycle found, 0 if none 		*/
+	int 			rule 				= 0; 		/**< 	Lookup table of the rule 					*/
+	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
+	int 			swap 				= 0; 		/**< 	Auxilliary variable to swap the capacities 	*/
+
+	/* Read the arguments given to the program */
+	read_arguments(argc, argv, &input_filename, &iterations, &engine, &binary, &rule);
+	/* Read the size of the problem */
+	input = input_map(input_filename);
+	size = read_size(input);
+	output = output_create(STDOUT_FILENO, binary, size, input->generation + iterations);
+	/* Create the data structures and read the input file */
+	table = table_create();
+	cycle = cycle_create();
+	cells = read_coordinates(input, table, &count, &capacity, size);
+	input_unmap(input);
+
+	/* Every generation is hashed, and once one repeats the remaining iterations are cut to less than its period */
+	if(engine == ENGINE_INCREMENTAL)
+	{
+		/* The table starts empty, so every given cell is a birth, and from then on cells only holds the changes */
+		table_reset(table, (size_t) count * 7);
+		for(generation = 0; ; generation++)
+		{
+			hash ^= cells_hash(cells, count);
+			length = apply_changes(table, cells, count, &touched, &capacity_touched, size);
+			if(cycle_update(cycle, hash, generation))
+			{
+				alive = table_alive(table, &next, &capacity_next);
+				period = cycle_verify(cycle, next, alive, generation);
+				iterations = (period > 0) ? (iterations % period) : iterations;
+			}
+			/* A generation without changes stays the same forever, which includes an empty cube */
+			if((iterations == 0) || (count == 0))
+			{
+				break;
+			}
+			if(capacity < length)
+			{
+				capacity = length;
+				cells = (uint64_t *) realloc(cells, capacity * sizeof(uint64_t));
+				alloc_check(cells);
+			}
+			count = determine_next_changes(table, touched, length, cells, rule);
+			iterations--;
+		}
+		count = table_alive(table, &cells, &capacity);
+	}
+	else
+	{
+		/* Process the given problem, swapping the current and next generations every iteration */
+		for(generation = 0; ; generation++)
+		{
+			if(cycle_update(cycle, cells_hash(cells, count), generation))
+			{
+				period = cycle_verify(cycle, cells, count, generation);
+				iterations = (period > 0) ? (iterations % period) : iterations;
+			}
+			/* Once no cell is left the cube stays empty */
+			if((iterations == 0) || (count == 0))
+			{
+				break;
+			}
+			count = determine_next_generation(table, cells, count, &next, &capacity_next, size, rule);
+			aux = cells;
+			cells = next;
+			next = aux;
+			swap = capacity;
+			capacity = capacity_next;
+			capacity_next = swap;
+			iterations--;
+		}
+	}
+
+	/* Sort and print the solution to stdout */
+	if(capacity_next < count)
+	{
+		next = (uint64_t *) realloc(next, count * sizeof(uint64_t));
+		alloc_check(next);
+	}
+	cells_sort(cells, next, count);
+	cells_print(output, cells, count);
+	output_destroy(output);
+	/* Destroy the data structures */
+	table_destroy(table);
+	cycle_destroy(cycle);
+	free(cells);
+	free(next);
+	free(touched);
+
+	return 0;
+}
@@ -0,0 +1,2004 @@
+/************************************************** INFO **************************************************/
+/**
+ * \brief		HashLife implementation of a 3D version of the Game of Life by John Conway
+ *				for the Parallel and Distributed Computing course at IST 16/17 2nd Semester
+ *				taught by Professor José Monteiro and Professor Luís Guerra e Silva
+ *
+ *				Meant for huge numbers of iterations. The space is an octree whose equal cubes are
+ *				always the same node, and every node remembers its center some generations later,
+ *				so the regular or periodic parts of the cube are only ever computed once and each
+ *				step can advance as many generations as the cube is wide. The torus is handled by
+ *				tiling the space with copies of it. When its size is not a power of 2 the copies start
+ *				at other positions along each level, so the steps only grow long once the cube settles,
+ *				and a torus that repeats cuts the iterations left to less than its period
+ *
+ * \author		Group 				#25
+ * \author		André Mendes		#66943
+ * \author		Nuno Venturinha		#67682
+ * \author		Daniel Sousa		#79129
+ * \version		1.0
+ * \date 		18/10/2026
+ */
+/************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/************************************************** DEFINE **************************************************/
+/************************************************** CONSTANTS **************************************************/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
+#define CACHE_MEMORY 		1024	/** \def 	Default megabytes of nodes kept in the cache 	*/
+#define COORDINATE_BITS 	21		/** \def 	Number of bits of each coordinate in a key 		*/
+#define CYCLE_HISTORY 		64		/** \def 	Number of tori remembered to find a cycle 		*/
+#define LEVELS 				66		/** \def 	Number of levels of the octree, enough for 2^63 generations */
+#define MAX_SIZE 			(1 << 20)	/** \def 	Largest size whose Morton codes fit in 64 bits 	*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define POOL_SLAB_SIZE		4096	/** \def 	Number of nodes allocated at once by the cache 	*/
+#define PROBE_FACTOR 		16		/** \def 	Generations left, per generation the first step of a size costs, to try a larger one */
+#define RADIX_BITS 			16		/** \def 	Number of bits sorted by each radix sort pass 	*/
+#define RULE_DEFAULT 		0x1c0c	/** \def 	Lookup table of the rule B23/S234 				*/
+#define TABLE_MIN_SIZE 		1024	/** \def 	Minimum number of buckets of the cache 			*/
+#define TILE_HISTORY 		64		/** \def 	Number of tilings remembered by the cache 		*/
+#define TILE_SHARE 			2		/** \def 	Part of the cache a tiling may take, as a divisor 	*/
+
+/************************************************** OPERATORS **************************************************/
+#define COORDINATE_MASK 	((((uint64_t) 1) << COORDINATE_BITS) - 1)
+#define KEY(x, y, z) 		((((uint64_t) (x)) << (2 * COORDINATE_BITS)) | (((uint64_t) (y)) << COORDINATE_BITS) | ((uint64_t) (z)))
+#define KEY_X(key) 			((int) (((key) >> (2 * COORDINATE_BITS)) & COORDINATE_MASK))
+#define KEY_Y(key) 			((int) (((key) >> COORDINATE_BITS) & COORDINATE_MASK))
+#define KEY_Z(key) 			((int) ((key) & COORDINATE_MASK))
+#define OCTANT(x, y, z) 	(((x) << 2) | ((y) << 1) | (z))
+#define RULE_NEXT(rule, alive, count) 	(((rule) >> (((alive) << 3) | (count))) & 1)
+
+/************************************************** PROTOTYPES **************************************************/
+struct 				cache;
+struct 				input;
+struct 				node;
+struct 				output;
+struct 				slab;
+void 				alloc_check 				(void *ptr);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+void 				cache_collect 				(struct cache *cache, struct node *root);
+struct cache * 		cache_create 				(int memory, int rule);
+void 				cache_destroy 				(struct cache *cache);
+void 				cache_grow 					(struct cache *cache);
+struct node * 		cells_build 				(struct cache *cache, uint64_t *cells, int count, int size, int level);
+void 				cells_print 				(struct output *output, uint64_t *cells, int count);
+void 				cells_sort 					(uint64_t *cells, uint64_t *buffer, int count);
+struct node * 		cells_tile 					(struct cache *cache, struct node *torus, uint64_t *cells, int count, int size, int level);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+uint64_t 			morton_code 				(int x, int y, int z);
+struct node * 		node_base 					(struct cache *cache, struct node *node);
+struct node * 		node_build 					(struct cache *cache, uint64_t *codes, size_t count, int level);
+void 				node_cells 					(struct cache *cache, struct node *node, uint64_t x, uint64_t y, uint64_t z, uint64_t origin, int size, uint64_t **cells, int *count, int *capacity);
+struct node * 		node_center 				(struct cache *cache, struct node *node);
+struct node * 		node_create 				(struct cache *cache, int level);
+struct node * 		node_find 					(struct cache *cache, struct node **children);
+uint64_t 			node_hash 					(struct node **children);
+void 				node_mark 					(struct node *node, int results);
+struct node * 		node_step 					(struct cache *cache, struct node *node, int step);
+struct node * 		node_subcube 				(struct node *node, int x, int y, int z);
+struct node * 		node_tile 					(struct cache *cache, struct node *node, int level);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_write 				(int fd, char *data, size_t length);
+void 				pool_grow 					(struct cache *cache);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, uint64_t *iterations, int *memory, int *binary, int *rule);
+uint64_t * 			read_coordinates 			(struct input *input, int *count, int *capacity, int size);
+int 				read_rule 					(char *text);
+int 				read_size 					(struct input *input);
+size_t 				tile_nodes 					(int size, int level);
+int 				tile_parents 				(size_t multiple, size_t sides, size_t multiples, size_t *parents);
+
+/************************************************** STRUCT CACHE **************************************************/
+/** \struct
+ * Structure that holds every node of the octree. The nodes are hash-consed, found by their octants
+ * in a table of buckets before a new one is created, so equal cubes are always the same node. The
+ * nodes come from slabs like the list nodes of the serial version, and the ones that are no longer
+ * reachable go back to the free list when the cache grows past its limit
+ */
+struct cache
+{
+	struct node 	**buckets; 			/**<	Chains of the nodes of each hash 							*/
+	struct node 	*empty[LEVELS]; 	/**<	Empty cube of each level 									*/
+	struct node 	*alive; 			/**<	The alive cell, the only other node of level 0 				*/
+	struct node 	*free_list; 		/**<	Nodes available to be reused 								*/
+	struct slab 	*slabs; 			/**<	Blocks of memory owned by the cache 						*/
+	struct node 	*tori[TILE_HISTORY]; 	/**<	Tori of the last tilings, built from their cells 		*/
+	struct node 	*tilings[TILE_HISTORY]; /**<	Last tilings built from those tori 						*/
+	int 			tiled; 				/**<	Slot of the next tiling to remember 						*/
+	size_t 			capacity; 			/**<	Number of buckets, always a power of 2 						*/
+	size_t 			count; 				/**<	Number of nodes in the buckets 								*/
+	size_t 			limit; 				/**<	Number of nodes above which the cache is collected 			*/
+	size_t 			lookups; 			/**<	Number of nodes looked up so far, a measure of the work 	*/
+	int 			shift; 				/**<	Shift that turns a 64-bit hash into a bucket 				*/
+	int 			rule; 				/**<	Lookup table of the rule applied by node_base 				*/
+};
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
+
+/************************************************** STRUCT NODE **************************************************/
+/** \struct
+ * Structure that represents a cube whose sides have 2^level cells, made of 8 octants of the level
+ * below. The cells themselves are the nodes of level 0. A node also keeps its result, its center
+ * 2^step generations later, which never changes as a node is never modified once created
+ */
+struct node
+{
+	struct node 	*children[8]; 		/**<	Octants, indexed by OCTANT(x, y, z) 						*/
+	struct node 	*result; 			/**<	Center 2^step generations later, NULL if not computed 		*/
+	struct node 	*next; 				/**<	Next node of the bucket or of the free list 				*/
+	int 			level; 				/**<	Log2 of the size of the sides of the cube 					*/
+	int 			step; 				/**<	Log2 of the number of generations of the result 			*/
+	int 			marked; 			/**<	Whether the node is still in use 							*/
+};
+
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text not written yet 								*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	int 			fd; 				/**<	File descriptor where the text is written 					*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** STRUCT SLAB **************************************************/
+/** \struct
+ * Structure that represents a block of nodes allocated at once by the cache
+ */
+struct slab
+{
+	struct node 	nodes[POOL_SLAB_SIZE]; 	/**<	Nodes of this block 									*/
+	struct slab 	*next; 					/**<	Pointer to the previously allocated block 				*/
+};
+
+/************************************************** ALLOC_CHECK **************************************************/
+/**
+ * Checks if a given memory allocation was successful
+ *
+ * @param ptr		Pointer to the memory that was allocated
+ */
+void alloc_check(void *ptr)
+{
+	if(ptr == NULL)
+	{
+		fprintf(stderr, "Error with memory allocation\n");
+		abort();
+	}
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** CACHE_COLLECT **************************************************/
+/**
+ * Frees the nodes that the given root does not reach. The results of the nodes it reaches are kept
+ * at first, since they are what makes the next steps fast, and only dropped too if the cache is still
+ * more than half full after that. The nodes built by a step are only rooted by the C stack, so the
+ * cache is only collected between steps
+ *
+ * @param cache 	Cache of nodes
+ * @param root 		Node still in use
+ */
+void cache_collect(struct cache *cache, struct node *root)
+{
+	struct node 	**ptr 		= NULL; 	/**< 	Dereferencing pointer 						*/
+	struct node 	*node 		= NULL; 	/**< 	Node being swept 							*/
+	size_t 			bucket 		= 0;
+	int 			level 		= 0;
+	int 			results 	= 0; 		/**< 	Whether the results of the nodes are kept 	*/
+
+	/* The tilings remembered are not in use and may be freed */
+	memset(cache->tori, 0, TILE_HISTORY * sizeof(struct node *));
+	memset(cache->tilings, 0, TILE_HISTORY * sizeof(struct node *));
+
+	for(results = 1; results >= 0; results--)
+	{
+		if(!results && (cache->count <= cache->limit / 2))
+		{
+			break;
+		}
+
+		node_mark(root, results);
+		for(level = 0; level < LEVELS; level++)
+		{
+			node_mark(cache->empty[level], 0);
+		}
+
+		for(bucket = 0; bucket < cache->capacity; bucket++)
+		{
+			ptr = &(cache->buckets[bucket]);
+			while((*ptr) != NULL)
+			{
+				node = (*ptr);
+				if(node->marked)
+				{
+					node->marked = 0;
+					node->result = results ? node->result : NULL;
+					ptr = &(node->next);
+					continue;
+				}
+				(*ptr) = node->next;
+				node->next = cache->free_list;
+				cache->free_list = node;
+				cache->count--;
+			}
+		}
+	}
+}
+
+/************************************************** CACHE_CREATE **************************************************/
+/**
+ * Creates an empty cache with the nodes of the empty cubes of every level and the alive cell, and returns it
+ *
+ * @param memory 	Megabytes the nodes may take before the cache is collected
+ * @param rule 		Lookup table of the rule
+ * @return 			Cache of nodes
+ */
+struct cache * cache_create(int memory, int rule)
+{
+	struct cache 	*cache 			= NULL; 	/**< 	Pointer to the new cache 		*/
+	struct node 	*children[8] 	= {NULL}; 	/**< 	Octants of the next empty cube 	*/
+	int 			i 				= 0;
+	int 			level 			= 0;
+
+	cache = (struct cache *) calloc(1, sizeof(struct cache));
+	alloc_check(cache);
+	cache->buckets = (struct node **) calloc(TABLE_MIN_SIZE, sizeof(struct node *));
+	alloc_check(cache->buckets);
+	cache->capacity = TABLE_MIN_SIZE;
+	cache->shift = 64 - 10;
+	cache->count = 0;
+	cache->limit = ((size_t) memory << 20) / sizeof(struct node);
+	cache->lookups = 0;
+	cache->tiled = 0;
+	cache->free_list = NULL;
+	cache->slabs = NULL;
+	cache->rule = rule;
+
+	/* The cells are the only nodes without children and are never in the buckets */
+	cache->alive = node_create(cache, 0);
+	cache->empty[0] = node_create(cache, 0);
+	for(level = 1; level < LEVELS; level++)
+	{
+		for(i = 0; i < 8; i++)
+		{
+			children[i] = cache->empty[level - 1];
+		}
+		cache->empty[level] = node_find(cache, children);
+	}
+
+	return cache;
+}
+
+/************************************************** CACHE_DESTROY **************************************************/
+/**
+ * Frees all the memory owned by the cache, including the nodes still in use
+ *
+ * @param cache 	Cache to destroy
+ */
+void cache_destroy(struct cache *cache)
+{
+	struct slab 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
+
+	while(cache->slabs != NULL)
+	{
+		aux = cache->slabs;
+		cache->slabs = cache->slabs->next;
+		free(aux);
+	}
+	free(cache->buckets);
+	free(cache);
+}
+
+/************************************************** CACHE_GROW **************************************************/
+/**
+ * Doubles the number of buckets of the cache and moves every node to its new bucket
+ *
+ * @param cache 	Cache to grow
+ */
+void cache_grow(struct cache *cache)
+{
+	struct node 	**buckets 	= NULL; 	/**< 	New buckets 							*/
+	struct node 	*node 		= NULL; 	/**< 	Node being moved 						*/
+	size_t 			bucket 		= 0;
+	size_t 			slot 		= 0; 		/**< 	Bucket of the node in the new array 	*/
+
+	buckets = (struct node **) calloc(2 * cache->capacity, sizeof(struct node *));
+	alloc_check(buckets);
+	cache->shift--;
+
+	for(bucket = 0; bucket < cache->capacity; bucket++)
+	{
+		while(cache->buckets[bucket] != NULL)
+		{
+			node = cache->buckets[bucket];
+			cache->buckets[bucket] = node->next;
+			slot = (size_t) (node_hash(node->children) >> cache->shift);
+			node->next = buckets[slot];
+			buckets[slot] = node;
+		}
+	}
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->capacity *= 2;
+}
+
+/************************************************** CELLS_BUILD **************************************************/
+/**
+ * Builds the node of the given level that tiles the space with copies of the torus, starting
+ * at the origin. The cells of every copy inside the node are turned into their Morton codes,
+ * which sorted group the cells of each octant together, so the octree is built from the bottom up
+ * with a single pass per level. Repeated cells are harmless, they just end in the same alive cell
+ *
+ * @param cache 	Cache of nodes
+ * @param cells 	Keys of the alive cells of the torus
+ * @param count 	Number of cells
+ * @param size 		Size of the sides of the torus
+ * @param level 	Level of the node, whose sides have 2^level cells
+ * @return 			Node with the copies of the torus
+ */
+struct node * cells_build(struct cache *cache, uint64_t *cells, int count, int size, int level)
+{
+	struct node 	*node 		= NULL;
+	uint64_t 		*codes 		= NULL; 	/**< 	Morton codes of the copies of the cells 	*/
+	uint64_t 		*buffer 	= NULL; 	/**< 	Buffer used to sort the codes 				*/
+	size_t 			capacity 	= 0;
+	size_t 			length 		= 0;
+	int 			copies 		= 0; 		/**< 	Most copies of a cell along each axis 		*/
+	int 			side 		= 0; 		/**< 	Size of the sides of the node 				*/
+	int 			i 			= 0;
+	int 			x 			= 0;
+	int 			y 			= 0;
+	int 			z 			= 0;
+
+	side = 1 << level;
+	copies = (side + size - 1) / size;
+	capacity = (size_t) count * copies * copies * copies + 1;
+	codes = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+	buffer = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+	alloc_check(codes);
+	alloc_check(buffer);
+
+	for(i = 0; i < count; i++)
+	{
+		for(x = KEY_X(cells[i]); x < side; x += size)
+		{
+			for(y = KEY_Y(cells[i]); y < side; y += size)
+			{
+				for(z = KEY_Z(cells[i]); z < side; z += size)
+				{
+					codes[length++] = morton_code(x, y, z);
+				}
+			}
+		}
+	}
+
+	cells_sort(codes, buffer, (int) length);
+	node = node_build(cache, codes, length, level);
+
+	free(codes);
+	free(buffer);
+
+	return node;
+}
+
+/************************************************** CELLS_PRINT **************************************************/
+/**
+ * Prints the given cells to the given output
+ *
+ * @param output 	Output buffer
+ * @param cells 	Keys of the alive cells, sorted
+ * @param count 	Number of cells
+ */
+void cells_print(struct output *output, uint64_t *cells, int count)
+{
+	int 	i 	= 0;
+
+	if(output->binary)
+	{
+		output_header(output, count);
+	}
+	for(i = 0; i < count; i++)
+	{
+		output_cell(output, KEY_X(cells[i]), KEY_Y(cells[i]), KEY_Z(cells[i]));
+	}
+}
+
+/************************************************** CELLS_SORT **************************************************/
+/**
+ * Sorts the given cells by x, then y and then z. As the coordinates are packed
+ * from the most to the least significant bits this is a plain LSD radix sort of the keys
+ *
+ * @param cells 	Keys of the cells
+ * @param buffer 	Buffer with room for count keys
+ * @param count 	Number of cells
+ */
+void cells_sort(uint64_t *cells, uint64_t *buffer, int count)
+{
+	uint64_t 	*from 		= NULL; 	/**< 	Keys sorted up to the previous pass 	*/
+	uint64_t 	*to 		= NULL; 	/**< 	Keys sorted up to the current pass 		*/
+	uint64_t 	*aux 		= NULL; 	/**< 	Auxilliary pointer 						*/
+	int 		*offsets 	= NULL; 	/**< 	Position of each digit in the output 	*/
+	int 		digit 		= 0;
+	int 		i 			= 0;
+	int 		shift 		= 0;
+	int 		total 		= 0;
+
+	offsets = (int *) calloc(1 << RADIX_BITS, sizeof(int));
+	alloc_check(offsets);
+
+	from = cells;
+	to = buffer;
+	for(shift = 0; shift < (3 * COORDINATE_BITS); shift += RADIX_BITS)
+	{
+		memset(offsets, 0, (1 << RADIX_BITS) * sizeof(int));
+		for(i = 0; i < count; i++)
+		{
+			offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++;
+		}
+		total = 0;
+		for(digit = 0; digit < (1 << RADIX_BITS); digit++)
+		{
+			i = offsets[digit];
+			offsets[digit] = total;
+			total += i;
+		}
+		for(i = 0; i < count; i++)
+		{
+			to[offsets[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++] = from[i];
+		}
+		aux = from;
+		from = to;
+		to = aux;
+	}
+	/* An odd number of passes leaves the result in the buffer */
+	if(from != cells)
+	{
+		memcpy(cells, from, count * sizeof(uint64_t));
+	}
+
+	free(offsets);
+}
+
+/************************************************** CELLS_TILE **************************************************/
+/**
+ * Builds the node of the given level that tiles the space with copies of the torus, starting at the
+ * origin, without a copy of every cell inside it. The torus is split in blocks whose size is the largest
+ * power of 2 that divides its size, so every node of a level of the blocks or above starts at a block.
+ * The octants of a node of the level above start 2^(level - 1) cells apart, which is a number of blocks
+ * that is prime with their odd number, so the nodes of a level are the multiples of that distance taken
+ * modulo the blocks, at most as many as the blocks. Each level is built from the one below in an array
+ * by multiple, and only where the level below has alive cells, so that a sparse torus stays cheap. The
+ * last tilings are remembered by the node of the torus itself, so a cube that stops changing or cycles
+ * is only tiled once
+ *
+ * @param cache 	Cache of nodes
+ * @param torus 	Node of the torus, as built by cells_build from its cells
+ * @param cells 	Keys of the alive cells of the torus
+ * @param count 	Number of cells
+ * @param size 		Size of the sides of the torus
+ * @param level 	Level of the node, whose sides hold at least 2 copies of the torus
+ * @return 			Node with the copies of the torus
+ */
+struct node * cells_tile(struct cache *cache, struct node *torus, uint64_t *cells, int count, int size, int level)
+{
+	struct node 	*children[8] 	= {NULL};
+	struct node 	**nodes 		= NULL; 	/**< 	Nodes of the current level by multiple, NULL if empty 	*/
+	struct node 	**below 		= NULL; 	/**< 	Nodes of the level below by multiple, NULL if empty 	*/
+	struct node 	**aux 			= NULL; 	/**< 	Auxilliary pointer 										*/
+	uint64_t 		*codes 			= NULL; 	/**< 	Block and Morton code of each cell 						*/
+	uint64_t 		*buffer 		= NULL; 	/**< 	Buffer used to sort the codes 							*/
+	size_t 			*listed 		= NULL; 	/**< 	Multiples of the current level that are not empty 		*/
+	size_t 			*previous 		= NULL; 	/**< 	Multiples of the level below that are not empty 		*/
+	size_t 			*swap 			= NULL; 	/**< 	Auxilliary pointer 										*/
+	size_t 			parents[3][2]; 				/**< 	Multiples above a multiple of the level below, by axis 	*/
+	size_t 			found[3]; 					/**< 	Number of multiples above, by axis 						*/
+	uint64_t 		mask 			= 0; 		/**< 	Mask of the coordinates inside a block 					*/
+	size_t 			blocks 			= 0; 		/**< 	Number of blocks along each side 						*/
+	size_t 			multiples 		= 0; 		/**< 	Multiples of the current level along each side 			*/
+	size_t 			sides 			= 0; 		/**< 	Multiples of the level below along each side 			*/
+	size_t 			length 			= 0; 		/**< 	Number of multiples listed for the current level 		*/
+	size_t 			remaining 		= 0; 		/**< 	Number of multiples listed for the level below 			*/
+	size_t 			index 			= 0;
+	size_t 			i 				= 0;
+	size_t 			x 				= 0;
+	size_t 			y 				= 0;
+	size_t 			z 				= 0;
+	int 			current 		= 0; 		/**< 	Level being built 										*/
+	int 			first 			= 0; 		/**< 	First code of the block 								*/
+	int 			last 			= 0; 		/**< 	Code after the last of the block 						*/
+	int 			octant 			= 0;
+	int 			shift 			= 0; 		/**< 	Level of the blocks 									*/
+
+	for(i = 0; i < TILE_HISTORY; i++)
+	{
+		if((cache->tori[i] == torus) && (cache->tilings[i]->level == level))
+		{
+			return cache->tilings[i];
+		}
+	}
+
+	for(shift = 0; ((size >> shift) & 1) == 0; shift++);
+	blocks = (size_t) size >> shift;
+	nodes = (struct node **) calloc(blocks * blocks * blocks, sizeof(struct node *));
+	below = (struct node **) calloc(blocks * blocks * blocks, sizeof(struct node *));
+	listed = (size_t *) malloc(blocks * blocks * blocks * sizeof(size_t));
+	previous = (size_t *) malloc(blocks * blocks * blocks * sizeof(size_t));
+	codes = (uint64_t *) malloc((count + 1) * sizeof(uint64_t));
+	buffer = (uint64_t *) malloc((count + 1) * sizeof(uint64_t));
+	alloc_check(nodes);
+	alloc_check(below);
+	alloc_check(listed);
+	alloc_check(previous);
+	alloc_check(codes);
+	alloc_check(buffer);
+
+	/* The blocks are the multiples of 1, built from the cells grouped by block with their Morton codes below the index of the block */
+	mask = (((uint64_t) 1) << shift) - 1;
+	for(i = 0; i < (size_t) count; i++)
+	{
+		codes[i] = ((((uint64_t) (KEY_X(cells[i]) >> shift) * blocks + (KEY_Y(cells[i]) >> shift)) * blocks + (KEY_Z(cells[i]) >> shift)) << (3 * shift))
+			| morton_code(KEY_X(cells[i]) & mask, KEY_Y(cells[i]) & mask, KEY_Z(cells[i]) & mask);
+	}
+	cells_sort(codes, buffer, count);
+	for(first = 0; first < count; first = last)
+	{
+		for(last = first; (last < count) && ((codes[last] >> (3 * shift)) == (codes[first] >> (3 * shift))); last++);
+		index = (size_t) (codes[first] >> (3 * shift));
+		nodes[index] = node_build(cache, &codes[first], last - first, shift);
+		listed[length++] = index;
+	}
+
+	/* The octants of the multiple k of a level are the multiples 2k and 2k + 1 of the level below, modulo the blocks */
+	multiples = blocks;
+	for(current = shift + 1; current <= level; current++)
+	{
+		aux = below;
+		below = nodes;
+		nodes = aux;
+		swap = previous;
+		previous = listed;
+		listed = swap;
+		remaining = length;
+		length = 0;
+		sides = multiples;
+		multiples = ((level - current < 63) && ((((uint64_t) 1) << (level - current)) < blocks)) ? (((size_t) 1) << (level - current)) : blocks;
+
+		/* The multiples with an octant that is not empty are marked with the empty node until they are built */
+		for(i = 0; i < remaining; i++)
+		{
+			found[0] = tile_parents(previous[i] / (sides * sides), sides, multiples, parents[0]);
+			found[1] = tile_parents((previous[i] / sides) % sides, sides, multiples, parents[1]);
+			found[2] = tile_parents(previous[i] % sides, sides, multiples, parents[2]);
+			for(x = 0; x < found[0]; x++)
+			{
+				for(y = 0; y < found[1]; y++)
+				{
+					for(z = 0; z < found[2]; z++)
+					{
+						index = (parents[0][x] * multiples + parents[1][y]) * multiples + parents[2][z];
+						if(nodes[index] == NULL)
+						{
+							nodes[index] = cache->empty[current];
+							listed[length++] = index;
+						}
+					}
+				}
+			}
+		}
+
+		for(i = 0; i < length; i++)
+		{
+			x = listed[i] / (multiples * multiples);
+			y = (listed[i] / multiples) % multiples;
+			z = listed[i] % multiples;
+			for(octant = 0; octant < 8; octant++)
+			{
+				index = (((2 * x + ((octant >> 2) & 1)) % sides) * sides + ((2 * y + ((octant >> 1) & 1)) % sides)) * sides + ((2 * z + (octant & 1)) % sides);
+				children[octant] = (below[index] != NULL) ? below[index] : cache->empty[current - 1];
+			}
+			nodes[listed[i]] = node_find(cache, children);
+		}
+		/* The array of the level below is left empty for the level above */
+		for(i = 0; i < remaining; i++)
+		{
+			below[previous[i]] = NULL;
+		}
+	}
+	children[0] = (nodes[0] != NULL) ? nodes[0] : cache->empty[level];
+	cache->tori[cache->tiled] = torus;
+	cache->tilings[cache->tiled] = children[0];
+	cache->tiled = (cache->tiled + 1) % TILE_HISTORY;
+
+	free(nodes);
+	free(below);
+	free(listed);
+	free(previous);
+	free(codes);
+	free(buffer);
+
+	return children[0];
+}
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
+	{
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
+		{
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
+		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** MORTON_CODE **************************************************/
+/**
+ * Interleaves the bits of the coordinates of a cell, x first, so that the 3 bits of each
+ * level of the octree are the index of the octant that holds the cell
+ *
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ * @return 			Morton code of the cell
+ */
+uint64_t morton_code(int x, int y, int z)
+{
+	uint64_t 	code 			= 0;
+	uint64_t 	value 			= 0; 		/**< 	Coordinate with its bits spread apart 	*/
+	int 		coordinates[3] 	= {x, y, z};
+	int 		i 				= 0;
+
+	for(i = 0; i < 3; i++)
+	{
+		value = (uint64_t) coordinates[i] & COORDINATE_MASK;
+		value = (value | (value << 32)) & 0x001f00000000ffffULL;
+		value = (value | (value << 16)) & 0x001f0000ff0000ffULL;
+		value = (value | (value << 8)) & 0x100f00f00f00f00fULL;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3ULL;
+		value = (value | (value << 2)) & 0x1249249249249249ULL;
+		code |= value << (2 - i);
+	}
+
+	return code;
+}
+
+/************************************************** NODE_BASE **************************************************/
+/**
+ * Computes the result of a node of level 2, the 2 by 2 by 2 cells of its center one generation
+ * later, straight from the rule. It is the only place where the rule is applied
+ *
+ * @param cache 	Cache of nodes
+ * @param node 		Node of level 2
+ * @return 			Node of level 1 with the next generation of the center
+ */
+struct node * node_base(struct cache *cache, struct node *node)
+{
+	struct node 	*children[8] 	= {NULL}; 	/**< 	Cells of the result 						*/
+	int 			cells[4][4][4]; 			/**< 	Whether each cell of the node is alive 		*/
+	int 			count 			= 0; 		/**< 	Number of alive neighbors 					*/
+	int 			x 				= 0;
+	int 			y 				= 0;
+	int 			z 				= 0;
+
+	for(x = 0; x < 4; x++)
+	{
+		for(y = 0; y < 4; y++)
+		{
+			for(z = 0; z < 4; z++)
+			{
+				cells[x][y][z] = (node->children[OCTANT(x >> 1, y >> 1, z >> 1)]->children[OCTANT(x & 1, y & 1, z & 1)] == cache->alive);
+			}
+		}
+	}
+
+	for(x = 1; x < 3; x++)
+	{
+		for(y = 1; y < 3; y++)
+		{
+			for(z = 1; z < 3; z++)
+			{
+				count = cells[x - 1][y][z] + cells[x + 1][y][z] + cells[x][y - 1][z] + cells[x][y + 1][z] + cells[x][y][z - 1] + cells[x][y][z + 1];
+				/* The rule gives the next state from the current one and the number of neighbors */
+				if(RULE_NEXT(cache->rule, cells[x][y][z], count))
+				{
+					children[OCTANT(x - 1, y - 1, z - 1)] = cache->alive;
+				}
+				else
+				{
+					children[OCTANT(x - 1, y - 1, z - 1)] = cache->empty[0];
+				}
+			}
+		}
+	}
+
+	return node_find(cache, children);
+}
+
+/************************************************** NODE_BUILD **************************************************/
+/**
+ * Builds the node of the given level with the cells of the given Morton codes
+ *
+ * @param cache 	Cache of nodes
+ * @param codes 	Morton codes of the cells, sorted
+ * @param count 	Number of codes
+ * @param level 	Level of the node
+ * @return 			Node with the cells
+ */
+struct node * node_build(struct cache *cache, uint64_t *codes, size_t count, int level)
+{
+	struct node 	*children[8] 	= {NULL};
+	size_t 			first 			= 0; 		/**< 	First code of the octant 				*/
+	size_t 			last 			= 0; 		/**< 	Code after the last of the octant 		*/
+	int 			shift 			= 0; 		/**< 	Position of the bits of the octant 		*/
+	int 			i 				= 0;
+
+	if(count == 0)
+	{
+		return cache->empty[level];
+	}
+	if(level == 0)
+	{
+		return cache->alive;
+	}
+
+	shift = 3 * (level - 1);
+	for(i = 0; i < 8; i++)
+	{
+		last = first;
+		while((last < count) && ((int) ((codes[last] >> shift) & 7) == i))
+		{
+			last++;
+		}
+		children[i] = node_build(cache, &codes[first], last - first, level - 1);
+		first = last;
+	}
+
+	return node_find(cache, children);
+}
+
+/************************************************** NODE_CELLS **************************************************/
+/**
+ * Collects the alive cells of a node that fall in the first size by size by size cells of the
+ * window it belongs to. The window is a piece of the space tiled with copies of the torus that
+ * starts at the given origin, so every cell of the torus is found exactly once
+ *
+ * @param cache 	Cache of nodes
+ * @param node 		Node
+ * @param x 		x-coordinate of the node in the window
+ * @param y 		y-coordinate of the node in the window
+ * @param z 		z-coordinate of the node in the window
+ * @param origin 	Position of the window in the tiled space, the same along every axis
+ * @param size 		Size of the sides of the torus
+ * @param cells 	Array where to store the keys of the cells, grown if needed
+ * @param count 	Number of keys in the array
+ * @param capacity 	Number of keys the array has room for
+ */
+void node_cells(struct cache *cache, struct node *node, uint64_t x, uint64_t y, uint64_t z, uint64_t origin, int size, uint64_t **cells, int *count, int *capacity)
+{
+	uint64_t 	half 	= 0; 		/**< 	Size of the sides of the octants 	*/
+	int 		i 		= 0;
+
+	if((node == cache->empty[node->level]) || (x >= (uint64_t) size) || (y >= (uint64_t) size) || (z >= (uint64_t) size))
+	{
+		return;
+	}
+
+	if(node->level == 0)
+	{
+		if((*count) == (*capacity))
+		{
+			(*capacity) = 2 * (*capacity) + 1;
+			(*cells) = (uint64_t *) realloc((*cells), (*capacity) * sizeof(uint64_t));
+			alloc_check((*cells));
+		}
+		(*cells)[(*count)++] = KEY((origin + x) % size, (origin + y) % size, (origin + z) % size);
+		return;
+	}
+
+	half = ((uint64_t) 1) << (node->level - 1);
+	for(i = 0; i < 8; i++)
+	{
+		node_cells(cache, node->children[i], x + ((i >> 2) & 1) * half, y + ((i >> 1) & 1) * half, z + (i & 1) * half, origin, size, cells, count, capacity);
+	}
+}
+
+/************************************************** NODE_CENTER **************************************************/
+/**
+ * Returns the node with the center of the given one, half as wide, at the same generation
+ *
+ * @param cache 	Cache of nodes
+ * @param node 		Node of level 2 or more
+ * @return 			Center of the node
+ */
+struct node * node_center(struct cache *cache, struct node *node)
+{
+	struct node 	*children[8] 	= {NULL};
+	int 			i 				= 0;
+
+	/* Each octant gives its own octant closest to the center */
+	for(i = 0; i < 8; i++)
+	{
+		children[i] = node->children[i]->children[7 - i];
+	}
+
+	return node_find(cache, children);
+}
+
+/************************************************** NODE_CREATE **************************************************/
+/**
+ * Takes a node out of the free list of the cache, growing it if needed, and returns it.
+ * The node is not added to any bucket
+ *
+ * @param cache 	Cache from which the node is taken
+ * @param level 	Level of the node
+ * @return 			Pointer to the node
+ */
+struct node * node_create(struct cache *cache, int level)
+{
+	struct node 	*new 	= NULL; 	/**< 	Pointer to the new node 	*/
+
+	if(cache->free_list == NULL)
+	{
+		pool_grow(cache);
+	}
+
+	new = cache->free_list;
+	cache->free_list = new->next;
+	memset(new, 0, sizeof(struct node));
+	new->level = level;
+
+	return new;
+}
+
+/************************************************** NODE_FIND **************************************************/
+/**
+ * Returns the only node with the given octants, creating it if it is not in the cache yet.
+ * As equal cubes are always the same node, comparing nodes is comparing pointers
+ *
+ * @param cache 	Cache of nodes
+ * @param children 	Octants of the node, all of the same level
+ * @return 			Node
+ */
+struct node * node_find(struct cache *cache, struct node **children)
+{
+	struct node 	*node 	= NULL;
+	size_t 			slot 	= 0;
+
+	cache->lookups++;
+	slot = (size_t) (node_hash(children) >> cache->shift);
+	for(node = cache->buckets[slot]; node != NULL; node = node->next)
+	{
+		if(memcmp(node->children, children, 8 * sizeof(struct node *)) == 0)
+		{
+			return node;
+		}
+	}
+
+	node = node_create(cache, children[0]->level + 1);
+	memcpy(node->children, children, 8 * sizeof(struct node *));
+	node->next = cache->buckets[slot];
+	cache->buckets[slot] = node;
+	cache->count++;
+
+	if(cache->count > cache->capacity)
+	{
+		cache_grow(cache);
+	}
+
+	return node;
+}
+
+/************************************************** NODE_HASH **************************************************/
+/**
+ * Returns the hash of the given octants, whose high bits select the bucket of the node
+ *
+ * @param children 	Octants of the node
+ * @return 			Hash of the octants
+ */
+uint64_t node_hash(struct node **children)
+{
+	uint64_t 	hash 	= 0;
+	int 		i 		= 0;
+
+	for(i = 0; i < 8; i++)
+	{
+		hash = (hash ^ (uint64_t) (uintptr_t) children[i]) * 0x9E3779B97F4A7C15ULL;
+	}
+
+	return hash;
+}
+
+/************************************************** NODE_MARK **************************************************/
+/**
+ * Marks a node and every node it reaches as still in use
+ *
+ * @param node 		Node
+ * @param results 	Whether the results are followed as well as the octants
+ */
+void node_mark(struct node *node, int results)
+{
+	int 	i 	= 0;
+
+	if((node == NULL) || node->marked)
+	{
+		return;
+	}
+
+	node->marked = 1;
+	if(node->level > 0)
+	{
+		for(i = 0; i < 8; i++)
+		{
+			node_mark(node->children[i], results);
+		}
+	}
+	if(results)
+	{
+		node_mark(node->result, results);
+	}
+}
+
+/************************************************** NODE_STEP **************************************************/
+/**
+ * Returns the center of a node of level k, half as wide, 2^step generations later, for any step up to k - 2.
+ * The node is split in 27 overlapping cubes half as wide, whose centers are either taken as they are or,
+ * when the step is k - 2, advanced 2^(k - 3) generations first. Those centers are grouped in 8 cubes half as
+ * wide as the node again, whose results are the octants of the result. Each result is kept in its node, so a
+ * cube that shows up again, anywhere and at any time, is never computed twice
+ *
+ * @param cache 	Cache of nodes
+ * @param node 		Node of level 2 or more
+ * @param step 		Log2 of the number of generations to advance, at most the level of the node minus 2
+ * @return 			Center of the node 2^step generations later
+ */
+struct node * node_step(struct cache *cache, struct node *node, int step)
+{
+	struct node 	*grid[27] 		= {NULL}; 	/**< 	Centers of the overlapping cubes, by x * 9 + y * 3 + z 	*/
+	struct node 	*children[8] 	= {NULL}; 	/**< 	Octants of the cube being assembled 					*/
+	struct node 	*octants[8] 	= {NULL}; 	/**< 	Octants of the result 									*/
+	struct node 	*result 		= NULL;
+	int 			full 			= 0; 		/**< 	Whether the step is the largest the node allows 		*/
+	int 			i 				= 0;
+	int 			x 				= 0;
+	int 			y 				= 0;
+	int 			z 				= 0;
+
+	if((node->result != NULL) && (node->step == step))
+	{
+		return node->result;
+	}
+	if(node == cache->empty[node->level])
+	{
+		return cache->empty[node->level - 1];
+	}
+
+	if(node->level == 2)
+	{
+		result = node_base(cache, node);
+	}
+	else
+	{
+		full = (step == node->level - 2);
+		for(x = 0; x < 3; x++)
+		{
+			for(y = 0; y < 3; y++)
+			{
+				for(z = 0; z < 3; z++)
+				{
+					/* The cube starts x, y and z quarters of the node away from its corner */
+					for(i = 0; i < 8; i++)
+					{
+						children[i] = node_subcube(node, x + ((i >> 2) & 1), y + ((i >> 1) & 1), z + (i & 1));
+					}
+					result = node_find(cache, children);
+					grid[x * 9 + y * 3 + z] = full ? node_step(cache, result, step - 1) : node_center(cache, result);
+				}
+			}
+		}
+
+		for(x = 0; x < 2; x++)
+		{
+			for(y = 0; y < 2; y++)
+			{
+				for(z = 0; z < 2; z++)
+				{
+					for(i = 0; i < 8; i++)
+					{
+						children[i] = grid[(x + ((i >> 2) & 1)) * 9 + (y + ((i >> 1) & 1)) * 3 + (z + (i & 1))];
+					}
+					octants[OCTANT(x, y, z)] = node_step(cache, node_find(cache, children), full ? (step - 1) : step);
+				}
+			}
+		}
+		result = node_find(cache, octants);
+	}
+
+	node->result = result;
+	node->step = step;
+
+	return result;
+}
+
+/************************************************** NODE_SUBCUBE **************************************************/
+/**
+ * Returns the octant of an octant of a node, seen as a 4 by 4 by 4 grid of them
+ *
+ * @param node 		Node of level 2 or more
+ * @param x 		x-coordinate of the octant in the grid
+ * @param y 		y-coordinate of the octant in the grid
+ * @param z 		z-coordinate of the octant in the grid
+ * @return 			Octant of the octant
+ */
+struct node * node_subcube(struct node *node, int x, int y, int z)
+{
+	return node->children[OCTANT(x >> 1, y >> 1, z >> 1)]->children[OCTANT(x & 1, y & 1, z & 1)];
+}
+
+/************************************************** NODE_TILE **************************************************/
+/**
+ * Returns the node of the given level that tiles the space with copies of the given one
+ *
+ * @param cache 	Cache of nodes
+ * @param node 		Node whose sides have as many cells as the torus
+ * @param level 	Level of the copies, at least the level of the node
+ * @return 			Node with the copies
+ */
+struct node * node_tile(struct cache *cache, struct node *node, int level)
+{
+	struct node 	*children[8] 	= {NULL};
+	int 			i 				= 0;
+
+	while(node->level < level)
+	{
+		for(i = 0; i < 8; i++)
+		{
+			children[i] = node;
+		}
+		node = node_find(cache, children);
+	}
+
+	return node;
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, writing the buffer out first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL; 	/**< 	Where to format the next character 	*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** POOL_GROW **************************************************/
+/**
+ * Allocates a new slab of nodes and chains all of them in the free list of the cache
+ *
+ * @param cache 	Cache to grow
+ */
+void pool_grow(struct cache *cache)
+{
+	struct slab 	*slab 	= NULL; 	/**< 	Pointer to the new slab 		*/
+	int 			i 		= 0; 		/**< 	Index of the node in the slab 	*/
+
+	slab = (struct slab *) malloc(sizeof(struct slab));
+	alloc_check(slab);
+
+	for(i = 0; i < (POOL_SLAB_SIZE - 1); i++)
+	{
+		slab->nodes[i].next = &(slab->nodes[i+1]);
+	}
+	slab->nodes[POOL_SLAB_SIZE - 1].next = cache->free_list;
+	cache->free_list = &(slab->nodes[0]);
+
+	slab->next = cache->slabs;
+	cache->slabs = slab;
+}
+
+/************************************************** READ_ARGUMENTS **************************************************/
+/**
+ * Checks if the command line arguments verify the specifications
+ *
+ * @param argc 				Command line argument count
+ * @param argv				Command line arguments
+ * @param input_filename	Name of the file specified in the arguments
+ * @param iterations 		Number of iterations specified in the arguments
+ * @param memory 			Megabytes of nodes kept in the cache, CACHE_MEMORY by default
+ * @param binary 			Whether to print the solution in the binary format
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
+ */
+void read_arguments(int argc, char *argv[], char **input_filename, uint64_t *iterations, int *memory, int *binary, int *rule)
+{
+	FILE 	*input_fd 	= NULL;
+	char 	*end 		= NULL;
+	int 	i 			= 0;
+
+	if(argc < 3)
+	{
+		fprintf(stderr, "Program is run with ./life3d-hashlife [name-of-input-file] [number-of-iterations] [--memory megabytes] [--rule B../S..] [--binary]\n");
+		exit(-1);
+	}
+
+	(*memory) = CACHE_MEMORY;
+	(*binary) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if((strcmp(argv[i], "--memory") == 0) && (i + 1 < argc))
+		{
+			(*memory) = atoi(argv[++i]);
+			if((*memory) <= 0)
+			{
+				fprintf(stderr, "The memory must be >= 1\n");
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			(*rule) = read_rule(argv[++i]);
+			/* The empty cubes of every level are the same node and must stay empty, so no cell can be born without neighbors */
+			if(RULE_NEXT((*rule), 0, 0))
+			{
+				fprintf(stderr, "Rules with B0 are only supported by life3d-dense\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
+	(*input_filename) = argv[1];
+	input_fd = fopen((*input_filename), "r");
+	if(input_fd == NULL)
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+	fclose(input_fd);
+
+	/* The iterations are read as a 64-bit number, HashLife makes even that many practical */
+	errno = 0;
+	(*iterations) = strtoull(argv[2], &end, 10);
+	if((errno != 0) || (end == argv[2]) || ((*end) != '\0') || (argv[2][0] == '-') || ((*iterations) == 0) || ((*iterations) >> 63))
+	{
+		fprintf(stderr, "The number of iterations must be between 1 and 2^63 - 1\n");
+		exit(-1);
+	}
+}
+
+/************************************************** READ_COORDINATES **************************************************/
+/**
+ * Reads the input file, in text or in the binary format, and returns the keys of the given cells.
+ * Repeated cells are kept, building the octree merges them
+ *
+ * @param input 			Mapped input file
+ * @param count 			Number of cells read
+ * @param capacity 			Number of keys the returned array has room for
+ * @param size 				Size of the sides of the cube
+ * @return 					Keys of the cells
+ */
+uint64_t * read_coordinates(struct input *input, int *count, int *capacity, int size)
+{
+	uint64_t 	*cells 			= NULL;
+	char 		*next 			= NULL;
+	char 		*ptr 			= input->cursor;
+	int 		coordinates[3] 	= {0};
+	int 		length 			= 0;
+
+	/* Every line takes at least 6 bytes, so the length of the file bounds the number of cells */
+	(*capacity) = input->binary ? (int) input->count + 1 : (input->end - ptr) / 6 + 1;
+	cells = (uint64_t *) malloc((*capacity) * sizeof(uint64_t));
+	alloc_check(cells);
+
+	if(input->binary)
+	{
+		while((uint64_t) length < input->count)
+		{
+			binary_read_cell(input, coordinates, size);
+			cells[length++] = KEY(coordinates[0], coordinates[1], coordinates[2]);
+		}
+	}
+	else
+	{
+		while(ptr < input->end)
+		{
+			next = input_scan(ptr, input->end, coordinates, 3);
+			if(next == NULL)
+			{
+				input_error(input, ptr);
+			}
+			if((coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
+			{
+				input_error(input, ptr);
+			}
+			cells[length++] = KEY(coordinates[0], coordinates[1], coordinates[2]);
+			ptr = next;
+		}
+		input->cursor = ptr;
+	}
+	(*count) = length;
+
+	return cells;
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
+{
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
+
+	if((*ptr) == 'B')
+	{
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+		{
+			rule |= 1 << ((*ptr) - '0');
+		}
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
+		{
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
+		}
+	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
+}
+
+/************************************************** READ_SIZE **************************************************/
+/**
+ * Reads the input file and returns the declared size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return size 			Size of the sides of the cube
+ */
+int read_size(struct input *input)
+{
+	char 	*next 	= NULL;
+	int 	size 	= 0;
+
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
+	{
+		size = binary_read_header(input);
+	}
+	else
+	{
+		next = input_scan(input->cursor, input->end, &size, 1);
+		if(next == NULL)
+		{
+			input_error(input, input->cursor);
+		}
+		input->cursor = next;
+	}
+	if((size <= 0) || (size > MAX_SIZE))
+	{
+		fprintf(stderr, "The size of the cube must be between 1 and %d\n", MAX_SIZE);
+		exit(-1);
+	}
+
+	return size;
+}
+
+/************************************************** TILE_NODES **************************************************/
+/**
+ * Returns how many nodes cells_tile builds for the given level, which is about how many different
+ * nodes it is made of when the torus is dense, so that the steps do not outgrow the cache
+ *
+ * @param size 		Size of the sides of the torus
+ * @param level 	Level of the node
+ * @return 			Number of nodes, saturated at the largest size_t
+ */
+size_t tile_nodes(int size, int level)
+{
+	size_t 		total 		= 0;
+	size_t 		nodes 		= 0; 		/**< 	Nodes of the current level 		*/
+	size_t 		blocks 		= 0; 		/**< 	Number of blocks along each side 	*/
+	size_t 		multiples 	= 1; 		/**< 	Multiples of the current level by side 	*/
+	int 		shift 		= 0; 		/**< 	Level of the blocks 				*/
+
+	for(shift = 0; ((size >> shift) & 1) == 0; shift++);
+	blocks = (size_t) size >> shift;
+	for(; level >= shift; level--)
+	{
+		nodes = multiples * multiples * multiples;
+		if(total > SIZE_MAX - nodes)
+		{
+			return SIZE_MAX;
+		}
+		total += nodes;
+		multiples = (2 * multiples < blocks) ? (2 * multiples) : blocks;
+	}
+
+	return total;
+}
+/************************************************** TILE_PARENTS **************************************************/
+/**
+ * Finds the multiples of a level of the tiling that have the given multiple of the level below
+ * along one axis, which are the ones whose double, or double plus 1, is it modulo the multiples below
+ *
+ * @param multiple 	Multiple of the level below along the axis
+ * @param sides 	Multiples of the level below along each side
+ * @param multiples Multiples of the level along each side
+ * @param parents 	Array with room for the 2 multiples of the level found at most
+ * @return 			Number of multiples found
+ */
+int tile_parents(size_t multiple, size_t sides, size_t multiples, size_t *parents)
+{
+	size_t 		value 	= 0; 		/**< 	Double, or double plus 1, of the multiple being tried 	*/
+	int 		found 	= 0;
+	int 		octant 	= 0; 		/**< 	Whether the multiple is the second octant 				*/
+	int 		wrap 	= 0; 		/**< 	Whether the double wraps around the multiples below 	*/
+
+	for(octant = 0; octant < 2; octant++)
+	{
+		for(wrap = 0; wrap < 2; wrap++)
+		{
+			value = multiple + wrap * sides;
+			if((value >= (size_t) octant) && (((value - octant) & 1) == 0) && ((value - octant) / 2 < multiples))
+			{
+				parents[found++] = (value - octant) / 2;
+			}
+		}
+	}
+
+	return found;
+}
+/************************************************** MAIN **************************************************/
+int main(int argc, char *argv[])
+{
+	struct cache 	*cache 				= NULL; 	/**< 	Cache of nodes 								*/
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct node 	*torus 				= NULL; 	/**< 	Node of the torus 							*/
+	struct node 	*history[CYCLE_HISTORY] = {NULL}; 	/**< 	Tori at the start of the last steps 	*/
+	struct node 	*universe 			= NULL; 	/**< 	Node with the copies of the torus 			*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer for stdout 					*/
+	uint64_t 		*cells 				= NULL; 	/**< 	Cells alive in the current generation 		*/
+	uint64_t 		*buffer 			= NULL; 	/**< 	Buffer used to sort the solution 			*/
+	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	uint64_t 		iterations 			= 0; 		/**< 	Number of iterations to run the problem 	*/
+	uint64_t 		lefts[CYCLE_HISTORY] 	= {0}; 		/**< 	Iterations left when each torus was seen 	*/
+	size_t 			costs[LEVELS] 		= {0}; 		/**< 	Lookups per generation of the last step of each size 	*/
+	size_t 			firsts[LEVELS] 		= {0}; 		/**< 	Lookups of the first step of each size 		*/
+	size_t 			lookups 			= 0; 		/**< 	Lookups of the cache before the step 		*/
+	uint64_t 		backoff 			= 1; 		/**< 	Steps to wait after the next failed try 	*/
+	uint64_t 		wait 				= 0; 		/**< 	Steps left before trying a larger one 		*/
+	int 			binary 				= 0; 		/**< 	Whether to print in the binary format 		*/
+	int 			capacity 			= 0; 		/**< 	Number of keys cells has room for 			*/
+	int 			ceiling 			= 0; 		/**< 	Log2 of the generations of the largest step 	*/
+	int 			count 				= 0; 		/**< 	Number of alive cells 						*/
+	int 			i 					= 0;
+	int 			level 				= 0; 		/**< 	Level of the node that holds the torus 		*/
+	int 			memory 				= 0; 		/**< 	Megabytes of nodes kept in the cache 		*/
+	int 			repeats 			= 0; 		/**< 	Steps as large as the ceiling since it moved 	*/
+	int 			rule 				= 0; 		/**< 	Lookup table of the rule 					*/
+	int 			slot 				= 0; 		/**< 	Slot of the history for the next torus 		*/
+	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
+	int 			step 				= 0; 		/**< 	Log2 of the generations of the next step 	*/
+
+	/* Read the arguments given to the program */
+	read_arguments(argc, argv, &input_filename, &iterations, &memory, &binary, &rule);
+	/* Read the size of the problem */
+	input = input_map(input_filename);
+	size = read_size(input);
+	output = output_create(STDOUT_FILENO, binary, size, input->generation + iterations);
+	/* Create the data structures and read the input file */
+	cache = cache_create(memory, rule);
+	cells = read_coordinates(input, &count, &capacity, size);
+	input_unmap(input);
+
+	for(level = 0; (1 << level) < size; level++);
+	if((size & (size - 1)) == 0)
+	{
+		/* The torus tiles the space with nodes that are all the same, so it stays a node from beginning to end
+		 * and every step takes the largest power of 2 generations left. The node is at least 4 times as wide
+		 * as the torus, so the center of the result starts at a corner of a copy of it */
+		torus = cells_build(cache, cells, count, size, level);
+		while(iterations > 0)
+		{
+			for(step = 0; (iterations >> (step + 1)) > 0; step++);
+			universe = node_tile(cache, torus, (step > level) ? (step + 2) : (level + 2));
+			torus = node_step(cache, universe, step);
+			while(torus->level > level)
+			{
+				torus = torus->children[0];
+			}
+			iterations -= ((uint64_t) 1) << step;
+			if(cache->count > cache->limit)
+			{
+				cache_collect(cache, torus);
+			}
+		}
+		count = 0;
+		node_cells(cache, torus, 0, 0, 0, 0, size, &cells, &count, &capacity);
+	}
+	else
+	{
+		/* Otherwise the nodes of the copies depend on where they start, so the space is tiled again from the
+		 * cells every step and the cells are read back from the first copy in the center of the result. Each level
+		 * of a larger node holds the copies at more positions, which only pays off once the cube is regular enough,
+		 * so the steps take the largest power of 2 generations left up to a ceiling. The ceiling is raised while a
+		 * step costs fewer lookups per generation than a step half as large, and lowered otherwise, to be raised
+		 * again after twice as many steps as the last time. The nodes of the tiling must also fit in the cache.
+		 * A node is the same only for the same cells, so a torus seen again some steps earlier is a cycle and the
+		 * iterations left are cut to less than its period */
+		level = (level + 1 > 2) ? (level + 1) : 2;
+		ceiling = level - 2;
+		while(iterations > 0)
+		{
+			torus = cells_build(cache, cells, count, size, level - 1);
+			for(i = 0; i < CYCLE_HISTORY; i++)
+			{
+				if((history[i] == torus) && (lefts[i] > iterations))
+				{
+					iterations %= lefts[i] - iterations;
+					memset(history, 0, CYCLE_HISTORY * sizeof(struct node *));
+					break;
+				}
+			}
+			if(iterations == 0)
+			{
+				break;
+			}
+			history[slot] = torus;
+			lefts[slot] = iterations;
+			slot = (slot + 1) % CYCLE_HISTORY;
+			for(step = 0; (step < ceiling) && ((iterations >> (step + 1)) > 0); step++);
+			while((step > level - 2) && (tile_nodes(size, step + 2) > cache->limit / TILE_SHARE))
+			{
+				step--;
+			}
+			lookups = cache->lookups;
+			universe = (step > level - 2) ? cells_tile(cache, torus, cells, count, size, step + 2) : cells_build(cache, cells, count, size, level);
+			count = 0;
+			node_cells(cache, node_step(cache, universe, step), 0, 0, 0, ((uint64_t) 1) << (universe->level - 2), size, &cells, &count, &capacity);
+			iterations -= ((uint64_t) 1) << step;
+			/* The first step of a size computes what the next ones find in the cache, so it is not judged. Judging a larger
+			 * size takes 2 steps of twice the generations that may cost twice as much each, so it is only tried if that can
+			 * be won back by halving the cost of the generations left, with the first step as the measure of what it costs */
+			costs[step] = (cache->lookups - lookups) >> step;
+			if((step == ceiling) && (++repeats == 1))
+			{
+				firsts[step] = cache->lookups - lookups;
+			}
+			else if(step == ceiling)
+			{
+				if((step > level - 2) && (costs[step] > costs[step - 1]))
+				{
+					ceiling--;
+					wait = backoff;
+					backoff *= 2;
+				}
+				else if(wait > 0)
+				{
+					wait--;
+				}
+				else if(PROBE_FACTOR * (firsts[step] / (costs[step] + 1)) <= iterations)
+				{
+					ceiling++;
+					repeats = 0;
+				}
+			}
+			if(cache->count > cache->limit)
+			{
+				/* The nodes of the history may be freed, and their memory taken by other nodes */
+				cache_collect(cache, universe);
+				memset(history, 0, CYCLE_HISTORY * sizeof(struct node *));
+			}
+		}
+	}
+
+	/* Sort and print the solution to stdout */
+	buffer = (uint64_t *) malloc((count + 1) * sizeof(uint64_t));
+	alloc_check(buffer);
+	cells_sort(cells, buffer, count);
+	cells_print(output, cells, count);
+	output_destroy(output);
+	/* Destroy the data structures */
+	cache_destroy(cache);
+	free(cells);
+	free(buffer);
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Times life3d-mpi on the example inputs with several ghost depths and checks every solution
+#
+# Usage: ./life3d-mpi-benchmark.sh [number-of-processes] [ghost-depth...]
+#
+# Environment:
+#   MPIRUN      Command that launches the processes (default: mpirun)
+#   PROGRAM     MPI program to run (default: ./life3d-mpi)
+#   EXAMPLES    Directory with the .in and .out files (default: life3D-examples)
+
+PROCESSES=${1:-4}
+if [ $# -gt 0 ]; then
+	shift
+fi
+DEPTHS=${*:-1 2 4 8}
+MPIRUN=${MPIRUN:-mpirun}
+PROGRAM=${PROGRAM:-./life3d-mpi}
+EXAMPLES=${EXAMPLES:-life3D-examples}
+
+SOLUTION=$(mktemp)
+ERRORS=$(mktemp)
+trap 'rm -f "$SOLUTION" "$ERRORS"' EXIT
+TIMEFORMAT=%R
+
+printf "%-24s %6s %10s  %s\n" "input" "depth" "seconds" "solution"
+for expected in "$EXAMPLES"/*.out; do
+	name=$(basename "$expected" .out)
+	input="$EXAMPLES/${name%.*}.in"
+	iterations=${name##*.}
+	for depth in $DEPTHS; do
+		seconds=$( { time $MPIRUN -np "$PROCESSES" "$PROGRAM" "$input" "$iterations" --ghost-depth "$depth" > "$SOLUTION" 2> "$ERRORS"; } 2>&1 )
+		# The program refuses ghost zones deeper than the blocks, which is not a failure of the depth
+		if grep -q "ghost zones are deeper than the blocks" "$ERRORS"; then
+			result="skipped (blocks thinner than depth)"
+		elif [ ! -s "$SOLUTION" ] && [ -s "$expected" ]; then
+			result="failed"
+		elif cmp -s "$SOLUTION" "$expected"; then
+			result="ok"
+		else
+			result="wrong"
+		fi
+		printf "%-24s %6s %10s  %s\n" "$(basename "$input") ($iterations)" "$depth" "$seconds" "$result"
+	done
+done
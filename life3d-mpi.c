@@ -12,69 +12,132 @@
  * \date 		19/05/2017
  */
 /************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /************************************************** DEFINE **************************************************/
 #define ALIVE 								1
+#define BACK 								5
+#define BINARY_DELTA 						1
+#define BINARY_HEADER_SIZE 					32
+#define BINARY_MAGIC 						"L3DB"
+#define BINARY_MAX_SIZE 					(1 << 21)
+#define BINARY_VERSION 						1
 #define DEAD 								0
-#define DOWN 								1
-#define BUFFER_SIZE							200
+#define DEPTH 								2
+#define DOWN 								3
+#define FRONT 								4
 #define HORIZONTAL 							1
-#define LEFT 								2
-#define NDIMS 								2
+#define LEFT 								0
+#define NDIMS 								3
 #define NEIGHBOR 							1
 #define NEW 								0
-#define RIGHT 								3
+#define NFACES 								6
+#define OUTPUT_BUFFER_SIZE					65536
+#define OUTPUT_CHUNK_SIZE					16384
+#define OUTPUT_LINE_SIZE					36
+#define POOL_SLAB_SIZE						4096
+#define RIGHT 								1
 #define ROOT 								0
-#define UP 									0
+#define RULE_DEFAULT 						0x1c0c
+#define UP 									2
 #define VERTICAL 							0
-#define GLOBAL_TO_LOCAL(a, offset) 			((a) - (offset) + 1)
-#define LOCAL_TO_GLOBAL(a, offset) 			((a) + (offset) - 1)
-#define MOD(a, b) 							(((a) < 0) ? ((a) % (b) + (b)) : ((a) % (b)))
+#define GLOBAL_TO_LOCAL(a, offset, depth) 	((a) - (offset) + (depth))
+#define LOCAL_TO_GLOBAL(a, offset, depth) 	((a) + (offset) - (depth))
+#define OPPOSITE(a) 						((a) ^ 1)
+#define RULE_NEXT(rule, alive, count) 		(((rule) >> (((alive) << 3) | (count))) & 1)
+/* Without OpenMP the pragmas expand to nothing and every process runs a single thread */
+#ifdef _OPENMP
+#define OMP(directive) 						_Pragma(#directive)
+#else
+#define OMP(directive)
+#define omp_get_max_threads() 				1
+#define omp_get_num_threads() 				1
+#define omp_get_thread_num() 				0
+#endif
 
 /************************************************** PROTOTYPES **************************************************/
-struct 					border;
 struct 					coordinates;
+struct 					input;
 struct 					node;
+struct 					output;
+struct 					pool;
+struct 					slab;
 void 					alloc_check 					(void *ptr);
-struct node *** 		array_to_block 					(struct coordinates *array, int size_array, int size_x, int size_y);
-void 					block_add_halo_horizontal 		(struct node ***block, struct border *halo, int size_halo, int position_y);
-void 					block_add_halo_vertical 		(struct node ***block, struct border *halo, int size_halo, int position_x);
-int 					block_alive_count 				(struct node ***block, int size_x, int size_y);
+struct coordinates * 	array_migrate 					(struct coordinates *array, int size_array, int *size_received, int **cuts, int *dimensions, int size, int num_procs,
+															MPI_Datatype type, MPI_Comm comm);
+struct node *** 		array_to_block 					(struct pool *pool, struct coordinates *array, int size_array, int first_x, int first_y, int first_z, int depth,
+															int size_x, int size_y);
+int 					band_count 						(int width);
+void 					binary_error 					(struct input *input);
+uint64_t 				binary_get 						(unsigned char *ptr, int bytes);
+void 					binary_put 						(unsigned char *ptr, uint64_t value, int bytes);
+void 					binary_read_cell 				(struct input *input, int *coordinates, int size);
+int 					binary_read_header 				(struct input *input);
+int 					binary_split 					(uint64_t key, int *coordinates, int size);
+void 					block_add_halos 				(struct pool **pools, struct node ***block, struct coordinates **halos, int *counts, int first_face, int last_face, int depth, int *sizes);
+int 					block_alive_count 				(struct node ***block, int depth, int size_x, int size_y, int size_z);
+void 					block_bounds 					(int *cuts, int coordinate, int depth, int *first, int *last, int *size_block);
+void 					block_clear 					(struct pool *pool, struct node ***block, int size_x, int size_y);
 struct node *** 		block_create 					(int size_x, int size_y);
-void 					block_destroy 					(struct node ***block, int size_x, int size_y);
-void 					block_parameters 				(int *cart_coordinates, int *cart_dimensions, int *coordinate_x, int *coordinate_y,
-															int *first_x, int *first_y, int *last_x, int *last_y, int *size_x, int *size_y, int size);
-void 					block_print_cells 				(struct node ***block, int size_x, int size_y, int status);
-struct coordinates * 	block_to_array 					(struct node ***block, int *size_array, int first_x, int first_y, int size_x, int size_y);
-int 					border_alive_count 				(struct node **border, int size_border, int step);
-struct border * 		border_to_array_horizontal 		(struct node **border, int *size_array, int size_border, int step);
-struct border * 		border_to_array_vertical 		(struct node **border, int *size_array, int size_border, int step);
-void 					determine_next_generation 		(struct node ***block, int size_x, int size_y);
+void 					block_destroy 					(struct node ***block);
+void 					block_parameters 				(int coordinate, int dimension, int depth, int *first, int *last, int *size_block, int size);
+struct coordinates * 	block_to_array 					(struct node ***block, int *size_array, int first_x, int first_y, int first_z, int depth, int size_x, int size_y, int size_z);
+void 					block_to_border 				(struct node ***block, struct coordinates **array, int *capacity, int *size_array, int *first, int *last, int axis);
+int 					border_alive_count 				(struct node ***block, int *first, int *last);
+void 					border_bounds 					(int face, int depth, int *sizes, int *first, int *last);
+void 					border_reserve 					(struct coordinates **array, int *capacity, int size_array);
+void 					determine_next_generation 		(struct pool **pools, struct node ***block, int *low, int *high, int size_x, int size_y, int rule);
 int 					get_count_total 				(int *counts, int num_procs);
 int * 					get_displs 						(int *counts, int num_procs);
-void 					mark_neighbors_halo_horizontal 	(struct node ***block, int source, int destination, int size_x);
-void 					mark_neighbors_halo_vertical 	(struct node ***block, int source, int destination, int size_y);
-void 					node_add 						(struct node **head, short mode, short status, short x, short y, short z);
-struct node * 			node_create 					(short status, short x, short y, short z);
-void 					read_arguments 					(int argc, char *argv[], char **input_filename, int *iterations);
-void 					read_coordinates 				(FILE *input_fd, struct node ***block, int first_x, int first_y, int last_x, int last_y);
-int 					read_size 						(FILE *input_fd);
-
-/************************************************** STRUCT BORDER **************************************************/
-/** \struct
- * Structure that represents the coordinates of a block border used in the MPI communications
- * Only holds two values as the third can be inferred by knowing who is sending the message
- */
-struct border
-{
-	short a;
-	short b;
-};
+void 					halo_create 					(struct coordinates **halos, MPI_Request *requests, int *neighbors, int depth, int *sizes, MPI_Datatype type, MPI_Comm comm);
+void 					halo_destroy 					(struct coordinates **halos, MPI_Request *requests);
+int 					halo_search 					(struct coordinates *halo, int count, int x);
+void 					halo_wait 						(MPI_Request *requests, MPI_Status *statuses, int *counts, int count, MPI_Datatype type);
+char * 					input_align 					(struct input *input, char *ptr);
+void 					input_error 					(struct input *input, char *ptr);
+struct input * 			input_map 						(char *input_filename);
+char * 					input_scan 						(char *ptr, char *end, int *values, int count);
+void 					input_unmap 					(struct input *input);
+void 					mark_cell_neighbors 			(struct pool *pool, struct node ***block, int x, int y, int z, int *low, int *high);
+void 					mark_neighbors 					(struct pool **pools, struct node ***block, int *first, int *last, int *low, int *high);
+void 					merge_sift 						(int *heap, int count, uint64_t *keys, int position);
+void 					node_add 						(struct pool *pool, struct node **head, short mode, short status, short x, short y, short z);
+struct node * 			node_create 					(struct pool *pool, short status, short x, short y, short z);
+void 					node_destroy 					(struct pool *pool, struct node *node);
+void 					output_cell 					(struct output *output, int x, int y, int z);
+struct output * 		output_create 					(int fd, int binary, int size, uint64_t generation);
+void 					output_destroy 					(struct output *output);
+void 					output_flush 					(struct output *output);
+void 					output_header 					(struct output *output, uint64_t count);
+char * 					output_int 						(char *ptr, int value);
+void 					output_merge 					(struct output *output, struct coordinates *array, int size_array, int *counts, int num_procs,
+															MPI_Datatype type, MPI_Comm comm);
+void 					output_send 					(struct coordinates *array, int size_array, MPI_Datatype type, MPI_Comm comm);
+void 					output_write 					(int fd, char *data, size_t length);
+struct pool * 			pool_create 					(void);
+void 					pool_destroy 					(struct pool *pool);
+void 					pool_grow 						(struct pool *pool);
+void 					read_arguments 					(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *depth, int *rebalance, int *rule);
+struct coordinates * 	read_coordinates 				(struct input *input, int *size_array, int rank, int num_procs, int size);
+int 					read_rule 						(char *text);
+int 					read_size 						(struct input *input);
+void 					rebalance_cuts 					(int *histogram, int size, int dimension, int depth, int *cuts);
 
 /************************************************** STRUCT COORDINATES **************************************************/
 /** \struct
@@ -87,6 +150,24 @@ struct coordinates
 	short z;
 };
 
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 		*cursor;
+	char 		*data;
+	char 		*end;
+	size_t 		length;
+	uint64_t 	count;
+	uint64_t 	generation;
+	uint64_t 	key;
+	int 		binary;
+	int 		flags;
+};
+
 /************************************************** STRUCT NODE **************************************************/
 /** \struct
  * Structure that represents the cells used in the blocks.
@@ -101,6 +182,43 @@ struct node
 	struct node 		*next;
 };
 
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 		*buffer;
+	size_t 		capacity;
+	size_t 		length;
+	int 		fd;
+	uint64_t 	generation;
+	int 		binary;
+	int 		size;
+};
+
+/************************************************** STRUCT POOL **************************************************/
+/** \struct
+ * Structure that recycles the nodes removed from the blocks so that,
+ * once the population stabilizes, no generation touches the heap
+ */
+struct pool
+{
+	struct node 	*free_list;
+	struct slab 	*slabs;
+};
+
+/************************************************** STRUCT SLAB **************************************************/
+/** \struct
+ * Structure that represents a block of nodes allocated at once by the pool
+ */
+struct slab
+{
+	struct node 	nodes[POOL_SLAB_SIZE];
+	struct slab 	*next;
+};
+
 /************************************************** ALLOC_CHECK **************************************************/
 /**
  * Checks if a given memory allocation was successful
@@ -116,17 +234,306 @@ void alloc_check(void *ptr)
 	}
 }
 
+/************************************************** BAND_COUNT **************************************************/
+/**
+ * Returns the number of bands along x in which the threads split a region of the block.
+ * The neighbors marked from a band reach one plane past each of its sides, so the bands are at least 2 planes wide
+ * and only every other band is handled at the same time
+ *
+ * @param width			Number of planes of the region along x
+ * @return 				Number of bands
+ */
+int band_count(int width)
+{
+	int 	num_bands 	= 0;
+
+	num_bands = 2 * omp_get_num_threads();
+	if(num_bands > (width / 2))
+	{
+		num_bands = width / 2;
+	}
+	if(num_bands < 1)
+	{
+		num_bands = 1;
+	}
+
+	return num_bands;
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0;
+	int 		i 		= 0;
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0;
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end;
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor;
+	uint64_t 		delta 	= 0;
+	int 			shift 	= 0;
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data;
+	size_t 			room 		= 0;
+	uint64_t 		size 		= 0;
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** ARRAY_MIGRATE **************************************************/
+/**
+ * Sends the cells of a given array to the processes whose blocks hold them after the cube is cut again,
+ * and returns the array of the cells received from all the processes
+ *
+ * @param array			Array of coordinates in the cube
+ * @param size_array	Size of the array
+ * @param size_received	Size of the array received
+ * @param cuts			First plane of the blocks along each dimension of the process grid, followed by the size of the cube
+ * @param dimensions	Number of processes along each dimension of the process grid
+ * @param size			Size of the cube
+ * @param num_procs		Number of processes
+ * @param type			Datatype of the coordinates
+ * @param comm			Communicator of the process grid
+ * @return 				Array of coordinates received
+ */
+struct coordinates * array_migrate(struct coordinates *array, int size_array, int *size_received, int **cuts, int *dimensions, int size, int num_procs,
+									MPI_Datatype type, MPI_Comm comm)
+{
+	struct coordinates 	*buffer 			= NULL;
+	struct coordinates 	*received 			= NULL;
+	int 				*destinations 		= NULL;
+	int 				*owners 			= NULL;
+	int 				*positions 			= NULL;
+	int 				*ranks 				= NULL;
+	int 				*recvcounts 		= NULL;
+	int 				*recvdispls 		= NULL;
+	int 				*sendcounts 		= NULL;
+	int 				*senddispls 		= NULL;
+	int 				coordinates[NDIMS] 	= {0};
+	int 				i 					= 0;
+	int 				j 					= 0;
+	int 				plane 				= 0;
+
+	/* Block of each plane along each dimension of the process grid */
+	owners = (int *) calloc(NDIMS * size, sizeof(int));
+	alloc_check(owners);
+	for(i = 0; i < NDIMS; i++)
+	{
+		for(j = 0; j < dimensions[i]; j++)
+		{
+			for(plane = cuts[i][j]; plane < cuts[i][j + 1]; plane++)
+			{
+				owners[(i * size) + plane] = j;
+			}
+		}
+	}
+
+	/* Rank of each process of the grid */
+	ranks = (int *) calloc(num_procs, sizeof(int));
+	alloc_check(ranks);
+	for(i = 0; i < num_procs; i++)
+	{
+		coordinates[0] = i / (dimensions[1] * dimensions[2]);
+		coordinates[1] = (i / dimensions[2]) % dimensions[1];
+		coordinates[2] = i % dimensions[2];
+		MPI_Cart_rank(comm, coordinates, &ranks[i]);
+	}
+
+	destinations = (int *) calloc(size_array + 1, sizeof(int));
+	sendcounts = (int *) calloc(num_procs, sizeof(int));
+	alloc_check(destinations);
+	alloc_check(sendcounts);
+	for(i = 0; i < size_array; i++)
+	{
+		coordinates[HORIZONTAL] = owners[(HORIZONTAL * size) + array[i].x];
+		coordinates[VERTICAL] = owners[(VERTICAL * size) + array[i].y];
+		coordinates[DEPTH] = owners[(DEPTH * size) + array[i].z];
+		destinations[i] = ranks[(((coordinates[0] * dimensions[1]) + coordinates[1]) * dimensions[2]) + coordinates[2]];
+		sendcounts[destinations[i]]++;
+	}
+
+	/* Group the cells by the process they are sent to */
+	senddispls = get_displs(sendcounts, num_procs);
+	positions = get_displs(sendcounts, num_procs);
+	buffer = (struct coordinates *) calloc(size_array + 1, sizeof(struct coordinates));
+	alloc_check(buffer);
+	for(i = 0; i < size_array; i++)
+	{
+		buffer[positions[destinations[i]]++] = array[i];
+	}
+
+	recvcounts = (int *) calloc(num_procs, sizeof(int));
+	alloc_check(recvcounts);
+	MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, comm);
+	recvdispls = get_displs(recvcounts, num_procs);
+	(*size_received) = get_count_total(recvcounts, num_procs);
+	received = (struct coordinates *) calloc((*size_received) + 1, sizeof(struct coordinates));
+	alloc_check(received);
+	MPI_Alltoallv(buffer, sendcounts, senddispls, type, received, recvcounts, recvdispls, type, comm);
+
+	free(buffer);
+	free(destinations);
+	free(owners);
+	free(positions);
+	free(ranks);
+	free(recvcounts);
+	free(recvdispls);
+	free(sendcounts);
+	free(senddispls);
+
+	return received;
+}
+
 /************************************************** ARRAY_TO_BLOCK **************************************************/
 /**
  * Turns an array of coordinates into a block of cells with the coordinates of said array
  *
+ * @param pool			Pool from which new nodes are taken
  * @param array			Array of coordinates
  * @param size_array	Size of the array
+ * @param first_x		First x-coordinate of the block
+ * @param first_y		First y-coordinate of the block
+ * @param first_z		First z-coordinate of the block
+ * @param depth			Depth of the ghost zones
  * @param size_x		Block size in x
  * @param size_y		Block size in y
  * @return 				Block
  */
-struct node *** array_to_block(struct coordinates *array, int size_array, int size_x, int size_y)
+struct node *** array_to_block(struct pool *pool, struct coordinates *array, int size_array, int first_x, int first_y, int first_z, int depth,
+								int size_x, int size_y)
 {
 	struct node 	***block 	= NULL;
 	int 			i 			= 0;
@@ -137,89 +544,116 @@ struct node *** array_to_block(struct coordinates *array, int size_array, int si
 	block = block_create(size_x, size_y);
 	for(i = 0; i < size_array; i++)
 	{
-		x = array[i].x;
-		y = array[i].y;
-		z = array[i].z;
-		node_add(&(block[x][y]), NEW, ALIVE, x, y, z);
+		x = GLOBAL_TO_LOCAL(array[i].x, first_x, depth);
+		y = GLOBAL_TO_LOCAL(array[i].y, first_y, depth);
+		z = GLOBAL_TO_LOCAL(array[i].z, first_z, depth);
+		node_add(pool, &(block[x][y]), NEW, ALIVE, x, y, z);
 	}
 
 	return block;
 }
 
-/************************************************** BLOCK_ADD_HALO_HORIZONTAL **************************************************/
+/************************************************** BLOCK_ADD_HALOS **************************************************/
 /**
- * Adds an array of coordinates corresponding to a border of a neighboring process (halo) to a given block
+ * Marks the neighbors of the cells of the halos of the given faces of the block and adds them to the block.
+ * Halos are received right before the first generation after an exchange, when only the sides of the block go wrong.
+ * Must be called by every thread of the team, as the block is split in bands along x between them
  *
+ * @param pools			Pools from which new nodes are taken, one for each thread
  * @param block			Block
- * @param halo			Array of coordinates
- * @param size_halo		Size of the array
- * @param position_y	Coordinate in which to add the array
+ * @param halos			Arrays of coordinates, one for each face
+ * @param counts		Number of cells of each halo
+ * @param first_face	First face whose halo is added
+ * @param last_face		Last face whose halo is added
+ * @param depth			Depth of the ghost zones
+ * @param sizes			Block sizes in x, y and z
  */
-void block_add_halo_horizontal(struct node ***block, struct border *halo, int size_halo, int position_y)
+void block_add_halos(struct pool **pools, struct node ***block, struct coordinates **halos, int *counts, int first_face, int last_face, int depth, int *sizes)
 {
-	int 	i 	= 0;
-	int 	x 	= 0;
-	int 	y 	= 0;
-	int 	z 	= 0;
+	struct pool 	*pool 			= NULL;
+	int 			coordinates[3] 	= {0};
+	int 			high[3] 		= {0};
+	int 			low[3] 			= {0};
+	int 			axis 			= 0;
+	int 			band 			= 0;
+	int 			face 			= 0;
+	int 			first_x 		= 0;
+	int 			i 				= 0;
+	int 			last_x 			= 0;
+	int 			num_bands 		= 0;
+	int 			offset 			= 0;
+	int 			offset_x 		= 0;
+	int 			parity 			= 0;
 
-	y = position_y;
-	for(i = 0; i < size_halo; i++)
+	for(i = 0; i < 3; i++)
 	{
-		x = halo[i].a;
-		z = halo[i].b;
-		node_add(&(block[x][y]), NEW, ALIVE, x, y, z);
+		low[i] = 1;
+		high[i] = sizes[i] - 2;
 	}
-}
-
-/************************************************** BLOCK_ADD_HALO_VERTICAL **************************************************/
-/**
- * Adds an array of coordinates corresponding to a border of a neighboring process (halo) to a given block
- *
- * @param block			Block
- * @param halo			Array of coordinates
- * @param size_halo		Size of the array
- * @param position_x	Coordinate in which to add the array
- */
-void block_add_halo_vertical(struct node ***block, struct border *halo, int size_halo, int position_x)
-{
-	int 	i 	= 0;
-	int 	x 	= 0;
-	int 	y 	= 0;
-	int 	z 	= 0;
 
-	x = position_x;
-	for(i = 0; i < size_halo; i++)
+	num_bands = band_count(sizes[0]);
+	for(parity = 0; parity < 2; parity++)
 	{
-		y = halo[i].a;
-		z = halo[i].b;
-		node_add(&(block[x][y]), NEW, ALIVE, x, y, z);
+		OMP(omp for schedule(dynamic, 1))
+		for(band = parity; band < num_bands; band += 2)
+		{
+			pool = pools[omp_get_thread_num()];
+			first_x = (band * sizes[0]) / num_bands;
+			last_x = (((band + 1) * sizes[0]) / num_bands) - 1;
+			for(face = first_face; face <= last_face; face++)
+			{
+				/* The neighbor sends the coordinate along the axis relative to its border, the halo starts on the side of the face */
+				axis = face / 2;
+				offset = ((face % 2) == 0) ? 0 : (sizes[axis] - depth);
+				offset_x = (axis == 0) ? offset : 0;
+				/* The halos keep the order in which the borders were walked, so each band starts at its first cell */
+				i = halo_search(halos[face], counts[face], first_x - offset_x);
+				while((i < counts[face]) && ((halos[face][i].x + offset_x) <= last_x))
+				{
+					coordinates[0] = halos[face][i].x;
+					coordinates[1] = halos[face][i].y;
+					coordinates[2] = halos[face][i].z;
+					coordinates[axis] += offset;
+					mark_cell_neighbors(pool, block, coordinates[0], coordinates[1], coordinates[2], low, high);
+					/* The cells on the sides of the block die in this generation, so unless deeper ghost zones pass them
+					   on to the neighbors along the next axes they are only needed to mark their neighbors */
+					if((depth > 1) || ((coordinates[0] >= low[0]) && (coordinates[0] <= high[0]) && (coordinates[1] >= low[1]) && (coordinates[1] <= high[1]) && (coordinates[2] >= low[2]) && (coordinates[2] <= high[2])))
+					{
+						node_add(pool, &(block[coordinates[0]][coordinates[1]]), NEW, ALIVE, coordinates[0], coordinates[1], coordinates[2]);
+					}
+					i++;
+				}
+			}
+		}
 	}
 }
 
 /************************************************** BLOCK_ALIVE_COUNT **************************************************/
 /**
- * Counts and return the number of alive cells in a given block
+ * Counts and return the number of alive cells in a given block, leaving out its ghost zones
  *
  * @param block			Block
+ * @param depth			Depth of the ghost zones
  * @param size_x		Block size in x
  * @param size_y		Block size in y
+ * @param size_z		Block size in z
  * @return 				Count
  */
-int block_alive_count(struct node ***block, int size_x, int size_y)
+int block_alive_count(struct node ***block, int depth, int size_x, int size_y, int size_z)
 {
 	struct node 	*aux 	= NULL;
 	int 			count 	= 0;
 	int 			x 		= 0;
 	int 			y 		= 0;
 
-	for(x = 1; x < (size_x - 1); x++)
+	for(x = depth; x < (size_x - depth); x++)
 	{
-		for(y = 1; y < (size_y - 1); y++)
+		for(y = depth; y < (size_y - depth); y++)
 		{
 			aux = block[x][y];
 			while(aux != NULL)
 			{
-				if(aux->status == ALIVE)
+				if((aux->status == ALIVE) && (aux->coords.z >= depth) && (aux->coords.z < (size_z - depth)))
 				{
 					count++;
 				}
@@ -231,6 +665,53 @@ int block_alive_count(struct node ***block, int size_x, int size_y)
 	return count;
 }
 
+/************************************************** BLOCK_BOUNDS **************************************************/
+/**
+ * Computes the size and delimiters along one axis of the block handled by a given process from the cuts of the cube
+ *
+ * @param cuts					First plane of the blocks along the axis, followed by the size of the cube
+ * @param coordinate			Coordinate of the process in the process grid along the axis
+ * @param depth					Depth of the ghost zones
+ * @param first					First coordinate of the data to be handled by the process
+ * @param last					Last coordinate of the data to be handled by the process
+ * @param size_block			Size of the block of the data to be handled by the process, halos included
+ */
+void block_bounds(int *cuts, int coordinate, int depth, int *first, int *last, int *size_block)
+{
+	(*first) = cuts[coordinate];
+	(*last) = cuts[coordinate + 1] - 1;
+	(*size_block) = (*last) - (*first) + 1 + (2 * depth);
+}
+
+/************************************************** BLOCK_CLEAR **************************************************/
+/**
+ * Removes all the cells of a given block, keeping the nodes in the pool for reuse
+ *
+ * @param pool			Pool where the removed nodes are kept for reuse
+ * @param block			Block
+ * @param size_x		Block size in x
+ * @param size_y		Block size in y
+ */
+void block_clear(struct pool *pool, struct node ***block, int size_x, int size_y)
+{
+	struct node 	*aux 	= NULL;
+	int 			x 		= 0;
+	int 			y 		= 0;
+
+	for(x = 0; x < size_x; x++)
+	{
+		for(y = 0; y < size_y; y++)
+		{
+			while(block[x][y] != NULL)
+			{
+				aux = block[x][y];
+				block[x][y] = aux->next;
+				node_destroy(pool, aux);
+			}
+		}
+	}
+}
+
 /************************************************** BLOCK_CREATE **************************************************/
 /**
  * Creates a block with the given sizes in x and y and returns a pointer to it
@@ -257,337 +738,308 @@ struct node *** block_create(int size_x, int size_y)
 
 /************************************************** BLOCK_DESTROY **************************************************/
 /**
- * Destroys a given block with the given sizes in x and y
+ * Destroys a given block.
+ * The nodes themselves belong to the pool and are released by pool_destroy
  *
  * @param block			Block
- * @param size_x		Block size in x
- * @param size_y		Block size in y
  */
-void block_destroy(struct node ***block, int size_x, int size_y)
+void block_destroy(struct node ***block)
 {
-	struct node 	*aux 	= NULL;
-	int 			x 		= 0;
-	int 			y 		= 0;
-
-	for(x = 0; x < size_x; x++)
-	{
-		for(y = 0; y < size_y; y++)
-		{
-			while(block[x][y] != NULL)
-			{
-				aux = block[x][y];
-				block[x][y] = block[x][y]->next;
-				free(aux);
-			}
-		}
-	}
 	free(block[0]);
 	free(block);
 }
 
 /************************************************** BLOCK_PARAMETERS **************************************************/
 /**
- * Computes the sizes and delimiters for the block to be handled by a given processor
+ * Computes the size and delimiters along one axis of the block to be handled by a given processor.
+ * It is called once for each of the x, y and z axes
  *
- * @param cart_coordinates		Coordinates of the process in the process grid
- * @param cart_dimensions		Dimensions of the process grid
- * @param coordinate_x			x-coordinate of the process
- * @param coordinate_y			x-coordinate of the process
- * @param first_x				First x-coordinate of the data to be handled by the process
- * @param first_y				First y-coordinate of the data to be handled by the process
- * @param last_x				Last x-coordinate of the data to be handled by the process
- * @param last_y				Last y-coordinate of the data to be handled by the process
- * @param size_x				Size of the x-coordinate block of the data to be handled by the process
- * @param size_y				Size of the y-coordinate block of the data to be handled by the process
+ * @param coordinate			Coordinate of the process in the process grid along the axis
+ * @param dimension				Number of processes in the process grid along the axis
+ * @param depth					Depth of the ghost zones
+ * @param first					First coordinate of the data to be handled by the process
+ * @param last					Last coordinate of the data to be handled by the process
+ * @param size_block			Size of the block of the data to be handled by the process, halos included
  * @param size					Size of the cube
  */
-void block_parameters(int *cart_coordinates, int *cart_dimensions, int *coordinate_x, int *coordinate_y,
-						int *first_x, int *first_y, int *last_x, int *last_y, int *size_x, int *size_y, int size)
-{
-	int 	num_cols 		= 0;
-	int 	num_rows 		= 0;
-	int 	remainder_x 	= 0;
-	int 	remainder_y 	= 0;
-
-	/* x and y coordinates of each process */
-	(*coordinate_x) = cart_coordinates[1];
-	(*coordinate_y) = cart_coordinates[0];
-	/* Number of columns and rows of the cartesian topology */
-	num_cols = cart_dimensions[1];
-	num_rows = cart_dimensions[0];
-	/* x and y sizes of the blocks */
-	(*size_x) = size / num_cols;
-	(*size_y) = size / num_rows;
-	/* Remaining columns and rows if the problem size isn't evenly divisible */
-	remainder_x = size % num_cols;
-	remainder_y = size % num_rows;
-	/* x and y positions where each block starts */
-	(*first_x) = ((*size_x) * (*coordinate_x)) + remainder_x;
-	(*first_y) = ((*size_y) * (*coordinate_y)) + remainder_y;
-	/* x and y positions where each block ends */
-	(*last_x) = (*first_x) + (*size_x) - 1;
-	(*last_y) = (*first_y) + (*size_y) - 1;
-	/* If the process is on the first column add the remainder of the columns to it */
-	if((*coordinate_x) == 0)
-	{
-		(*first_x) -= remainder_x;
-		(*size_x) += remainder_x;
-	}
-	/* If the process is on the first row add the remainder of the rows to it */
-	if((*coordinate_y) == 0)
-	{
-		(*first_y) -= remainder_y;
-		(*size_y) += remainder_y;
-	}
-	/* Increase the size on both the x and y axis by 2 to store the halos of the neighboring processes */
-	(*size_x) += 2;
-	(*size_y) += 2;
+void block_parameters(int coordinate, int dimension, int depth, int *first, int *last, int *size_block, int size)
+{
+	int 	remainder 	= 0;
+
+	/* Every process needs at least one plane of the cube along each axis */
+	if(dimension > size)
+	{
+		fprintf(stderr, "Too many processes for a cube of size %d\n", size);
+		exit(-1);
+	}
+	/* The borders sent to the neighbors must fit in the smallest blocks */
+	if((size / dimension) < depth)
+	{
+		fprintf(stderr, "The ghost zones are deeper than the blocks of the processes\n");
+		exit(-1);
+	}
+	/* Size of the blocks */
+	(*size_block) = size / dimension;
+	/* Remaining planes if the problem size isn't evenly divisible */
+	remainder = size % dimension;
+	/* Positions where each block starts and ends */
+	(*first) = ((*size_block) * coordinate) + remainder;
+	(*last) = (*first) + (*size_block) - 1;
+	/* If the process is the first one along the axis add the remainder of the planes to it */
+	if(coordinate == 0)
+	{
+		(*first) -= remainder;
+		(*size_block) += remainder;
+	}
+	/* Increase the size on both sides by the depth of the ghost zones to store the halos of the neighboring processes */
+	(*size_block) += 2 * depth;
 }
 
-/************************************************** BLOCK_PRINT_CELLS **************************************************/
+/************************************************** BLOCK_TO_ARRAY **************************************************/
 /**
- * Prints the cells of a given block with the given status
+ * Turns a block of cells into an array of coordinates of the cells of said block
  *
  * @param block			Block
+ * @param size_array	Size of the array
+ * @param first_x		First x-coordinate of the data handled by the process (Used to turn the local indexes into global ones)
+ * @param first_y		First y-coordinate of the data handled by the process (Used to turn the local indexes into global ones)
+ * @param first_z		First z-coordinate of the data handled by the process (Used to turn the local indexes into global ones)
+ * @param depth			Depth of the ghost zones
  * @param size_x		Block size in x
  * @param size_y		Block size in y
- * @param status		Status of the cells to print
+ * @param size_z		Block size in z
+ * @return 				Array
  */
-void block_print_cells(struct node ***block, int size_x, int size_y, int status)
+struct coordinates * block_to_array(struct node ***block, int *size_array, int first_x, int first_y, int first_z, int depth, int size_x, int size_y, int size_z)
 {
-	struct node 	*aux 	= NULL;
-	int 			x 		= 0;
-	int 			y 		= 0;
+	struct coordinates 	*array 			= NULL;
+	struct coordinates 	*ptr 			= NULL;
+	struct node 		*aux 			= NULL;
+	int 				x 				= 0;
+	int 				y 				= 0;
 
-	for(x = 0; x < size_x; x++)
+	(*size_array) = block_alive_count(block, depth, size_x, size_y, size_z);
+	array = (struct coordinates *) calloc((*size_array), sizeof(struct coordinates));
+
+	ptr = array;
+	for(x = depth; x < (size_x - depth); x++)
 	{
-		for(y = 0; y < size_y; y++)
+		for(y = depth; y < (size_y - depth); y++)
 		{
 			aux = block[x][y];
 			while(aux != NULL)
 			{
-				if(aux->status == status)
+				if((aux->status == ALIVE) && (aux->coords.z >= depth) && (aux->coords.z < (size_z - depth)))
 				{
-					fprintf(stdout, "%d %d %d\n", aux->coords.x, aux->coords.y, aux->coords.z);
+					(*ptr).x = LOCAL_TO_GLOBAL((aux->coords.x), first_x, depth);
+					(*ptr).y = LOCAL_TO_GLOBAL((aux->coords.y), first_y, depth);
+					(*ptr).z = LOCAL_TO_GLOBAL((aux->coords.z), first_z, depth);
+					ptr++;
 				}
 				aux = aux->next;
 			}
 		}
 	}
+
+	return array;
 }
 
-/************************************************** BLOCK_TO_ARRAY **************************************************/
+/************************************************** BLOCK_TO_BORDER **************************************************/
 /**
- * Turns a block of cells into an array of coordinates of the cells of said block
+ * Turns the cells of a given region of the block into an array of coordinates to send to a neighbor.
+ * The coordinate along the axis of the exchange is relative to the start of the region
  *
  * @param block			Block
+ * @param array			Reusable array where the coordinates are stored
+ * @param capacity		Number of cells the array can hold
  * @param size_array	Size of the array
- * @param first_x		First x-coordinate of the data handled by the process (Used to turn the local indexes into global ones)
- * @param first_y		First y-coordinate of the data handled by the process (Used to turn the local indexes into global ones)
- * @param size_x		Block size in x
- * @param size_y		Block size in y
- * @return 				Array
+ * @param first			First x, y and z-coordinates of the region
+ * @param last			Last x, y and z-coordinates of the region
+ * @param axis			Axis of the exchange
  */
-struct coordinates * block_to_array(struct node ***block, int *size_array, int first_x, int first_y, int size_x, int size_y)
+void block_to_border(struct node ***block, struct coordinates **array, int *capacity, int *size_array, int *first, int *last, int axis)
 {
-	struct coordinates 	*array 			= NULL;
 	struct coordinates 	*ptr 			= NULL;
 	struct node 		*aux 			= NULL;
+	int 				coordinates[3] 	= {0};
 	int 				x 				= 0;
 	int 				y 				= 0;
 
-	(*size_array) = block_alive_count(block, size_x, size_y);
-	array = (struct coordinates *) calloc((*size_array), sizeof(struct coordinates));
-
-	ptr = array;
-	for(x = 1; x < (size_x - 1); x++)
+	(*size_array) = border_alive_count(block, first, last);
+	border_reserve(array, capacity, (*size_array));
+	ptr = (*array);
+	for(x = first[0]; x <= last[0]; x++)
 	{
-		for(y = 1; y < (size_y - 1); y++)
+		for(y = first[1]; y <= last[1]; y++)
 		{
 			aux = block[x][y];
-			while(aux != NULL)
+			while((aux != NULL) && (aux->coords.z <= last[2]))
 			{
-				if(aux->status == ALIVE)
+				if((aux->status == ALIVE) && (aux->coords.z >= first[2]))
 				{
-					(*ptr).x = LOCAL_TO_GLOBAL((aux->coords.x), first_x);
-					(*ptr).y = LOCAL_TO_GLOBAL((aux->coords.y), first_y);
-					(*ptr).z = aux->coords.z;
+					coordinates[0] = x;
+					coordinates[1] = y;
+					coordinates[2] = aux->coords.z;
+					coordinates[axis] -= first[axis];
+					(*ptr).x = coordinates[0];
+					(*ptr).y = coordinates[1];
+					(*ptr).z = coordinates[2];
 					ptr++;
 				}
 				aux = aux->next;
 			}
 		}
 	}
-
-	return array;
 }
 
 /************************************************** BORDER_ALIVE_COUNT **************************************************/
 /**
- * Counts and return the number of alive cells in a given border
+ * Counts and return the number of alive cells in a given region of a given block
  *
- * @param border		Border
- * @param size_border	Size of the border
- * @param step			Step that separates elements of said border (Allocated in contiguous memory, different in x and y)
+ * @param block			Block
+ * @param first			First x, y and z-coordinates of the region
+ * @param last			Last x, y and z-coordinates of the region
  * @return 				Count
  */
-int border_alive_count(struct node **border, int size_border, int step)
+int border_alive_count(struct node ***block, int *first, int *last)
 {
-	struct node 	**ptr 	= NULL;
 	struct node 	*aux 	= NULL;
 	int 			count 	= 0;
-	int 			i 		= 0;
+	int 			x 		= 0;
+	int 			y 		= 0;
 
-	ptr = border;
-	for(i = 0; i < size_border; i++)
+	for(x = first[0]; x <= last[0]; x++)
 	{
-		aux = (*ptr);
-		while(aux != NULL)
+		for(y = first[1]; y <= last[1]; y++)
 		{
-			if(aux->status == ALIVE)
+			/* The lists are sorted by z so the walk stops at the first cell past the region */
+			aux = block[x][y];
+			while((aux != NULL) && (aux->coords.z <= last[2]))
 			{
-				count++;
+				if((aux->status == ALIVE) && (aux->coords.z >= first[2]))
+				{
+					count++;
+				}
+				aux = aux->next;
 			}
-			aux = aux->next;
 		}
-		ptr += step;
 	}
 
 	return count;
 }
 
-/************************************************** BORDER_TO_ARRAY_HORIZONTAL **************************************************/
+/************************************************** BORDER_BOUNDS **************************************************/
 /**
- * Turns a border of cells into an array of coordinates of the cells of said border
+ * Computes the region of the block sent to the neighbor on a given face: the depth planes next to the face.
+ * Deeper ghost zones also need the edges and corners of the neighboring blocks, which come along when the
+ * borders of an axis include the halos of the axes swapped before it
  *
- * @param border		Border
- * @param size_array	Size of the array
- * @param size_border	Size of the border
- * @param step			Step that separates elements of said border (Allocated in contiguous memory, different in x and y)
- * @return 				Array
+ * @param face			Face of the block
+ * @param depth			Depth of the ghost zones
+ * @param sizes			Block sizes in x, y and z
+ * @param first			First x, y and z-coordinates of the region
+ * @param last			Last x, y and z-coordinates of the region
  */
-struct border * border_to_array_horizontal(struct node **border, int *size_array, int size_border, int step)
+void border_bounds(int face, int depth, int *sizes, int *first, int *last)
 {
-	struct border 	*array 			= NULL;
-	struct border 	*ptr_array 		= NULL;
-	struct node 	**ptr_border 	= NULL;
-	struct node 	*aux 			= NULL;
-	int 			i 				= 0;
+	int 	axis 	= 0;
+	int 	i 		= 0;
 
-	(*size_array) = border_alive_count(border, size_border, step);
-	array = (struct border *) calloc((*size_array), sizeof(struct border));
-	ptr_array = array;
-	ptr_border = border;
-	for(i = 0; i < size_border; i++)
+	axis = face / 2;
+	for(i = 0; i < 3; i++)
 	{
-		aux = (*ptr_border);
-		while(aux != NULL)
+		if((depth > 1) && (i < axis))
 		{
-			if(aux->status == ALIVE)
-			{
-				(*ptr_array).a = aux->coords.x;
-				(*ptr_array).b = aux->coords.z;
-				ptr_array++;
-			}
-			aux = aux->next;
+			first[i] = 0;
+			last[i] = sizes[i] - 1;
 		}
-		(ptr_border) += step;
-	}
-
-	return array;
+		else
+		{
+			first[i] = depth;
+			last[i] = sizes[i] - depth - 1;
+		}
+	}
+
+	if((face % 2) == 0)
+	{
+		first[axis] = depth;
+		last[axis] = (2 * depth) - 1;
+	}
+	else
+	{
+		first[axis] = sizes[axis] - (2 * depth);
+		last[axis] = sizes[axis] - depth - 1;
+	}
 }
 
-/************************************************** BORDER_TO_ARRAY_VERTICAL **************************************************/
+/************************************************** BORDER_RESERVE **************************************************/
 /**
- * Turns a border of cells into an array of coordinates of the cells of said border
+ * Makes sure a reusable array of coordinates can hold the given number of cells. When it can't it is
+ * replaced by one with at least twice the capacity, so it is only reallocated a few times
  *
- * @param border		Border
- * @param size_array	Size of the array
- * @param size_border	Size of the border
- * @param step			Step that separates elements of said border (Allocated in contiguous memory, different in x and y)
- * @return 				Array
+ * @param array			Array
+ * @param capacity		Number of cells the array can hold
+ * @param size_array	Number of cells the array needs to hold
  */
-struct border * border_to_array_vertical(struct node **border, int *size_array, int size_border, int step)
+void border_reserve(struct coordinates **array, int *capacity, int size_array)
 {
-	struct border 	*array 			= NULL;
-	struct border 	*ptr_array 		= NULL;
-	struct node 	**ptr_border 	= NULL;
-	struct node 	*aux 			= NULL;
-	int 			i 				= 0;
-
-	(*size_array) = border_alive_count(border, size_border, step);
-	array = (struct border *) calloc((*size_array), sizeof(struct border));
-	ptr_array = array;
-	ptr_border = border;
-	for(i = 0; i < size_border; i++)
+	if(size_array <= (*capacity))
 	{
-		aux = (*ptr_border);
-		while(aux != NULL)
-		{
-			if(aux->status == ALIVE)
-			{
-				(*ptr_array).a = aux->coords.y;
-				(*ptr_array).b = aux->coords.z;
-				ptr_array++;
-			}
-			aux = aux->next;
-		}
-		(ptr_border) += step;
+		return;
 	}
 
-	return array;
+	(*capacity) = ((2 * (*capacity)) > size_array) ? (2 * (*capacity)) : size_array;
+	free((*array));
+	(*array) = (struct coordinates *) malloc((*capacity) * sizeof(struct coordinates));
+	alloc_check((*array));
 }
 
 /************************************************** DETERMINE_NEXT_GENERATION **************************************************/
 /**
  * Iterates through all the cells in the given block and determines whether they live or die in the next generation while
- * removing the dead cells.
+ * removing the dead cells. The cells outside the region whose neighbors were marked are not right anymore and are removed
+ * as well, which rules that keep cells without neighbors alive would not do on their own.
+ * Must be called by every thread of the team, which split the block along x between them
  *
+ * @param pools 	Pools where the removed nodes are kept for reuse, one for each thread
  * @param block 	Block
+ * @param low		First x, y and z-coordinates of the cells that are right in the next generation
+ * @param high		Last x, y and z-coordinates of the cells that are right in the next generation
  * @param size_x	Block size in x
  * @param size_y	Block size in y
+ * @param rule 		Lookup table of the rule
  */
-void determine_next_generation(struct node ***block, int size_x, int size_y)
+void determine_next_generation(struct pool **pools, struct node ***block, int *low, int *high, int size_x, int size_y, int rule)
 {
 	struct node 	**ptr 	= NULL;
 	struct node 	*aux 	= NULL;
+	struct pool 	*pool 	= NULL;
+	int 			inside 	= 0;
 	int 			x 		= 0;
 	int 			y 		= 0;
 
+	OMP(omp for schedule(dynamic, 1))
 	for(x = 0; x < size_x; x++)
 	{
+		pool = pools[omp_get_thread_num()];
 		for(y = 0; y < size_y; y++)
 		{
 			ptr = &block[x][y];
 			aux = (*ptr);
+			inside = (x >= low[0]) && (x <= high[0]) && (y >= low[1]) && (y <= high[1]);
 			while(aux != NULL)
 			{
-				if(aux->status == ALIVE)
+				/* The rule gives whether the cell is alive in the next generation from its state and number of neighbors, the others are removed */
+				if(inside && (aux->coords.z >= low[2]) && (aux->coords.z <= high[2]) && RULE_NEXT(rule, aux->status, aux->alive_neighbors))
 				{
-					if(aux->alive_neighbors < 2 || aux->alive_neighbors > 4)
-					{
-						(*ptr) = aux->next;
-						free(aux);
-					}
-					else
-					{
-						aux->alive_neighbors = 0;
-						ptr = &aux->next;
-					}
+					aux->status = ALIVE;
+					aux->alive_neighbors = 0;
+					ptr = &aux->next;
 				}
 				else
 				{
-					if(aux->alive_neighbors == 2 || aux->alive_neighbors == 3)
-					{
-						aux->status = ALIVE;
-						aux->alive_neighbors = 0;
-						ptr = &aux->next;
-					}
-					else
-					{
-						(*ptr) = aux->next;
-						free(aux);
-					}
+					(*ptr) = aux->next;
+					node_destroy(pool, aux);
 				}
 				aux = (*ptr);
 			}
@@ -630,6 +1082,7 @@ int * get_displs(int *counts, int num_procs)
 	int 	i 			= 0;
 
 	displs = (int *) calloc(num_procs, sizeof(int));
+	alloc_check(displs);
 	for(i = 1; i < num_procs; i++)
 	{
 		displs[i] = displs[i-1] + counts[i-1];
@@ -638,80 +1091,418 @@ int * get_displs(int *counts, int num_procs)
 	return displs;
 }
 
-/************************************************** MARK_NEIGHBORS_HALO_HORIZONTAL **************************************************/
+/************************************************** HALO_CREATE **************************************************/
 /**
- * Marks the neighbors of a given halo of a given block
+ * Allocates the halos of the block and creates the persistent receives for them.
+ * A halo holds at most one cell for each position of the border the neighbor sends, which has the same shape as
+ * the border sent through the same face
  *
- * @param block 		Block
- * @param source 		y-coordinate of halo
- * @param destination 	y-coordinate of neighbors of halo
- * @param size_x		Block size in x
+ * @param halos 		Arrays of coordinates, one for each face
+ * @param requests 		Persistent receives of the halos
+ * @param neighbors 	Ranks of the neighbors through each face
+ * @param depth 		Depth of the ghost zones
+ * @param sizes 		Block sizes in x, y and z
+ * @param type 			Datatype of the coordinates
+ * @param comm 			Communicator of the process grid
  */
-void mark_neighbors_halo_horizontal(struct node ***block, int source, int destination, int size_x)
+void halo_create(struct coordinates **halos, MPI_Request *requests, int *neighbors, int depth, int *sizes, MPI_Datatype type, MPI_Comm comm)
 {
-	struct node 	*aux 	= NULL;
-	int 			x 		= NULL;
+	int 	first[3] 	= {0};
+	int 	last[3] 	= {0};
+	int 	capacity 	= 0;
+	int 	face 		= 0;
+
+	for(face = 0; face < NFACES; face++)
+	{
+		border_bounds(face, depth, sizes, first, last);
+		capacity = (last[0] - first[0] + 1) * (last[1] - first[1] + 1) * (last[2] - first[2] + 1);
+		halos[face] = (struct coordinates *) malloc(capacity * sizeof(struct coordinates));
+		alloc_check(halos[face]);
+		MPI_Recv_init(halos[face], capacity, type, neighbors[face], OPPOSITE(face), comm, &requests[face]);
+	}
+}
+
+/************************************************** HALO_DESTROY **************************************************/
+/**
+ * Releases the persistent receives of the halos of the block and the halos themselves
+ *
+ * @param halos 		Arrays of coordinates, one for each face
+ * @param requests 		Persistent receives of the halos
+ */
+void halo_destroy(struct coordinates **halos, MPI_Request *requests)
+{
+	int 	face 	= 0;
+
+	for(face = 0; face < NFACES; face++)
+	{
+		MPI_Request_free(&requests[face]);
+		free(halos[face]);
+		halos[face] = NULL;
+	}
+}
+
+/************************************************** HALO_SEARCH **************************************************/
+/**
+ * Returns the position of the first cell of a halo whose x-coordinate is not below the given one.
+ * The halos are sorted by x as the borders are walked in that order
+ *
+ * @param halo 			Array of coordinates
+ * @param count 		Number of cells of the halo
+ * @param x 			x-coordinate to search for
+ * @return 				Position of the cell, or the number of cells if there is none
+ */
+int halo_search(struct coordinates *halo, int count, int x)
+{
+	int 	high 	= count;
+	int 	low 	= 0;
+	int 	middle 	= 0;
+
+	while(low < high)
+	{
+		middle = low + ((high - low) / 2);
+		if(halo[middle].x < x)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
 
-	for(x = 1; x < (size_x - 1); x++)
+/************************************************** HALO_WAIT **************************************************/
+/**
+ * Waits for the given persistent receives of the halos and gets the number of cells of each one.
+ * Only the master thread calls MPI
+ *
+ * @param requests 		Persistent receives of the halos
+ * @param statuses 		Statuses of the receives
+ * @param counts 		Number of cells of each halo
+ * @param count 		Number of halos
+ * @param type 			Datatype of the coordinates
+ */
+void halo_wait(MPI_Request *requests, MPI_Status *statuses, int *counts, int count, MPI_Datatype type)
+{
+	int 	i 	= 0;
+
+	MPI_Waitall(count, requests, statuses);
+	for(i = 0; i < count; i++)
+	{
+		MPI_Get_count(&statuses[i], type, &counts[i]);
+	}
+}
+
+/************************************************** INPUT_ALIGN **************************************************/
+/**
+ * Moves a position of the mapped file forward to the start of the line that follows it,
+ * unless it already is the start of a line, so that chunks of the file can be parsed independently
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position to align
+ * @return 					Start of a line or the end of the file
+ */
+char * input_align(struct input *input, char *ptr)
+{
+	if((ptr == input->cursor) || (ptr == input->end) || (ptr[-1] == '\n'))
+	{
+		return ptr;
+	}
+
+	ptr = memchr(ptr, '\n', input->end - ptr);
+	return (ptr == NULL) ? input->end : ptr + 1;
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
 	{
-		aux = block[x][source];
-		while(aux != NULL)
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
 		{
-			if(aux->status == ALIVE)
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
 			{
-				node_add(&(block[x][destination]), NEIGHBOR, DEAD, x, destination, aux->coords.z);
+				return NULL;
 			}
-			aux = aux->next;
+			value = value * 10 + digit;
+			ptr++;
 		}
+		values[i] = value;
 	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
 }
 
-/************************************************** MARK_NEIGHBORS_HALO_VERTICAL **************************************************/
+/************************************************** INPUT_UNMAP **************************************************/
 /**
- * Marks the neighbors of a given halo of a given block
+ * Unmaps the input file and frees its structure
  *
- * @param block 		Block
- * @param source 		x-coordinate of halo
- * @param destination 	x-coordinate of neighbors of halo
- * @param size_y		Block size in y
+ * @param input 			Mapped input file
  */
-void mark_neighbors_halo_vertical(struct node ***block, int source, int destination, int size_y)
+void input_unmap(struct input *input)
 {
-	struct node 	*aux 	= NULL;
-	int 			y 		= NULL;
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** MARK_CELL_NEIGHBORS **************************************************/
+/**
+ * Marks the neighbors of a given cell that lie in a given region of the block.
+ * The cell itself may be just outside the region, then only the neighbor across the side of the region is marked
+ *
+ * @param pool 		Pool from which new nodes are taken
+ * @param block 	Block
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ * @param low		First x, y and z-coordinates of the region
+ * @param high		Last x, y and z-coordinates of the region
+ */
+void mark_cell_neighbors(struct pool *pool, struct node ***block, int x, int y, int z, int *low, int *high)
+{
+	int 	inside_x 	= 0;
+	int 	inside_y 	= 0;
+	int 	inside_z 	= 0;
+
+	inside_x = (x >= low[0]) && (x <= high[0]);
+	inside_y = (y >= low[1]) && (y <= high[1]);
+	inside_z = (z >= low[2]) && (z <= high[2]);
 
-	for(y = 1; y < (size_y - 1); y++)
+	if(inside_y && inside_z)
 	{
-		aux = block[source][y];
-		while(aux != NULL)
+		if(x > low[0])
 		{
-			if(aux->status == ALIVE)
+			node_add(pool, &(block[x-1][y]), NEIGHBOR, DEAD, x-1, y, z);
+		}
+		if(x < high[0])
+		{
+			node_add(pool, &(block[x+1][y]), NEIGHBOR, DEAD, x+1, y, z);
+		}
+	}
+	if(inside_x && inside_z)
+	{
+		if(y > low[1])
+		{
+			node_add(pool, &(block[x][y-1]), NEIGHBOR, DEAD, x, y-1, z);
+		}
+		if(y < high[1])
+		{
+			node_add(pool, &(block[x][y+1]), NEIGHBOR, DEAD, x, y+1, z);
+		}
+	}
+	if(inside_x && inside_y)
+	{
+		if(z > low[2])
+		{
+			node_add(pool, &(block[x][y]), NEIGHBOR, DEAD, x, y, z-1);
+		}
+		if(z < high[2])
+		{
+			node_add(pool, &(block[x][y]), NEIGHBOR, DEAD, x, y, z+1);
+		}
+	}
+}
+
+/************************************************** MARK_NEIGHBORS **************************************************/
+/**
+ * Marks the neighbors that lie in a given region of the alive cells in another region of a given block.
+ * Only the neighbors of the cells that will still be right in the next generation are marked, so the
+ * cells on the sides of the region get no neighbors and are removed by determine_next_generation.
+ * Must be called by every thread of the team, as the region is split in bands along x between them
+ *
+ * @param pools 	Pools from which new nodes are taken, one for each thread
+ * @param block 	Block
+ * @param first		First x, y and z-coordinates of the cells
+ * @param last		Last x, y and z-coordinates of the cells
+ * @param low		First x, y and z-coordinates of the neighbors
+ * @param high		Last x, y and z-coordinates of the neighbors
+ */
+void mark_neighbors(struct pool **pools, struct node ***block, int *first, int *last, int *low, int *high)
+{
+	struct node 	*aux 		= NULL;
+	struct pool 	*pool 		= NULL;
+	int 			band 		= 0;
+	int 			num_bands 	= 0;
+	int 			parity 		= 0;
+	int 			width 		= 0;
+	int 			x 			= 0;
+	int 			y 			= 0;
+
+	width = last[0] - first[0] + 1;
+	num_bands = band_count(width);
+	for(parity = 0; parity < 2; parity++)
+	{
+		OMP(omp for schedule(dynamic, 1))
+		for(band = parity; band < num_bands; band += 2)
+		{
+			pool = pools[omp_get_thread_num()];
+			for(x = first[0] + ((band * width) / num_bands); x < first[0] + (((band + 1) * width) / num_bands); x++)
 			{
-				node_add(&(block[destination][y]), NEIGHBOR, DEAD, destination, y, aux->coords.z);
+				for(y = first[1]; y <= last[1]; y++)
+				{
+					aux = block[x][y];
+					while((aux != NULL) && (aux->coords.z <= last[2]))
+					{
+						if((aux->status == ALIVE) && (aux->coords.z >= first[2]))
+						{
+							mark_cell_neighbors(pool, block, x, y, aux->coords.z, low, high);
+						}
+						aux = aux->next;
+					}
+				}
 			}
-			aux = aux->next;
 		}
 	}
 }
 
+/************************************************** MERGE_SIFT **************************************************/
+/**
+ * Moves the process at a given position of the heap of the merge down until the keys of its children are larger
+ *
+ * @param heap 			Processes whose next cells are still to be printed, ordered by the key of those cells
+ * @param count 		Number of processes in the heap
+ * @param keys 			Key of the next cell of each process
+ * @param position 		Position of the process to move
+ */
+void merge_sift(int *heap, int count, uint64_t *keys, int position)
+{
+	int 	child 	= 0;
+	int 	tmp 	= 0;
+
+	while((child = (2 * position) + 1) < count)
+	{
+		if((child + 1 < count) && (keys[heap[child + 1]] < keys[heap[child]]))
+		{
+			child++;
+		}
+		if(keys[heap[position]] <= keys[heap[child]])
+		{
+			break;
+		}
+		tmp = heap[position];
+		heap[position] = heap[child];
+		heap[child] = tmp;
+		position = child;
+	}
+}
+
 /************************************************** NODE_ADD **************************************************/
 /**
  * Adds a node to the given list
  *
+ * @param pool 		Pool from which new nodes are taken
  * @param head 		Head of the list where to insert the node
  * @param mode 		A way to differentiate whether we're adding neighbors of alive cells or alive cells themselves.
  *					It could be suppressed by creating an almost identical function for each case
  * @param status 	Status of the cell to add
  * @param z 		z-coordinate of the cell to add
  */
-void node_add(struct node **head, short mode, short status, short x, short y, short z)
+void node_add(struct pool *pool, struct node **head, short mode, short status, short x, short y, short z)
 {
 	struct node 	*aux 	= NULL;
 	struct node 	*new 	= NULL;
 
 	if(((*head) == NULL) || ((*head)->coords.z > z))
 	{
-		new = node_create(status, x, y, z);
+		new = node_create(pool, status, x, y, z);
 		new->alive_neighbors += mode;
 		new->next = (*head);
 		(*head) = new;
@@ -747,7 +1538,7 @@ void node_add(struct node **head, short mode, short status, short x, short y, sh
 		}
 		else
 		{
-			new = node_create(status, x, y, z);
+			new = node_create(pool, status, x, y, z);
 			new->alive_neighbors += mode;
 			new->next = aux->next;
 			aux->next = new;
@@ -757,18 +1548,24 @@ void node_add(struct node **head, short mode, short status, short x, short y, sh
 
 /************************************************** NODE_CREATE **************************************************/
 /**
- * Creates a node that represent a cell in the game
+ * Creates a node that represent a cell in the game, reusing one
+ * from the pool and only growing it when it runs out of nodes
  *
+ * @param pool 		Pool from which the node is taken
  * @param status 	Status of the cell to create
  * @param z 		z-coordinate of the cell to create
  * @return 			Node
  */
-struct node * node_create(short status, short x, short y, short z)
+struct node * node_create(struct pool *pool, short status, short x, short y, short z)
 {
 	struct node 	*new 	= NULL;
 
-	new = (struct node *) calloc(1, sizeof(struct node));
-	alloc_check(new);
+	if(pool->free_list == NULL)
+	{
+		pool_grow(pool);
+	}
+	new = pool->free_list;
+	pool->free_list = new->next;
 
 	new->alive_neighbors = 0;
 	new->status = status;
@@ -780,6 +1577,379 @@ struct node * node_create(short status, short x, short y, short z)
 	return new;
 }
 
+/************************************************** NODE_DESTROY **************************************************/
+/**
+ * Gives a node that is no longer in use back to the pool
+ *
+ * @param pool 		Pool where the node is kept for reuse
+ * @param node 		Node
+ */
+void node_destroy(struct pool *pool, struct node *node)
+{
+	node->next = pool->free_list;
+	pool->free_list = node;
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, writing the buffer out first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL;
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL;
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL;
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0};
+	int 	length 		= 0;
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_MERGE **************************************************/
+/**
+ * Prints the cells of all the processes in order, merging the sorted arrays of the processes as they arrive.
+ * The other processes send their arrays in chunks, which the root only receives when it reaches them,
+ * so it never holds more than one chunk of each process
+ *
+ * @param output 		Output buffer
+ * @param array 		Sorted array of coordinates of the root
+ * @param size_array 	Size of the array
+ * @param counts 		Number of cells of each process
+ * @param num_procs 	Number of processes
+ * @param type 			Datatype of the coordinates
+ * @param comm 			Communicator of the processes
+ */
+void output_merge(struct output *output, struct coordinates *array, int size_array, int *counts, int num_procs,
+					MPI_Datatype type, MPI_Comm comm)
+{
+	MPI_Status 			status;
+	struct coordinates 	**chunks 	= NULL;
+	struct coordinates 	*cell 		= NULL;
+	uint64_t 			*keys 		= NULL;
+	int 				*heap 		= NULL;
+	int 				*lengths 	= NULL;
+	int 				*positions 	= NULL;
+	int 				count 		= 0;
+	int 				i 			= 0;
+	int 				rank 		= 0;
+
+	MPI_Comm_rank(comm, &rank);
+	chunks = (struct coordinates **) calloc(num_procs, sizeof(struct coordinates *));
+	keys = (uint64_t *) calloc(num_procs, sizeof(uint64_t));
+	heap = (int *) calloc(num_procs, sizeof(int));
+	lengths = (int *) calloc(num_procs, sizeof(int));
+	positions = (int *) calloc(num_procs, sizeof(int));
+	alloc_check(chunks);
+	alloc_check(keys);
+	alloc_check(heap);
+	alloc_check(lengths);
+	alloc_check(positions);
+
+	/* Get the first chunk of every process with cells, counts then keeps the cells still to be received */
+	for(i = 0; i < num_procs; i++)
+	{
+		if(i == rank)
+		{
+			chunks[i] = array;
+			lengths[i] = size_array;
+		}
+		else if(counts[i] > 0)
+		{
+			chunks[i] = (struct coordinates *) malloc(OUTPUT_CHUNK_SIZE * sizeof(struct coordinates));
+			alloc_check(chunks[i]);
+			MPI_Recv(chunks[i], OUTPUT_CHUNK_SIZE, type, i, 0, comm, &status);
+			MPI_Get_count(&status, type, &lengths[i]);
+		}
+		counts[i] -= lengths[i];
+		if(lengths[i] > 0)
+		{
+			keys[i] = ((uint64_t) chunks[i][0].x * output->size + chunks[i][0].y) * output->size + chunks[i][0].z;
+			heap[count++] = i;
+		}
+	}
+	for(i = (count / 2) - 1; i >= 0; i--)
+	{
+		merge_sift(heap, count, keys, i);
+	}
+
+	while(count > 0)
+	{
+		i = heap[0];
+		cell = &(chunks[i][positions[i]++]);
+		output_cell(output, cell->x, cell->y, cell->z);
+		if((positions[i] == lengths[i]) && (counts[i] > 0))
+		{
+			MPI_Recv(chunks[i], OUTPUT_CHUNK_SIZE, type, i, 0, comm, &status);
+			MPI_Get_count(&status, type, &lengths[i]);
+			counts[i] -= lengths[i];
+			positions[i] = 0;
+		}
+		if(positions[i] == lengths[i])
+		{
+			heap[0] = heap[--count];
+		}
+		else
+		{
+			cell = &(chunks[i][positions[i]]);
+			keys[i] = ((uint64_t) cell->x * output->size + cell->y) * output->size + cell->z;
+		}
+		merge_sift(heap, count, keys, 0);
+	}
+
+	for(i = 0; i < num_procs; i++)
+	{
+		if(i != rank)
+		{
+			free(chunks[i]);
+		}
+	}
+	free(chunks);
+	free(keys);
+	free(heap);
+	free(lengths);
+	free(positions);
+}
+
+/************************************************** OUTPUT_SEND **************************************************/
+/**
+ * Sends the sorted array of cells of the process to the root in chunks for output_merge.
+ * The sends are synchronous, so each one waits until the root is ready to print the chunk
+ *
+ * @param array 		Sorted array of coordinates
+ * @param size_array 	Size of the array
+ * @param type 			Datatype of the coordinates
+ * @param comm 			Communicator of the processes
+ */
+void output_send(struct coordinates *array, int size_array, MPI_Datatype type, MPI_Comm comm)
+{
+	int 	first 	= 0;
+	int 	length 	= 0;
+
+	for(first = 0; first < size_array; first += OUTPUT_CHUNK_SIZE)
+	{
+		length = ((size_array - first) < OUTPUT_CHUNK_SIZE) ? (size_array - first) : OUTPUT_CHUNK_SIZE;
+		MPI_Ssend(&array[first], length, type, ROOT, 0, comm);
+	}
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0;
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** POOL_CREATE **************************************************/
+/**
+ * Creates an empty pool of nodes and returns it
+ *
+ * @return 			Pool
+ */
+struct pool * pool_create(void)
+{
+	struct pool 	*pool 	= NULL;
+
+	pool = (struct pool *) calloc(1, sizeof(struct pool));
+	alloc_check(pool);
+
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+
+	return pool;
+}
+
+/************************************************** POOL_DESTROY **************************************************/
+/**
+ * Frees all the memory owned by the pool, including the nodes still in use
+ *
+ * @param pool 		Pool
+ */
+void pool_destroy(struct pool *pool)
+{
+	struct slab 	*aux 	= NULL;
+
+	while(pool->slabs != NULL)
+	{
+		aux = pool->slabs;
+		pool->slabs = pool->slabs->next;
+		free(aux);
+	}
+	free(pool);
+}
+
+/************************************************** POOL_GROW **************************************************/
+/**
+ * Allocates a new slab of nodes and chains all of them in the free list of the pool
+ *
+ * @param pool 		Pool
+ */
+void pool_grow(struct pool *pool)
+{
+	struct slab 	*slab 	= NULL;
+	int 			i 		= 0;
+
+	slab = (struct slab *) malloc(sizeof(struct slab));
+	alloc_check(slab);
+
+	for(i = 0; i < (POOL_SLAB_SIZE - 1); i++)
+	{
+		slab->nodes[i].next = &(slab->nodes[i+1]);
+	}
+	slab->nodes[POOL_SLAB_SIZE - 1].next = pool->free_list;
+	pool->free_list = &(slab->nodes[0]);
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+}
+
 /************************************************** READ_ARGUMENTS **************************************************/
 /**
  * Checks if the command line arguments verify the specifications
@@ -788,17 +1958,67 @@ struct node * node_create(short status, short x, short y, short z)
  * @param argv				Command line arguments
  * @param input_filename	Name of the file specified in the arguments
  * @param iterations 		Number of iterations specified in the arguments
+ * @param binary 			Whether to print the solution in the binary format
+ * @param depth 			Depth of the ghost zones, the number of generations between halo exchanges
+ * @param rebalance 		Number of generations between rebalances of the blocks, 0 to keep them fixed
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
  */
-void read_arguments(int argc, char *argv[], char **input_filename, int *iterations)
+void read_arguments(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *depth, int *rebalance, int *rule)
 {
 	FILE 	*input_fd 	= NULL;
+	int 	i 			= 0;
 
-	if(argc != 3)
+	if(argc < 3)
 	{
-		fprintf(stderr, "Program is run with %s [name-of-input-file] [number-of-iterations]\n", argv[0]);
+		fprintf(stderr, "Program is run with %s [name-of-input-file] [number-of-iterations] [--binary] [--ghost-depth k] [--rebalance k] [--rule B../S..]\n", argv[0]);
 		exit(-1);
 	}
 
+	(*binary) = 0;
+	(*depth) = 1;
+	(*rebalance) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if((strcmp(argv[i], "--ghost-depth") == 0) && (i + 1 < argc))
+		{
+			(*depth) = atoi(argv[++i]);
+			if((*depth) <= 0)
+			{
+				fprintf(stderr, "The ghost depth must be >= 1\n");
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--rebalance") == 0) && (i + 1 < argc))
+		{
+			(*rebalance) = atoi(argv[++i]);
+			if((*rebalance) <= 0)
+			{
+				fprintf(stderr, "The number of generations between rebalances must be >= 1\n");
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			(*rule) = read_rule(argv[++i]);
+			/* Only the cells next to alive ones are ever looked at, so none can be born without neighbors */
+			if(RULE_NEXT((*rule), DEAD, 0))
+			{
+				fprintf(stderr, "Rules with B0 are only supported by life3d-dense\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
 	(*input_filename) = argv[1];
 	input_fd = fopen((*input_filename), "r");
 	if(input_fd == NULL)
@@ -818,297 +2038,487 @@ void read_arguments(int argc, char *argv[], char **input_filename, int *iteratio
 
 /************************************************** READ_COORDINATES **************************************************/
 /**
- * Reads the input file and stores the cells assigned to this process in the given block
+ * Reads the share of the input file of this process and returns its cells as an array of coordinates in the cube.
+ * Each process parses a chunk of the file, aligned to the start of the lines, so only that part of the mapping
+ * is ever read. The fixed size keys of binary files are split evenly between the processes instead, while
+ * delta encoded keys can only be decoded in order so the first process decodes all of them
  *
- * @param input_fd 			File
- * @param block 			Block
- * @param first_x			First x-coordinate of the data handled by the process
- * @param first_y			First y-coordinate of the data handled by the process
- * @param last_x			Last x-coordinate of the data handled by the process
- * @param last_y			Last y-coordinate of the data handled by the process
+ * @param input 			Mapped input file
+ * @param size_array		Size of the array
+ * @param rank 				Rank of the process
+ * @param num_procs 		Number of processes
+ * @param size				Size of the cube
+ * @return 					Array of coordinates
  */
-void read_coordinates(FILE *input_fd, struct node ***block, int first_x, int first_y, int last_x, int last_y)
+struct coordinates * read_coordinates(struct input *input, int *size_array, int rank, int num_procs, int size)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	x 						= 0;
-	int 	y 						= 0;
-	int 	z 						= 0;
+	struct coordinates 	*array 			= NULL;
+	char 				*end 			= NULL;
+	char 				*next 			= NULL;
+	char 				*ptr 			= NULL;
+	size_t 				length 			= 0;
+	uint64_t 			first_cell 		= 0;
+	uint64_t 			last_cell 		= 0;
+	int 				coordinates[3] 	= {0};
+
+	(*size_array) = 0;
+	if(input->binary)
+	{
+		first_cell = input->count * rank / num_procs;
+		last_cell = input->count * (rank + 1) / num_procs;
+		if(input->flags & BINARY_DELTA)
+		{
+			first_cell = 0;
+			last_cell = (rank == 0) ? input->count : 0;
+		}
+		input->cursor += 8 * first_cell;
+		array = (struct coordinates *) malloc((last_cell - first_cell + 1) * sizeof(struct coordinates));
+		alloc_check(array);
+		for(; first_cell < last_cell; first_cell++)
+		{
+			binary_read_cell(input, coordinates, size);
+			array[(*size_array)].x = coordinates[0];
+			array[(*size_array)].y = coordinates[1];
+			array[(*size_array)].z = coordinates[2];
+			(*size_array)++;
+		}
+		return array;
+	}
 
-	while(fgets(buffer, BUFFER_SIZE, input_fd) != NULL)
+	/* Parse the chunk of the file of this process, every line takes at least 6 bytes */
+	length = input->end - input->cursor;
+	ptr = input_align(input, input->cursor + length * rank / num_procs);
+	end = input_align(input, input->cursor + length * (rank + 1) / num_procs);
+	array = (struct coordinates *) malloc(((end - ptr) / 6 + 1) * sizeof(struct coordinates));
+	alloc_check(array);
+	while(ptr < end)
 	{
-		if((sscanf(buffer,"%d %d %d", &x, &y, &z)) != 3)
+		next = input_scan(ptr, input->end, coordinates, 3);
+		if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
 		{
-			fprintf(stderr, "Input file does not match specifications\n");
-			exit(-1);
+			input_error(input, ptr);
+		}
+		array[(*size_array)].x = coordinates[0];
+		array[(*size_array)].y = coordinates[1];
+		array[(*size_array)].z = coordinates[2];
+		(*size_array)++;
+		ptr = next;
+	}
+	input->cursor = end;
+
+	return array;
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
+{
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
+
+	if((*ptr) == 'B')
+	{
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+		{
+			rule |= 1 << ((*ptr) - '0');
 		}
-		/* Only add the cells that correspond to the coordinates assigned to this block */
-		if((x >= first_x) && (x <= last_x) && (y >= first_y) && (y <= last_y))
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
 		{
-			x = GLOBAL_TO_LOCAL(x, first_x);
-			y = GLOBAL_TO_LOCAL(y, first_y);
-			node_add(&(block[x][y]), NEW, ALIVE, x, y, z);
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
 		}
 	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
 }
 
 /************************************************** READ_SIZE **************************************************/
 /**
  * Reads the input file and returns the declared size of the sides of the cube
  *
- * @param input_fd 			File
+ * @param input 			Mapped input file
  * @return size 			Size of the cube
  */
-int read_size(FILE *input_fd)
+int read_size(struct input *input)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	size 					= 0;
+	char 	*next 	= NULL;
+	int 	size 	= 0;
 
-	fgets(buffer, BUFFER_SIZE, input_fd);
-	if((sscanf(buffer, "%d", &size)) != 1)
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
 	{
-		fprintf(stderr, "Input file does not match specifications\n");
-		exit(-1);
+		return binary_read_header(input);
+	}
+
+	next = input_scan(input->cursor, input->end, &size, 1);
+	if(next == NULL)
+	{
+		input_error(input, input->cursor);
 	}
+	input->cursor = next;
 
 	return size;
 }
 
+/************************************************** REBALANCE_CUTS **************************************************/
+/**
+ * Cuts the cube along one axis so that every block gets about the same number of alive cells.
+ * Every block keeps at least as many planes as the depth of the ghost zones, and the cuts are left as they are if there are no cells
+ *
+ * @param histogram			Number of alive cells of each plane along the axis
+ * @param size				Size of the cube
+ * @param dimension			Number of processes in the process grid along the axis
+ * @param depth				Depth of the ghost zones
+ * @param cuts				First plane of the blocks along the axis, followed by the size of the cube
+ */
+void rebalance_cuts(int *histogram, int size, int dimension, int depth, int *cuts)
+{
+	uint64_t 	prefix 	= 0;
+	uint64_t 	target 	= 0;
+	uint64_t 	total 	= 0;
+	int 		part 	= 0;
+	int 		plane 	= 0;
+
+	for(plane = 0; plane < size; plane++)
+	{
+		total += histogram[plane];
+	}
+	if(total == 0)
+	{
+		return;
+	}
+
+	plane = 0;
+	for(part = 1; part < dimension; part++)
+	{
+		/* Take the planes whose middle comes before the share of the cells of the blocks so far */
+		target = (total * part) / dimension;
+		while((plane < size) && (((2 * prefix) + histogram[plane]) <= (2 * target)))
+		{
+			prefix += histogram[plane];
+			plane++;
+		}
+		cuts[part] = plane;
+		if(cuts[part] < (cuts[part - 1] + depth))
+		{
+			cuts[part] = cuts[part - 1] + depth;
+		}
+		if(cuts[part] > (size - ((dimension - part) * depth)))
+		{
+			cuts[part] = size - ((dimension - part) * depth);
+		}
+	}
+}
+
 /************************************************** MAIN **************************************************/
 int main(int argc, char *argv[])
 {
-	FILE 				*input_fd 					= NULL;
-
 	MPI_Comm 			MPI_COMM_CUBE;
-	MPI_Datatype 		MPI_BORDER;
 	MPI_Datatype 		MPI_COORDINATES;
-	MPI_Request 		request_recv[4];
-	MPI_Request 		request_send[4];
-	MPI_Status 			status;
-
-	struct border 		*buffer_border_up 			= NULL;
-	struct border 		*buffer_border_down 		= NULL;
-	struct border 		*buffer_border_left 		= NULL;
-	struct border 		*buffer_border_right 		= NULL;
-	struct border 		*buffer_halo_up 			= NULL;
-	struct border 		*buffer_halo_down 			= NULL;
-	struct border 		*buffer_halo_left 			= NULL;
-	struct border 		*buffer_halo_right 			= NULL;
+	MPI_Request 		request_recv[NFACES];
+	MPI_Request 		request_send[NFACES];
+	MPI_Status 			status_recv[NFACES];
 
 	struct coordinates 	*buffer_block 				= NULL;
-	struct coordinates 	*buffer_gather 				= NULL;
+	struct coordinates 	*buffer_border[NFACES] 		= {NULL};
+	struct coordinates 	*buffer_halo[NFACES] 		= {NULL};
+	struct coordinates 	*buffer_migrate 			= NULL;
+
+	struct input 		*input 						= NULL;
+
+	struct output 		*output 					= NULL;
 
 	struct node 		***block 					= NULL;
-	struct node 		*aux 						= NULL;
+
+	struct pool 		**pools 					= NULL;
 
 	char 				*input_filename 			= NULL;
 
-	int 				*displs 					= NULL;
+	uint64_t 			generation 					= 0;
+
+	int 				*cuts[NDIMS] 				= {NULL};
+	int 				*histogram 					= NULL;
 	int 				*recvcounts 				= NULL;
-	int 				cart_coordinates[NDIMS] 	= {0, 0};
-	int 				cart_dimensions[NDIMS] 		= {0, 0};
-	int 				cart_periodicity[NDIMS] 	= {1, 1};
-	int 				coordinate_x 				= 0;
-	int 				coordinate_y 				= 0;
+	int 				binary 						= 0;
+	int 				capacity_border[NFACES] 	= {0};
+	int 				cart_coordinates[NDIMS] 	= {0, 0, 0};
+	int 				cart_dimensions[NDIMS] 		= {0, 0, 0};
+	int 				cart_periodicity[NDIMS] 	= {1, 1, 1};
 	int 				count_block 				= 0;
-	int 				count_border_up 			= 0;
-	int 				count_border_down 			= 0;
-	int 				count_border_left 			= 0;
-	int 				count_border_right 			= 0;
-	int 				count_halo_up 				= 0;
-	int 				count_halo_down 			= 0;
-	int 				count_halo_left 			= 0;
-	int 				count_halo_right 			= 0;
+	int 				count_border[NFACES] 		= {0};
+	int 				count_halo[NFACES] 			= {0};
+	int 				count_migrate 				= 0;
 	int 				count_total 				= 0;
+	int 				countdown 					= 0;
+	int 				depth 						= 0;
+	int 				face 						= 0;
+	int 				first[3] 					= {0};
+	int 				high[3] 					= {0};
+	int 				i 							= 0;
 	int 				iterations 					= 0;
-	int 				neighbor_down 				= 0;
-	int 				neighbor_up 				= 0;
-	int 				neighbor_left 				= 0;
-	int 				neighbor_right 				= 0;
+	int 				j 							= 0;
+	int 				last[3] 					= {0};
+	int 				low[3] 						= {0};
+	int 				neighbors[NFACES] 			= {0};
 	int 				num_procs 					= 0;
+	int 				num_threads 				= 0;
+	int 				provided 					= 0;
 	int 				rank 						= 0;
+	int 				rebalance 					= 0;
+	int 				rule 						= 0;
 	int 				size 						= 0;
+	int 				sizes[3] 					= {0};
+	int 				step 						= 0;
 	int 				size_x 						= 0;
 	int 				size_y 						= 0;
+	int 				size_z 						= 0;
 	int 				first_x 					= 0;
 	int 				first_y 					= 0;
+	int 				first_z 					= 0;
 	int 				last_x 						= 0;
 	int 				last_y 						= 0;
-	int 				x 							= 0;
-	int 				y 							= 0;
-	int 				z 							= 0;
-
-	/* Initialize MPI */
-	MPI_Init(&argc, &argv);
+	int 				last_z 						= 0;
+#ifdef PROFILE
+	int 				count_max 					= 0;
+	int 				count_sum 					= 0;
+#endif
+
+	/* Initialize MPI, only ever called by the master thread of each process */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	if(provided < MPI_THREAD_FUNNELED)
+	{
+		fprintf(stderr, "The MPI library does not support threads\n");
+		exit(-1);
+	}
 	MPI_Barrier(MPI_COMM_WORLD);
 
 	/* Get the number of processes created by MPI and their rank */
 	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-	/* Create a 2D cartesian topology of the processes */
+	/* Create a 3D cartesian topology of the processes, periodic along every axis like the cube */
 	MPI_Dims_create(num_procs, NDIMS, cart_dimensions);
 	MPI_Cart_create(MPI_COMM_WORLD, NDIMS, cart_dimensions, cart_periodicity, 1, &MPI_COMM_CUBE);
 
 	/* Get relevant data from the created topology */
 	MPI_Cart_coords(MPI_COMM_CUBE, rank, NDIMS, cart_coordinates);
 	MPI_Cart_rank(MPI_COMM_CUBE, cart_coordinates, &rank);
-	MPI_Cart_shift(MPI_COMM_CUBE, VERTICAL, 1, &neighbor_up, &neighbor_down);
-	MPI_Cart_shift(MPI_COMM_CUBE, HORIZONTAL, 1, &neighbor_left, &neighbor_right);
+	MPI_Cart_shift(MPI_COMM_CUBE, HORIZONTAL, 1, &neighbors[LEFT], &neighbors[RIGHT]);
+	MPI_Cart_shift(MPI_COMM_CUBE, VERTICAL, 1, &neighbors[UP], &neighbors[DOWN]);
+	MPI_Cart_shift(MPI_COMM_CUBE, DEPTH, 1, &neighbors[FRONT], &neighbors[BACK]);
 
 	/* Define and commit the type used for border and halo swapping */
-	MPI_Type_contiguous(2, MPI_SHORT, &MPI_BORDER);
-	MPI_Type_commit(&MPI_BORDER);
 	MPI_Type_contiguous(3, MPI_SHORT, &MPI_COORDINATES);
 	MPI_Type_commit(&MPI_COORDINATES);
 
 	/* Check command line arguments */
-	read_arguments(argc, argv, &input_filename, &iterations);
-	/* Open input file */
-	input_fd = fopen(input_filename, "r");
+	read_arguments(argc, argv, &input_filename, &iterations, &binary, &depth, &rebalance, &rule);
+	/* Map the input file */
+	input = input_map(input_filename);
 	/* Read problem size */
-	size = read_size(input_fd);
+	size = read_size(input);
+	generation = input->generation + iterations;
 
-	/* Compute parameters for the block decomposition */
-	block_parameters(cart_coordinates, cart_dimensions, &coordinate_x, &coordinate_y, &first_x, &first_y, &last_x, &last_y, &size_x, &size_y, size);
+	/* Cut the cube evenly along each axis to begin with and compute the parameters of the block of this process */
+	for(i = 0; i < NDIMS; i++)
+	{
+		cuts[i] = (int *) calloc(cart_dimensions[i] + 1, sizeof(int));
+		alloc_check(cuts[i]);
+		for(j = 0; j < cart_dimensions[i]; j++)
+		{
+			block_parameters(j, cart_dimensions[i], depth, &cuts[i][j], &last[i], &sizes[i], size);
+		}
+		cuts[i][cart_dimensions[i]] = size;
+	}
+	block_bounds(cuts[HORIZONTAL], cart_coordinates[HORIZONTAL], depth, &first_x, &last_x, &size_x);
+	block_bounds(cuts[VERTICAL], cart_coordinates[VERTICAL], depth, &first_y, &last_y, &size_y);
+	block_bounds(cuts[DEPTH], cart_coordinates[DEPTH], depth, &first_z, &last_z, &size_z);
+	sizes[0] = size_x;
+	sizes[1] = size_y;
+	sizes[2] = size_z;
+
+	/* Create the pools that hold the cells of the block, one for each thread */
+	num_threads = omp_get_max_threads();
+	pools = (struct pool **) calloc(num_threads, sizeof(struct pool *));
+	alloc_check(pools);
+	for(i = 0; i < num_threads; i++)
+	{
+		pools[i] = pool_create();
+	}
+	/* Each process parses its share of the input and sends the cells to the processes whose blocks hold them */
+	buffer_block = read_coordinates(input, &count_block, rank, num_procs, size);
+	input_unmap(input);
+	buffer_migrate = array_migrate(buffer_block, count_block, &count_migrate, cuts, cart_dimensions, size, num_procs, MPI_COORDINATES, MPI_COMM_CUBE);
+	free(buffer_block);
+	block = array_to_block(pools[0], buffer_migrate, count_migrate, first_x, first_y, first_z, depth, size_x, size_y);
+	free(buffer_migrate);
 
-	/* Create the local block */
-	block = block_create(size_x, size_y);
-	/* Read the input and add to the block only the cells with coordinates assigned to it */
-	read_coordinates(input_fd, block, first_x, first_y, last_x, last_y);
+	/* The halos are allocated once and received with persistent requests until the blocks change */
+	halo_create(buffer_halo, request_recv, neighbors, depth, sizes, MPI_COORDINATES, MPI_COMM_CUBE);
+	countdown = rebalance;
 
 	/* Problem solving loop */
 	while(iterations > 0)
 	{
-		/* Turn the borders into arrays */
-		buffer_border_up = border_to_array_horizontal(&(block[0][1]), &count_border_up, size_x, size_y);
-		buffer_border_down = border_to_array_horizontal(&(block[0][size_y - 2]), &count_border_down, size_x, size_y);
-		buffer_border_left = border_to_array_vertical(&(block[1][0]), &count_border_left, size_y, 1);
-		buffer_border_right = border_to_array_vertical(&(block[size_x - 2][0]), &count_border_right, size_y, 1);
-
-		/* Start the asynchronous send */
-		MPI_Isend(buffer_border_up, count_border_up, MPI_BORDER, neighbor_up, UP, MPI_COMM_CUBE, &request_send[0]);
-		MPI_Isend(buffer_border_down, count_border_down, MPI_BORDER, neighbor_down, DOWN, MPI_COMM_CUBE, &request_send[1]);
-		MPI_Isend(buffer_border_left, count_border_left, MPI_BORDER, neighbor_left, LEFT, MPI_COMM_CUBE, &request_send[2]);
-		MPI_Isend(buffer_border_right, count_border_right, MPI_BORDER, neighbor_right, RIGHT, MPI_COMM_CUBE, &request_send[3]);
-
-		/* Process a third of the neighbors to guarantee that the sends take place before continuing and not waste time */
-		for(x = 1; x < (size_x/3); x++)
+		/* Every few generations cut the cube again so that every block gets about the same number of alive cells and
+		   move the cells to their new blocks. The neighbors stay the same, as the cuts along each axis are shared by all */
+		if((rebalance > 0) && (step == 0) && (countdown <= 0))
 		{
-			for(y = 1; y < (size_y - 1); y++)
+			buffer_block = block_to_array(block, &count_block, first_x, first_y, first_z, depth, size_x, size_y, size_z);
+			histogram = (int *) calloc(NDIMS * size, sizeof(int));
+			alloc_check(histogram);
+			for(i = 0; i < count_block; i++)
 			{
-				aux = block[x][y];
-				while(aux != NULL)
-				{
-					if(aux->status == ALIVE)
-					{
-						z = aux->coords.z;
-						node_add(&(block[x+1][y]), NEIGHBOR, DEAD, x+1, y, z);
-						node_add(&(block[x-1][y]), NEIGHBOR, DEAD, x-1, y, z);
-						node_add(&(block[x][y+1]), NEIGHBOR, DEAD, x, y+1, z);
-						node_add(&(block[x][y-1]), NEIGHBOR, DEAD, x, y-1, z);
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z+1), size));
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z-1), size));
-					}
-					aux = aux->next;
-				}
+				histogram[(HORIZONTAL * size) + buffer_block[i].x]++;
+				histogram[(VERTICAL * size) + buffer_block[i].y]++;
+				histogram[(DEPTH * size) + buffer_block[i].z]++;
 			}
+			MPI_Allreduce(MPI_IN_PLACE, histogram, NDIMS * size, MPI_INT, MPI_SUM, MPI_COMM_CUBE);
+			for(i = 0; i < NDIMS; i++)
+			{
+				rebalance_cuts(&histogram[i * size], size, cart_dimensions[i], depth, cuts[i]);
+			}
+			free(histogram);
+
+			buffer_migrate = array_migrate(buffer_block, count_block, &count_migrate, cuts, cart_dimensions, size, num_procs, MPI_COORDINATES, MPI_COMM_CUBE);
+			free(buffer_block);
+			block_clear(pools[0], block, size_x, size_y);
+			block_destroy(block);
+
+			block_bounds(cuts[HORIZONTAL], cart_coordinates[HORIZONTAL], depth, &first_x, &last_x, &size_x);
+			block_bounds(cuts[VERTICAL], cart_coordinates[VERTICAL], depth, &first_y, &last_y, &size_y);
+			block_bounds(cuts[DEPTH], cart_coordinates[DEPTH], depth, &first_z, &last_z, &size_z);
+			sizes[0] = size_x;
+			sizes[1] = size_y;
+			sizes[2] = size_z;
+			block = array_to_block(pools[0], buffer_migrate, count_migrate, first_x, first_y, first_z, depth, size_x, size_y);
+			free(buffer_migrate);
+
+			halo_destroy(buffer_halo, request_recv);
+			halo_create(buffer_halo, request_recv, neighbors, depth, sizes, MPI_COORDINATES, MPI_COMM_CUBE);
+			countdown = rebalance;
 		}
 
-		/* Probe the received halos form the neighbors, allocate memory and start the asynchronous receive */
-		MPI_Probe(neighbor_up, DOWN, MPI_COMM_CUBE, &status);
-		MPI_Get_count(&status, MPI_BORDER, &count_halo_up);
-		buffer_halo_up = (struct border *) calloc(count_halo_up, sizeof(struct border));
-		MPI_Irecv(buffer_halo_up, count_halo_up, MPI_BORDER, neighbor_up, DOWN, MPI_COMM_CUBE, &request_recv[0]);
-
-		MPI_Probe(neighbor_down, UP, MPI_COMM_CUBE, &status);
-		MPI_Get_count(&status, MPI_BORDER, &count_halo_down);
-		buffer_halo_down = (struct border *) calloc(count_halo_down, sizeof(struct border));
-		MPI_Irecv(buffer_halo_down, count_halo_down, MPI_BORDER, neighbor_down, UP, MPI_COMM_CUBE, &request_recv[1]);
-
-		MPI_Probe(neighbor_left, RIGHT, MPI_COMM_CUBE, &status);
-		MPI_Get_count(&status, MPI_BORDER, &count_halo_left);
-		buffer_halo_left = (struct border *) calloc(count_halo_left, sizeof(struct border));
-		MPI_Irecv(buffer_halo_left, count_halo_left, MPI_BORDER, neighbor_left, RIGHT, MPI_COMM_CUBE, &request_recv[2]);
-
-		MPI_Probe(neighbor_right, LEFT, MPI_COMM_CUBE, &status);
-		MPI_Get_count(&status, MPI_BORDER, &count_halo_right);
-		buffer_halo_right = (struct border *) calloc(count_halo_right, sizeof(struct border));
-		MPI_Irecv(buffer_halo_right, count_halo_right, MPI_BORDER, neighbor_right, LEFT, MPI_COMM_CUBE, &request_recv[3]);
-
-		/* Process a third of the neighbors to guarantee that the receives take place before continuing and not waste time */
-		for(x = (size_x/3); x < (2*(size_x/3)); x++)
+		/* The ghost zones are swapped every depth generations and in between the block advances on its own.
+		   After step generations only the cells at least step planes away from the sides of the block are right */
+		for(i = 0; i < 3; i++)
+		{
+			low[i] = step + 1;
+			high[i] = sizes[i] - step - 2;
+		}
+		if(step == 0)
 		{
-			for(y = 1; y < (size_y - 1); y++)
+			MPI_Startall(NFACES, request_recv);
+			for(face = 0; face < NFACES; face++)
 			{
-				aux = block[x][y];
-				while(aux != NULL)
+				border_bounds(face, depth, sizes, first, last);
+				block_to_border(block, &buffer_border[face], &capacity_border[face], &count_border[face], first, last, face / 2);
+				MPI_Isend(buffer_border[face], count_border[face], MPI_COORDINATES, neighbors[face], face, MPI_COMM_CUBE, &request_send[face]);
+				/* Deeper ghost zones take their edges and corners from the halos of the axes swapped before */
+				if((depth > 1) && ((face % 2) == 1))
 				{
-					if(aux->status == ALIVE)
-					{
-						z = aux->coords.z;
-						node_add(&(block[x+1][y]), NEIGHBOR, DEAD, x+1, y, z);
-						node_add(&(block[x-1][y]), NEIGHBOR, DEAD, x-1, y, z);
-						node_add(&(block[x][y+1]), NEIGHBOR, DEAD, x, y+1, z);
-						node_add(&(block[x][y-1]), NEIGHBOR, DEAD, x, y-1, z);
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z+1), size));
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z-1), size));
-					}
-					aux = aux->next;
+					halo_wait(&request_recv[face - 1], &status_recv[face - 1], &count_halo[face - 1], 2, MPI_COORDINATES);
+					OMP(omp parallel num_threads(num_threads))
+					block_add_halos(pools, block, buffer_halo, count_halo, face - 1, face, depth, sizes);
 				}
 			}
+
+			/* Mark the neighbors of the cells of the block itself while the halos are swapped and not waste time */
+			for(i = 0; i < 3; i++)
+			{
+				first[i] = depth;
+				last[i] = sizes[i] - depth - 1;
+			}
+		}
+		else
+		{
+			for(i = 0; i < 3; i++)
+			{
+				first[i] = step;
+				last[i] = sizes[i] - step - 1;
+			}
 		}
 
-		/* Wait for the receives to finish as they are needed to continue */
-		MPI_Waitall(4, request_recv, MPI_STATUSES_IGNORE);
-		block_add_halo_horizontal(block, buffer_halo_up, count_halo_up, 0);
-		free(buffer_halo_up);
-		block_add_halo_horizontal(block, buffer_halo_down, count_halo_down, size_y - 1);
-		free(buffer_halo_down);
-		block_add_halo_vertical(block, buffer_halo_left, count_halo_left, 0);
-		free(buffer_halo_left);
-		block_add_halo_vertical(block, buffer_halo_right, count_halo_right, size_x - 1);
-		free(buffer_halo_right);
-
-		/* Finish processing the neighbors */
-		for(x = (2*(size_x/3)); x < (size_x - 1); x++)
+		OMP(omp parallel num_threads(num_threads))
 		{
-			for(y = 1; y < (size_y - 1); y++)
+			/* Single ghost zones only need the faces, which are all swapped at once. The master thread waits for them
+			   while the others start marking, or after marking when it is on its own so the swap is still overlapped */
+			if((step == 0) && (depth == 1))
 			{
-				aux = block[x][y];
-				while(aux != NULL)
+				if(omp_get_num_threads() > 1)
 				{
-					if(aux->status == ALIVE)
-					{
-						z = aux->coords.z;
-						node_add(&(block[x+1][y]), NEIGHBOR, DEAD, x+1, y, z);
-						node_add(&(block[x-1][y]), NEIGHBOR, DEAD, x-1, y, z);
-						node_add(&(block[x][y+1]), NEIGHBOR, DEAD, x, y+1, z);
-						node_add(&(block[x][y-1]), NEIGHBOR, DEAD, x, y-1, z);
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z+1), size));
-						node_add(&(block[x][y]), NEIGHBOR, DEAD, x, y, MOD((z-1), size));
-					}
-					aux = aux->next;
+					OMP(omp master)
+					halo_wait(request_recv, status_recv, count_halo, NFACES, MPI_COORDINATES);
+				}
+				mark_neighbors(pools, block, first, last, low, high);
+				if(omp_get_num_threads() == 1)
+				{
+					halo_wait(request_recv, status_recv, count_halo, NFACES, MPI_COORDINATES);
 				}
+				block_add_halos(pools, block, buffer_halo, count_halo, LEFT, BACK, depth, sizes);
+			}
+			else
+			{
+				mark_neighbors(pools, block, first, last, low, high);
 			}
+			determine_next_generation(pools, block, low, high, size_x, size_y, rule);
 		}
-		mark_neighbors_halo_vertical(block, 0, 1, size_y);
-		mark_neighbors_halo_vertical(block, size_x - 1, size_x - 2, size_y);
-		mark_neighbors_halo_horizontal(block, 0, 1, size_x);
-		mark_neighbors_halo_horizontal(block, size_y - 1, size_y - 2, size_x);
-		determine_next_generation(block, size_x, size_y);
+
+		/* Synchronization point for the sends as their buffers are refilled in the next exchange */
+		if(step == 0)
+		{
+			MPI_Waitall(NFACES, request_send, MPI_STATUSES_IGNORE);
+		}
+
+#ifdef PROFILE
+		/* Ratio between the most alive cells of a block and the average over all of them */
+		count_block = block_alive_count(block, depth, size_x, size_y, size_z);
+		MPI_Reduce(&count_block, &count_max, 1, MPI_INT, MPI_MAX, ROOT, MPI_COMM_CUBE);
+		MPI_Reduce(&count_block, &count_sum, 1, MPI_INT, MPI_SUM, ROOT, MPI_COMM_CUBE);
+		if(rank == ROOT)
+		{
+			fprintf(stderr, "Generation %llu imbalance %.2f\n", (unsigned long long) (generation - iterations + 1),
+					(count_sum > 0) ? ((double) count_max * num_procs) / count_sum : 1.0);
+		}
+#endif
+
+		step = (step + 1) % depth;
+		countdown--;
 		iterations--;
+	}
 
-		/* Synchronization point for the sends just to guarantee no overlapping occurs between iterations */
-		MPI_Waitall(4, request_send, MPI_STATUSES_IGNORE);
-		free(buffer_border_up);
-		free(buffer_border_down);
-		free(buffer_border_left);
-		free(buffer_border_right);
+	/* Release the persistent receives and the buffers of the borders and halos */
+	halo_destroy(buffer_halo, request_recv);
+	for(face = 0; face < NFACES; face++)
+	{
+		free(buffer_border[face]);
+	}
+	for(i = 0; i < NDIMS; i++)
+	{
+		free(cuts[i]);
 	}
 
-	/* Turns the assigned block of the process into an array to send to the root */
-	buffer_block = block_to_array(block, &count_block, first_x, first_y, size_x, size_y);
-	block_destroy(block, size_x, size_y);
+	/* Turns the assigned block of the process into an array sorted by x, y and z to send to the root */
+	buffer_block = block_to_array(block, &count_block, first_x, first_y, first_z, depth, size_x, size_y, size_z);
+	block_destroy(block);
 
 	/* Root process gathers the sizes of the arrays sent by all the processes */
 	if(rank == ROOT)
@@ -1117,27 +2527,29 @@ int main(int argc, char *argv[])
 	}
 	MPI_Gather(&count_block, 1, MPI_INT, recvcounts, 1, MPI_INT, ROOT, MPI_COMM_CUBE);
 
-	/* Root process computes the necessary values and gathers the arrays of all the processes */
+	/* Root process merges the arrays of all the processes into the solution of the problem while it prints it */
 	if(rank == ROOT)
 	{
 		count_total = get_count_total(recvcounts, num_procs);
-		displs = get_displs(recvcounts, num_procs);
-		buffer_gather = (struct coordinates *) calloc(count_total, sizeof(struct coordinates));
+		output = output_create(STDOUT_FILENO, binary, size, generation);
+		if(binary)
+		{
+			output_header(output, count_total);
+		}
+		output_merge(output, buffer_block, count_block, recvcounts, num_procs, MPI_COORDINATES, MPI_COMM_CUBE);
+		output_destroy(output);
+		free(recvcounts);
+	}
+	else
+	{
+		output_send(buffer_block, count_block, MPI_COORDINATES, MPI_COMM_CUBE);
 	}
-
-	MPI_Gatherv(buffer_block, count_block, MPI_COORDINATES, buffer_gather, recvcounts, displs, MPI_COORDINATES, ROOT, MPI_COMM_CUBE);
 	free(buffer_block);
-
-	/* Root process turns the received arrays into the final block with the solution of the problem and prints it */
-	if(rank == ROOT)
+	for(i = 0; i < num_threads; i++)
 	{
-		free(displs);
-		free(recvcounts);
-		block = array_to_block(buffer_gather, count_total, size, size);
-		free(buffer_gather);
-		block_print_cells(block, size, size, ALIVE);
-		block_destroy(block, size, size);
+		pool_destroy(pools[i]);
 	}
+	free(pools);
 
 	/* Finalize MPI */
 	MPI_Barrier(MPI_COMM_CUBE);
@@ -12,36 +12,125 @@
  * \date 		07/04/2017
  */
 /************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
 #include <omp.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef PROFILE
+#include <time.h>
+#endif
 
 /************************************************** DEFINE **************************************************/
 /************************************************** CONSTANTS **************************************************/
 #define ALIVE 				1		/** \def 	Macro to differentiate alive from dead cells 	*/
-#define BUFFER_SIZE			200		/** \def 	Size of the file reading buffer 				*/
+#define BALANCE_INTERVAL 	8		/** \def 	Number of generations between balances of the bands */
+#define BANDS_PER_THREAD 	4		/** \def 	Number of bands of each color per thread 		*/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
+#define COLUMN_WEIGHT 		8		/** \def 	Number of empty columns that cost as much as a cell */
 #define DEAD 				0		/** \def 	Macro to differentiate alive from dead cells 	*/
 #define NEIGHBOR 			1		/** \def 	Macro to differentiate neighbor from new cells 	*/
-#define NEW 				0		/** \def 	Macro to differentiate neighbor from new cells 	*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define POOL_SLAB_SIZE		4096	/** \def 	Number of nodes allocated at once by a pool 	*/
+#define RULE_DEFAULT 		0x1c0c	/** \def 	Lookup table of the rule B23/S234 				*/
 
 /************************************************** OPERATORS **************************************************/
+#define COORDINATE(cell, axis) 	(((axis) == 0) ? (cell).x : (((axis) == 1) ? (cell).y : (cell).z))
 #define MOD(a, b) 			(((a) < 0) ? ((a) % (b) + (b)) : ((a) % (b)))
+#define RULE_NEXT(rule, alive, count) 	(((rule) >> (((alive) << 3) | (count))) & 1)
 
 /************************************************** PROTOTYPES **************************************************/
+struct 				coordinates;
+struct 				input;
 struct 				node;
+struct 				output;
+struct 				pool;
+struct 				schedule;
+struct 				slab;
 void 				alloc_check 				(void *ptr);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+void 				coordinates_sort_pass 		(struct coordinates *source, struct coordinates *destination, int *counts, int count, int size, int axis);
 struct node *** 	cube_create 				(int size);
-void 				cube_destroy 				(struct node ***cube, int size);
-void 				cube_print 					(struct node ***cube, int size);
-void 				cube_purge 					(struct node ***cube, int size);
-void 				determine_next_generation 	(struct node ***cube, int size);
-void 				mark_neighbors 				(struct node ***cube, int size);
-void 				node_add 					(struct node **head, short mode, short status, int z);
-struct node * 		node_create 				(short status, int z);
-void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations);
-void 				read_coordinates 			(FILE *input_fd, struct node ***cube);
-int 				read_size 					(FILE *input_fd);
+void 				cube_destroy 				(struct node ***cube);
+void 				cube_print 					(struct output *output, struct node ***cube, int size, int parallel);
+void 				determine_next_generation 	(struct pool **pools, struct node ***cube, struct schedule *schedule, int band, int size, int rule);
+char * 				input_align 				(struct input *input, char *ptr);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+void 				mark_neighbors 				(struct pool **pools, struct node ***cube, struct schedule *schedule, int band, int size);
+void 				node_add 					(struct pool *pool, struct node **head, short mode, short status, int z);
+struct node * 		node_create 				(struct pool *pool, short status, int z);
+void 				node_destroy 				(struct pool *pool, struct node *node);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_pwrite 				(int fd, char *data, size_t length, off_t offset);
+void 				output_write 				(int fd, char *data, size_t length);
+struct pool * 		pool_create 				(void);
+void 				pool_destroy 				(struct pool *pool);
+void 				pool_grow 					(struct pool *pool);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *parallel, int *rule);
+void 				read_coordinates 			(struct input *input, struct pool **pools, struct node ***cube, int *weights, int size);
+int 				read_rule 					(char *text);
+int 				read_size 					(struct input *input);
+void 				schedule_balance 			(struct schedule *schedule, int size);
+struct schedule * 	schedule_create 			(int size);
+void 				schedule_destroy 			(struct schedule *schedule);
+#ifdef PROFILE
+double 				thread_time 				(void);
+#endif
+
+/************************************************** STRUCT COORDINATES **************************************************/
+/** \struct
+ * Structure that represents the coordinates of a cell while the input file is loaded
+ */
+struct coordinates
+{
+	short 			x; 					/**<	x-coordinate of the cell 									*/
+	short 			y; 					/**<	y-coordinate of the cell 									*/
+	short 			z; 					/**<	z-coordinate of the cell 									*/
+};
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
 
 /************************************************** STRUCT NODE **************************************************/
 /** \struct
@@ -57,6 +146,59 @@ struct node
 	struct node 	*next; 				/**< 	Pointer to another cell with the same [x][y] coordinates 	*/
 };
 
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text not written yet 								*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	int 			fd; 				/**<	File descriptor of the text, or -1 to keep it in memory 		*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** STRUCT POOL **************************************************/
+/** \struct
+ * Structure that recycles the nodes removed from the cube.
+ * Each thread owns one so that creating and removing nodes never
+ * requires synchronization nor a call to the allocator in the steady state
+ */
+struct pool
+{
+	struct node 	*free_list; 		/**<	Nodes available to be reused 								*/
+	struct slab 	*slabs; 			/**<	Blocks of memory owned by the pool 							*/
+};
+
+/************************************************** STRUCT SCHEDULE **************************************************/
+/** \struct
+ * Structure that splits the cube along x into bands for the tasks.
+ * The bands are recomputed every few generations from the number of alive cells
+ * of each plane so that all of them have about the same amount of work
+ */
+struct schedule
+{
+	double 			*busy; 				/**<	Time each thread spent working, only measured with PROFILE 	*/
+	char 			*tokens; 			/**<	Dependences of the tasks that mark the neighbors of each band */
+	int 			*bounds; 			/**<	First plane of each band, followed by the size of the cube 	*/
+	int 			*weights; 			/**<	Number of alive cells of each plane 						*/
+	int 			count; 				/**<	Number of bands, even unless there is a single one 			*/
+};
+
+/************************************************** STRUCT SLAB **************************************************/
+/** \struct
+ * Structure that represents a block of nodes allocated at once by a pool
+ */
+struct slab
+{
+	struct node 	nodes[POOL_SLAB_SIZE]; 	/**<	Nodes of this block 									*/
+	struct slab 	*next; 					/**<	Pointer to the previously allocated block 				*/
+};
+
 /************************************************** ALLOC_CHECK **************************************************/
 /**
  * Checks if a given memory allocation was successful
@@ -72,6 +214,195 @@ void alloc_check(void *ptr)
 	}
 }
 
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** COORDINATES_SORT_PASS **************************************************/
+/**
+ * Stable counting sort of the cells by one of their coordinates
+ *
+ * @param source 			Cells to sort
+ * @param destination 		Where to store the sorted cells
+ * @param counts 			Room for size counters
+ * @param count 			Number of cells
+ * @param size 				Size of the sides of the cube
+ * @param axis 				Coordinate to sort by: 0 for x, 1 for y and 2 for z
+ */
+void coordinates_sort_pass(struct coordinates *source, struct coordinates *destination, int *counts, int count, int size, int axis)
+{
+	int 	i 		= 0; 		/**< 	Index of the cell 							*/
+	int 	key 	= 0; 		/**< 	Value of the coordinate of the cell 		*/
+	int 	total 	= 0; 		/**< 	Running sum of the counters 				*/
+	int 	tmp 	= 0; 		/**< 	Temporary variable to swap the counters 	*/
+
+	memset(counts, 0, size * sizeof(int));
+	for(i = 0; i < count; i++)
+	{
+		counts[COORDINATE(source[i], axis)]++;
+	}
+	/* Turn the counters into the position of the first cell with each value */
+	for(key = 0; key < size; key++)
+	{
+		tmp = counts[key];
+		counts[key] = total;
+		total += tmp;
+	}
+	for(i = 0; i < count; i++)
+	{
+		destination[counts[COORDINATE(source[i], axis)]++] = source[i];
+	}
+}
+
 /************************************************** CUBE_CREATE **************************************************/
 /**
  * Creates a 2D size by size "cube" of pointers to nodes and returns it
@@ -100,221 +431,390 @@ struct node *** cube_create(int size)
 
 /************************************************** CUBE_DESTROY **************************************************/
 /**
- * Frees the memory allocated for the structure required for the problem
+ * Frees the memory allocated for the structure required for the problem.
+ * The nodes themselves belong to the pools and are released by pool_destroy
  *
  * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
  */
-void cube_destroy(struct node ***cube, int size)
+void cube_destroy(struct node ***cube)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
-
-	for(x = 0; x < size; x++)
-	{
-		for(y = 0; y < size; y++)
-		{
-			while(cube[x][y] != NULL)
-			{
-				aux = cube[x][y];
-				cube[x][y] = cube[x][y]->next;
-				free(aux);
-			}
-		}
-	}
 	free(cube[0]);
 	free(cube);
 }
 
 /************************************************** CUBE_PRINT **************************************************/
 /**
- * Prints the solution of the problem to stdout
+ * Prints the solution of the problem to the given output.
+ * By default the cells are formatted in order into the output buffer, which is written whenever it fills up.
+ * When parallel output is requested and the output is a regular file, each thread formats a contiguous
+ * range of x in its own buffer instead, the file is extended to its final length and every thread writes
+ * its buffer at the offset given by the lengths of the buffers before it.
+ * In the binary format the header, which needs the number of cells, is written first
  *
+ * @param output 	Output buffer
  * @param cube 		Structure that contains the cells
  * @param size 		Size of the sides of the cube
+ * @param parallel 	Whether the threads may write at the same time
  */
-void cube_print(struct node ***cube, int size)
+void cube_print(struct output *output, struct node ***cube, int size, int parallel)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	struct output 	**chunks 		= NULL; 	/**< 	Formatted cells of each thread 					*/
+	struct node 	*aux 			= NULL;
+	struct stat 	info; 						/**< 	Information about the output file 				*/
+	off_t 			*offsets 		= NULL; 	/**< 	Offset in the file of the buffer of each thread */
+	off_t 			start 			= 0; 		/**< 	Offset in the file where the output starts 		*/
+	uint64_t 		count 			= 0; 		/**< 	Number of alive cells 							*/
+	int 			num_threads 	= 0; 		/**< 	Number of threads used by OpenMP 				*/
+	int 			i 				= 0;
+	int 			x 				= 0;
+	int 			y 				= 0;
 
-	for(x = 0; x < size; x++)
+	/* Only a regular file can be written at any offset */
+	parallel = parallel && (fstat(output->fd, &info) == 0) && S_ISREG(info.st_mode) && !(fcntl(output->fd, F_GETFL) & O_APPEND);
+	if(!parallel)
 	{
-		for(y = 0; y < size; y++)
+		if(output->binary)
 		{
-			aux = cube[x][y];
-			while(aux != NULL)
+			#pragma omp parallel for private(aux, y) reduction(+:count) schedule(static)
+			for(x = 0; x < size; x++)
 			{
-				if(aux->status == ALIVE)
+				for(y = 0; y < size; y++)
 				{
-					fprintf(stdout, "%d %d %d\n", x, y, aux->z);
+					for(aux = cube[x][y]; aux != NULL; aux = aux->next)
+					{
+						count += (aux->status == ALIVE);
+					}
 				}
-				aux = aux->next;
 			}
+			output_header(output, count);
+		}
+		for(x = 0; x < size; x++)
+		{
+			for(y = 0; y < size; y++)
+			{
+				for(aux = cube[x][y]; aux != NULL; aux = aux->next)
+				{
+					if(aux->status == ALIVE)
+					{
+						output_cell(output, x, y, aux->z);
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	num_threads = omp_get_max_threads();
+	chunks = (struct output **) calloc(num_threads, sizeof(struct output *));
+	offsets = (off_t *) calloc(num_threads + 1, sizeof(off_t));
+	alloc_check(chunks);
+	alloc_check(offsets);
+
+	#pragma omp parallel num_threads(num_threads) private(aux, i, y)
+	{
+		struct output 	*chunk 		= NULL;
+		int 			thread 		= omp_get_thread_num();
+
+		/* A static schedule gives each thread a contiguous range of x, in the order of the threads */
+		chunk = output_create(-1, output->binary, size, 0);
+		chunks[thread] = chunk;
+		#pragma omp for schedule(static)
+		for(x = 0; x < size; x++)
+		{
+			for(y = 0; y < size; y++)
+			{
+				aux = cube[x][y];
+				while(aux != NULL)
+				{
+					if(aux->status == ALIVE)
+					{
+						output_cell(chunk, x, y, aux->z);
+					}
+					aux = aux->next;
+				}
+			}
+		}
+
+		/* Compute where each buffer goes and make room for all of them in the file */
+		#pragma omp single
+		{
+			for(i = 0; i < num_threads; i++)
+			{
+				offsets[i + 1] = offsets[i] + chunks[i]->length;
+			}
+			if(output->binary)
+			{
+				output_header(output, offsets[num_threads] / 8);
+			}
+			output_flush(output);
+			start = lseek(output->fd, 0, SEEK_CUR);
+			parallel = (start >= 0) && (ftruncate(output->fd, start + offsets[num_threads]) == 0);
+			if(!parallel)
+			{
+				for(i = 0; i < num_threads; i++)
+				{
+					output_write(output->fd, chunks[i]->buffer, chunks[i]->length);
+				}
+			}
+		}
+
+		if(parallel)
+		{
+			output_pwrite(output->fd, chunk->buffer, chunk->length, start + offsets[thread]);
 		}
+		free(chunk->buffer);
+		free(chunk);
+	}
+
+	if(parallel)
+	{
+		lseek(output->fd, start + offsets[num_threads], SEEK_SET);
 	}
+	free(chunks);
+	free(offsets);
 }
 
-/************************************************** CUBE_PURGE **************************************************/
+/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
 /**
- * Clean up routine to remove dead cells from the already processed
- * structure as a way to speed up the next iteration
+ * Iterates through all the cells of a band, determines whether they live
+ * or die in the next generation and removes the dead ones right away.
+ * The band is handled by a single task, which keeps the removed nodes in the pool
+ * of the thread that runs it, so the pass needs no synchronization of its own.
+ * The alive cells of each plane are counted to balance the next generations
  *
+ * @param pools 	Pools of nodes, one for each thread
  * @param cube 		Structure that contains the cells
+ * @param schedule 	Bands of the cube, whose weights are updated
+ * @param band 		Index of the band to process
  * @param size 		Size of the sides of the cube
+ * @param rule 		Lookup table of the rule
  */
-void cube_purge(struct node ***cube, int size)
+void determine_next_generation(struct pool **pools, struct node ***cube, struct schedule *schedule, int band, int size, int rule)
 {
-	struct node 	**ptr 	= NULL; 	/**< 	Dereferencing pointer 	*/
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 		*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 			*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 			*/
+	struct node 	**ptr 	= NULL; 	/**< 	Dereferencing pointer 					*/
+	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 						*/
+	struct pool 	*pool 	= NULL; 	/**< 	Pool of the thread running the task 	*/
+	int 			alive 	= 0; 		/**< 	Number of alive cells of the plane 		*/
+	int 			x 		= 0; 		/**< 	x-Coordinate 							*/
+	int 			y 		= 0; 		/**< 	y-Coordinate 							*/
+#ifdef PROFILE
+	double 			start 	= 0; 		/**< 	Time when the band was started 			*/
 
-	for(x = 0; x < size; x++)
+	start = thread_time();
+#endif
+
+	pool = pools[omp_get_thread_num()];
+	for(x = schedule->bounds[band]; x < schedule->bounds[band + 1]; x++)
 	{
+		alive = 0;
 		for(y = 0; y < size; y++)
 		{
 			ptr = &cube[x][y];
 			aux = *ptr;
 			while(aux != NULL)
 			{
+				/* The rule gives the next state from the current one and the number of neighbors, without branches */
+				aux->status = RULE_NEXT(rule, aux->status, aux->alive_neighbors);
+				/* Remove the cells that are dead in the next generation and reset the number of neighbors of the others */
 				if(aux->status == DEAD)
 				{
 					*ptr = aux->next;
-					free(aux);
+					node_destroy(pool, aux);
 				}
 				else
 				{
+					aux->alive_neighbors = 0;
 					ptr = &aux->next;
+					alive++;
 				}
 				aux = *ptr;
 			}
 		}
+		schedule->weights[x] = alive;
 	}
+
+#ifdef PROFILE
+	schedule->busy[omp_get_thread_num()] += thread_time() - start;
+#endif
 }
 
-/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
+/************************************************** INPUT_ALIGN **************************************************/
 /**
- * Iterates through all the cells in the cube and determines whether
- * they live or die in the next generation
+ * Moves a position of the mapped file forward to the start of the line that follows it,
+ * unless it already is the start of a line, so that chunks of the file can be parsed independently
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @param input 			Mapped input file
+ * @param ptr 				Position to align
+ * @return 					Start of a line or the end of the file
  */
-void determine_next_generation(struct node ***cube, int size)
+char * input_align(struct input *input, char *ptr)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	if((ptr == input->cursor) || (ptr == input->end) || (ptr[-1] == '\n'))
+	{
+		return ptr;
+	}
 
-	#pragma omp for schedule(static)
-	for(x = 0; x < size; x++)
+	ptr = memchr(ptr, '\n', input->end - ptr);
+	return (ptr == NULL) ? input->end : ptr + 1;
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
 	{
-		for(y = 0; y < size; y++)
-		{
-			aux = cube[x][y];
-			while(aux != NULL)
-			{
-				/* If the cell is alive and has less than 2 or more than 4 neighbors it dies */
-				if(aux->status == ALIVE)
-				{
-					if(aux->alive_neighbors < 2 || aux->alive_neighbors > 4)
-					{
-						aux->status = DEAD;
-					}
-				}
-				/* If the cell is dead and has either 2 or 3 neighbors it comes to life */
-				else
-				{
-					if(aux->alive_neighbors == 2 || aux->alive_neighbors == 3)
-					{
-						aux->status = ALIVE;
-					}
-				}
-				/* Reset the number of neighbors of all processed cells */
-				aux->alive_neighbors = 0;
-				aux = aux->next;
-			}
-		}
+		cursor++;
+		line++;
 	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
 }
 
-/************************************************** LOCKS_CREATE **************************************************/
+/************************************************** INPUT_MAP **************************************************/
 /**
- * Creates and initializes a 2D size by size matrix of locks and returns it
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
  *
- * @param size 		Size of the sides of the matrix
- * @return 			Locks
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
  */
-omp_lock_t ** locks_create(int size)
+struct input * input_map(char *input_filename)
 {
-	omp_lock_t 		**locks 		= NULL;
-	omp_lock_t 		*locks_mem 		= NULL;
-	int 			x 				= 0;
-	int 			y 				= 0;
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
 
-	locks = (omp_lock_t **) calloc(size, sizeof(omp_lock_t *));
-	locks_mem = (omp_lock_t *) calloc(size * size, sizeof(omp_lock_t));
-	alloc_check(locks);
-	alloc_check(locks_mem);
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
 
-	for(x = 0; x < size; x++)
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
 	{
-		locks[x] = &locks_mem[size * x];
-		for(y = 0; y < size; y++)
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
 		{
-			omp_init_lock(&(locks[x][y]));
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
 		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
 	}
+	close(fd);
 
-	return locks;
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
 }
 
-/************************************************** LOCKS_DESTROY **************************************************/
+/************************************************** INPUT_SCAN **************************************************/
 /**
- * Destroys and frees the memory allocated for the locks required for the problem
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
  *
- * @param locks 	Structure that contains the locks
- * @param size 		Size of the sides of the matrix of locks
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
  */
-void locks_destroy(omp_lock_t **locks, int size)
+char * input_scan(char *ptr, char *end, int *values, int count)
 {
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
 
-	for(x = 0; x < size; x++)
+	for(i = 0; i < count; i++)
 	{
-		for(y = 0; y < size; y++)
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
 		{
-			omp_destroy_lock(&(locks[x][y]));
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
 		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
 	}
-	free(locks[0]);
-	free(locks);
+	free(input);
 }
 
 /************************************************** MARK_NEIGHBORS **************************************************/
 /**
  * Increments the alive neighbors count of all the neighbors of all
- * alive cells in the current generation
+ * alive cells of a band in the current generation.
+ * The cells of a band only touch the lists of its own planes and of the planes right next to it,
+ * so the task of a band must not run at the same time as the ones of the bands next to it
  *
- * @param locks		OpenMP locks to guarantee synchronization between all
- *					threads acessing the same list
+ * @param pools 	Pools of nodes, one for each thread
  * @param cube 		Structure that contains the cells
+ * @param schedule 	Bands of the cube
+ * @param band 		Index of the band to process
  * @param size 		Size of the sides of the cube
  */
-void mark_neighbors(omp_lock_t **locks, struct node ***cube, int size)
+void mark_neighbors(struct pool **pools, struct node ***cube, struct schedule *schedule, int band, int size)
 {
 	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 													*/
+	struct pool 	*pool 	= NULL; 	/**< 	Pool of the thread running the task 								*/
 	int 			tmp 	= 0; 		/**< 	Temporary variable to avoid computing the modulo multiple times 	*/
 	int 			x 		= 0; 		/**< 	x-Coordinate 														*/
 	int 			y 		= 0; 		/**< 	y-Coordinate 														*/
 	int 			z 		= 0; 		/**< 	z-Coordinate 														*/
+#ifdef PROFILE
+	double 			start 	= 0; 		/**< 	Time when the band was started 										*/
 
-	#pragma omp for schedule(static)
-	for(x = 0; x < size; x++)
+	start = thread_time();
+#endif
+
+	pool = pools[omp_get_thread_num()];
+	for(x = schedule->bounds[band]; x < schedule->bounds[band + 1]; x++)
 	{
 		for(y = 0; y < size; y++)
 		{
@@ -327,53 +827,40 @@ void mark_neighbors(omp_lock_t **locks, struct node ***cube, int size)
 					z = aux->z;
 					/* Compute the modulo just once to avoid having to do it once for each of the following 3 operations */
 					tmp = MOD((x+1), size);
-					/* Set the lock corresponding to that list on the cube and unset it after the operation is done */
-					omp_set_lock(&(locks[tmp][y]));
-					add_node(&(cube[tmp][y]), NEIGHBOR, DEAD, z);
-					omp_unset_lock(&(locks[tmp][y]));
-
+					node_add(pool, &(cube[tmp][y]), NEIGHBOR, DEAD, z);
 					tmp = MOD((x-1), size);
-					omp_set_lock(&(locks[tmp][y]));
-					add_node(&(cube[tmp][y]), NEIGHBOR, DEAD, z);
-					omp_unset_lock(&(locks[tmp][y]));
-
+					node_add(pool, &(cube[tmp][y]), NEIGHBOR, DEAD, z);
 					tmp = MOD((y+1), size);
-					omp_set_lock(&(locks[x][tmp]));
-					add_node(&(cube[x][tmp]), NEIGHBOR, DEAD, z);
-					omp_unset_lock(&(locks[x][tmp]));
-
+					node_add(pool, &(cube[x][tmp]), NEIGHBOR, DEAD, z);
 					tmp = MOD((y-1), size);
-					omp_set_lock(&(locks[x][tmp]));
-					add_node(&(cube[x][tmp]), NEIGHBOR, DEAD, z);
-					omp_unset_lock(&(locks[x][tmp]));
-
+					node_add(pool, &(cube[x][tmp]), NEIGHBOR, DEAD, z);
 					tmp = MOD((z+1), size);
-					omp_set_lock(&(locks[x][y]));
-					add_node(&(cube[x][y]), NEIGHBOR, DEAD, tmp);
-					omp_unset_lock(&(locks[x][y]));
-
+					node_add(pool, &(cube[x][y]), NEIGHBOR, DEAD, tmp);
 					tmp = MOD((z-1), size);
-					omp_set_lock(&(locks[x][y]));
-					add_node(&(cube[x][y]), NEIGHBOR, DEAD, tmp);
-					omp_unset_lock(&(locks[x][y]));
+					node_add(pool, &(cube[x][y]), NEIGHBOR, DEAD, tmp);
 				}
 				aux = aux->next;
 			}
 		}
 	}
+
+#ifdef PROFILE
+	schedule->busy[omp_get_thread_num()] += thread_time() - start;
+#endif
 }
 
 /************************************************** NODE_ADD **************************************************/
 /**
  * Adds a node to the given list
  *
+ * @param pool 		Pool from which new nodes are taken
  * @param head 		Head of the list where to insert the node
  * @param mode 		A way to differentiate whether we're adding neighbors of alive cells or alive cells themselves.
  *					It could be suppressed by creating an almost identical function for each case
  * @param status 	Status of the cell to add
  * @param z 		z-coordinate of the cell to add
  */
-void node_add(struct node **head, short mode, short status, int z)
+void node_add(struct pool *pool, struct node **head, short mode, short status, int z)
 {
 	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 		*/
 	struct node 	*new 	= NULL; 	/**< 	Pointer to a new node 	*/
@@ -381,7 +868,7 @@ void node_add(struct node **head, short mode, short status, int z)
 	/* Add the node at the start of the list if its either empty or if it has the smallest z-coordinate */
 	if(((*head) == NULL) || ((*head)->z > z))
 	{
-		new = node_create(status, z);
+		new = node_create(pool, status, z);
 		new->alive_neighbors += mode;
 		new->next = (*head);
 		(*head) = new;
@@ -408,7 +895,7 @@ void node_add(struct node **head, short mode, short status, int z)
 		/* Otherwise add the node */
 		else
 		{
-			new = node_create(status, z);
+			new = node_create(pool, status, z);
 			new->alive_neighbors += mode;
 			new->next = aux->next;
 			aux->next = new;
@@ -418,18 +905,24 @@ void node_add(struct node **head, short mode, short status, int z)
 
 /************************************************** NODE_CREATE **************************************************/
 /**
- * Creates a node that represent a cell in the game
+ * Creates a node that represent a cell in the game, reusing one
+ * from the pool and only growing it when it runs out of nodes
  *
+ * @param pool 		Pool from which the node is taken
  * @param status 	Status of the cell to create
  * @param z 		z-coordinate of the cell to create
  * @return 			Pointer to the cell created
  */
-struct node * node_create(short status, int z)
+struct node * node_create(struct pool *pool, short status, int z)
 {
 	struct node 	*new 	= NULL; 	/**< 	Pointer to the new node 	*/
 
-	new = (struct node *) calloc(1, sizeof(struct node));
-	alloc_check(new);
+	if(pool->free_list == NULL)
+	{
+		pool_grow(pool);
+	}
+	new = pool->free_list;
+	pool->free_list = new->next;
 
 	new->alive_neighbors = 0;
 	new->status = status;
@@ -439,6 +932,292 @@ struct node * node_create(short status, int z)
 	return new;
 }
 
+/************************************************** NODE_DESTROY **************************************************/
+/**
+ * Gives a node that is no longer in use back to the pool
+ *
+ * @param pool 		Pool where the node is kept for reuse
+ * @param node 		Node to give back
+ */
+void node_destroy(struct pool *pool, struct node *node)
+{
+	node->next = pool->free_list;
+	pool->free_list = node;
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, making room in the buffer first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL; 	/**< 	Where to format the next character 	*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
+	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
+}
+
+/************************************************** OUTPUT_CREATE **************************************************/
+/**
+ * Creates an empty output buffer for the given file descriptor and returns it
+ *
+ * @param fd 		File descriptor where the output is written, or -1 to keep all of it in memory
+ * @param binary 	Whether the output uses the binary format
+ * @param size 		Size of the sides of the cube
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
+ */
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
+{
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
+
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
+
+	return output;
+}
+
+/************************************************** OUTPUT_DESTROY **************************************************/
+/**
+ * Writes out what is left in the output buffer and frees it
+ *
+ * @param output 	Output buffer
+ */
+void output_destroy(struct output *output)
+{
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
+
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it.
+ * Buffers that are kept in memory grow instead
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	if(output->fd < 0)
+	{
+		output->capacity *= 2;
+		output->buffer = (char *) realloc(output->buffer, output->capacity);
+		alloc_check(output->buffer);
+		return;
+	}
+
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
+}
+
+/************************************************** OUTPUT_HEADER **************************************************/
+/**
+ * Writes the header of the binary format to the output buffer
+ *
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
+ */
+void output_header(struct output *output, uint64_t count)
+{
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
+
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
+	{
+		output_flush(output);
+	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
+}
+
+/************************************************** OUTPUT_INT **************************************************/
+/**
+ * Formats a non-negative integer in decimal, without going through printf
+ *
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
+ */
+char * output_int(char *ptr, int value)
+{
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
+
+	do
+	{
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
+	}
+
+	return ptr;
+}
+
+/************************************************** OUTPUT_PWRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor at the given offset, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ * @param offset 	Offset in the file where to write the data
+ */
+void output_pwrite(int fd, char *data, size_t length, off_t offset)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = pwrite(fd, data, length, offset);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+		offset += written;
+	}
+}
+
+/************************************************** OUTPUT_WRITE **************************************************/
+/**
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
+ *
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
+ */
+void output_write(int fd, char *data, size_t length)
+{
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
+
+	while(length > 0)
+	{
+		written = write(fd, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
+		}
+		data += written;
+		length -= written;
+	}
+}
+
+/************************************************** POOL_CREATE **************************************************/
+/**
+ * Creates an empty pool of nodes and returns it
+ *
+ * @return 			Pool
+ */
+struct pool * pool_create(void)
+{
+	struct pool 	*pool 	= NULL; 	/**< 	Pointer to the new pool 	*/
+
+	pool = (struct pool *) calloc(1, sizeof(struct pool));
+	alloc_check(pool);
+
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+
+	return pool;
+}
+
+/************************************************** POOL_DESTROY **************************************************/
+/**
+ * Frees all the memory owned by the pool, including the nodes still in use
+ *
+ * @param pool 		Pool to destroy
+ */
+void pool_destroy(struct pool *pool)
+{
+	struct slab 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
+
+	while(pool->slabs != NULL)
+	{
+		aux = pool->slabs;
+		pool->slabs = pool->slabs->next;
+		free(aux);
+	}
+	free(pool);
+}
+
+/************************************************** POOL_GROW **************************************************/
+/**
+ * Allocates a new slab of nodes and chains all of them in the free list of the pool
+ *
+ * @param pool 		Pool to grow
+ */
+void pool_grow(struct pool *pool)
+{
+	struct slab 	*slab 	= NULL; 	/**< 	Pointer to the new slab 	*/
+	int 			i 		= 0; 		/**< 	Index of the node in the slab 	*/
+
+	slab = (struct slab *) malloc(sizeof(struct slab));
+	alloc_check(slab);
+
+	for(i = 0; i < (POOL_SLAB_SIZE - 1); i++)
+	{
+		slab->nodes[i].next = &(slab->nodes[i+1]);
+	}
+	slab->nodes[POOL_SLAB_SIZE - 1].next = pool->free_list;
+	pool->free_list = &(slab->nodes[0]);
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+}
+
 /************************************************** READ_ARGUMENTS **************************************************/
 /**
  * Checks if the command line arguments verify the specifications
@@ -447,17 +1226,51 @@ struct node * node_create(short status, int z)
  * @param argv				Command line arguments
  * @param input_filename	Name of the file specified in the arguments
  * @param iterations 		Number of iterations specified in the arguments
+ * @param binary 			Whether to print the solution in the binary format
+ * @param parallel 			Whether the threads write the solution at the same time, if it goes to a regular file
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
  */
-void read_arguments(int argc, char *argv[], char **input_filename, int *iterations)
+void read_arguments(int argc, char *argv[], char **input_filename, int *iterations, int *binary, int *parallel, int *rule)
 {
 	FILE 	*input_fd 	= NULL;
+	int 	i 			= 0;
 
-	if(argc != 3)
+	if(argc < 3)
 	{
-		fprintf(stderr, "Program is run with ./life3d [name-of-input-file] [number-of-iterations]\n");
+		fprintf(stderr, "Program is run with ./life3d [name-of-input-file] [number-of-iterations] [--rule B../S..] [--binary] [--parallel-output]\n");
 		exit(-1);
 	}
 
+	(*binary) = 0;
+	(*parallel) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if(strcmp(argv[i], "--parallel-output") == 0)
+		{
+			(*parallel) = 1;
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			(*rule) = read_rule(argv[++i]);
+			/* Only the cells next to alive ones are ever looked at, so none can be born without neighbors */
+			if(RULE_NEXT((*rule), DEAD, 0))
+			{
+				fprintf(stderr, "Rules with B0 are only supported by life3d-dense\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
 	(*input_filename) = argv[1];
 	input_fd = fopen((*input_filename), "r");
 	if(input_fd == NULL)
@@ -477,97 +1290,474 @@ void read_arguments(int argc, char *argv[], char **input_filename, int *iteratio
 
 /************************************************** READ_COORDINATES **************************************************/
 /**
- * Reads the input file and stores the given cells in the cube
+ * Reads the input file and stores the given cells in the cube.
+ * Each thread parses a chunk of the file, aligned to the start of the lines, into a flat array.
+ * The fixed size keys of binary files are split evenly between the threads instead, while
+ * delta encoded keys can only be decoded in order so the first thread decodes all of them.
+ * The cells are then distributed by x with a counting sort, so that the planes of the cube are
+ * independent and each thread sorts the cells of its planes by y and z and builds their lists
+ * in order, appending each node at the tail and skipping the repeated cells
  *
+ * @param input 			Mapped input file
+ * @param pools 			Pools of nodes, one for each thread
  * @param cube 				Structure that contains the cells
- * @param input_filename 	Name of the input file
+ * @param weights 			Where to store the number of cells of each plane
  * @param size 				Size of the sides of the cube
  */
-void read_coordinates(FILE *input_fd, struct node ***cube)
+void read_coordinates(struct input *input, struct pool **pools, struct node ***cube, int *weights, int size)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	x 						= 0;
-	int 	y 						= 0;
-	int 	z 						= 0;
+	struct coordinates 	**chunks 		= NULL; 	/**< 	Cells parsed by each thread 						*/
+	struct coordinates 	*buffer 		= NULL; 	/**< 	Scratch space to sort the cells of each plane 		*/
+	struct coordinates 	*cells 			= NULL; 	/**< 	Cells distributed by x 								*/
+	size_t 				length 			= 0; 		/**< 	Number of bytes left to parse 						*/
+	int 				*chunk_counts 	= NULL; 	/**< 	Number of cells parsed by each thread 				*/
+	int 				*first 			= NULL; 	/**< 	Index of the first cell of each plane 				*/
+	int 				*offsets 		= NULL; 	/**< 	Where each thread stores the cells of each plane 	*/
+	int 				num_threads 	= 0; 		/**< 	Number of threads used by OpenMP 					*/
+	int 				total 			= 0; 		/**< 	Number of cells read 								*/
+
+	length = input->end - input->cursor;
+	num_threads = omp_get_max_threads();
+	chunks = (struct coordinates **) calloc(num_threads, sizeof(struct coordinates *));
+	chunk_counts = (int *) calloc(num_threads, sizeof(int));
+	first = (int *) calloc(size + 1, sizeof(int));
+	offsets = (int *) calloc((size_t) num_threads * size, sizeof(int));
+	alloc_check(chunks);
+	alloc_check(chunk_counts);
+	alloc_check(first);
+	alloc_check(offsets);
 
-	while(fgets(buffer, BUFFER_SIZE, input_fd) != NULL)
+	#pragma omp parallel num_threads(num_threads)
 	{
-		if((sscanf(buffer,"%d %d %d", &x, &y, &z)) != 3)
+		struct coordinates 	*chunk 			= NULL;
+		struct input 		part;
+		struct node 		**tail 			= NULL;
+		struct pool 		*pool 			= pools[omp_get_thread_num()];
+		char 				*end 			= NULL;
+		char 				*next 			= NULL;
+		char 				*ptr 			= NULL;
+		int 				*counts 		= NULL;
+		int 				coordinates[3] 	= {0};
+		int 				count 			= 0;
+		int 				i 				= 0;
+		int 				thread 			= omp_get_thread_num();
+		int 				x 				= 0;
+		uint64_t 			first_cell 		= 0;
+		uint64_t 			last_cell 		= 0;
+
+		if(input->binary)
 		{
-			fprintf(stderr, "Input file does not match specifications\n");
-			exit(-1);
+			part = (*input);
+			first_cell = input->count * thread / num_threads;
+			last_cell = input->count * (thread + 1) / num_threads;
+			if(input->flags & BINARY_DELTA)
+			{
+				first_cell = 0;
+				last_cell = (thread == 0) ? input->count : 0;
+			}
+			part.cursor += 8 * first_cell;
+			ptr = end = input->end;
+			chunk = (struct coordinates *) malloc((last_cell - first_cell + 1) * sizeof(struct coordinates));
+			alloc_check(chunk);
+			for(; first_cell < last_cell; first_cell++)
+			{
+				binary_read_cell(&part, coordinates, size);
+				chunk[count].x = coordinates[0];
+				chunk[count].y = coordinates[1];
+				chunk[count].z = coordinates[2];
+				count++;
+			}
+		}
+		else
+		{
+			/* Parse the chunk of the file of this thread, every line takes at least 6 bytes */
+			ptr = input_align(input, input->cursor + length * thread / num_threads);
+			end = input_align(input, input->cursor + length * (thread + 1) / num_threads);
+			chunk = (struct coordinates *) malloc(((end - ptr) / 6 + 1) * sizeof(struct coordinates));
+			alloc_check(chunk);
+			while(ptr < end)
+			{
+				next = input_scan(ptr, input->end, coordinates, 3);
+				if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
+				{
+					input_error(input, ptr);
+				}
+				chunk[count].x = coordinates[0];
+				chunk[count].y = coordinates[1];
+				chunk[count].z = coordinates[2];
+				count++;
+				ptr = next;
+			}
+		}
+		chunks[thread] = chunk;
+		chunk_counts[thread] = count;
+
+		/* Count the cells of this thread in each plane */
+		counts = &(offsets[(size_t) thread * size]);
+		for(i = 0; i < count; i++)
+		{
+			counts[chunk[i].x]++;
+		}
+		#pragma omp barrier
+
+		/* Turn the counters into the position where each thread stores its first cell of each plane */
+		#pragma omp single
+		{
+			for(x = 0; x < size; x++)
+			{
+				first[x] = total;
+				for(i = 0; i < num_threads; i++)
+				{
+					count = offsets[(size_t) i * size + x];
+					offsets[(size_t) i * size + x] = total;
+					total += count;
+				}
+				weights[x] = total - first[x];
+			}
+			first[size] = total;
+			cells = (struct coordinates *) malloc((total + 1) * sizeof(struct coordinates));
+			buffer = (struct coordinates *) malloc((total + 1) * sizeof(struct coordinates));
+			alloc_check(cells);
+			alloc_check(buffer);
+		}
+
+		/* Distribute the cells of this thread by x */
+		for(i = 0; i < chunk_counts[thread]; i++)
+		{
+			cells[counts[chunk[i].x]++] = chunk[i];
+		}
+		free(chunk);
+		#pragma omp barrier
+
+		/* Sort the cells of each plane by y and z and build its columns */
+		counts = (int *) malloc(size * sizeof(int));
+		alloc_check(counts);
+		#pragma omp for schedule(dynamic)
+		for(x = 0; x < size; x++)
+		{
+			count = first[x + 1] - first[x];
+			if(count == 0)
+			{
+				continue;
+			}
+			coordinates_sort_pass(&(cells[first[x]]), &(buffer[first[x]]), counts, count, size, 2);
+			coordinates_sort_pass(&(buffer[first[x]]), &(cells[first[x]]), counts, count, size, 1);
+			for(i = first[x]; i < first[x + 1]; i++)
+			{
+				/* A new column starts whenever y changes */
+				if((i == first[x]) || (cells[i].y != cells[i-1].y))
+				{
+					tail = &(cube[x][cells[i].y]);
+				}
+				/* Ignore repeated cells */
+				else if(cells[i].z == cells[i-1].z)
+				{
+					continue;
+				}
+				(*tail) = node_create(pool, ALIVE, cells[i].z);
+				tail = &((*tail)->next);
+			}
+		}
+		free(counts);
+	}
+	input->cursor = input->end;
+
+	free(chunks);
+	free(chunk_counts);
+	free(first);
+	free(offsets);
+	free(cells);
+	free(buffer);
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
+{
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
+
+	if((*ptr) == 'B')
+	{
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+		{
+			rule |= 1 << ((*ptr) - '0');
+		}
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
+		{
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
 		}
-		node_add(&(cube[x][y]), NEW, ALIVE, z);
 	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
 }
 
 /************************************************** READ_SIZE **************************************************/
 /**
  * Reads the input file and returns the declared size of the sides of the cube
  *
- * @param input_fd 			File descriptor for the input file
+ * @param input 			Mapped input file
  * @return size 			Size of the sides of the cube
  */
-int read_size(FILE *input_fd)
+int read_size(struct input *input)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	size 					= 0;
+	char 	*next 	= NULL;
+	int 	size 	= 0;
 
-	fgets(buffer, BUFFER_SIZE, input_fd);
-	if((sscanf(buffer, "%d", &size)) != 1)
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
 	{
-		fprintf(stderr, "Input file does not match specifications\n");
-		exit(-1);
+		return binary_read_header(input);
 	}
 
+	next = input_scan(input->cursor, input->end, &size, 1);
+	if(next == NULL)
+	{
+		input_error(input, input->cursor);
+	}
+	input->cursor = next;
+
 	return size;
 }
 
+/************************************************** SCHEDULE_BALANCE **************************************************/
+/**
+ * Splits the cube into bands with about the same weight, from the prefix sums of the weights of the planes.
+ * Every band keeps at least 2 planes, which mark_neighbors needs to process the bands of each color at once
+ *
+ * @param schedule 	Bands of the cube
+ * @param size 		Size of the sides of the cube
+ */
+void schedule_balance(struct schedule *schedule, int size)
+{
+	long 	sum 	= 0; 		/**< 	Weight of the planes before x 			*/
+	long 	total 	= 0; 		/**< 	Weight of the whole cube 				*/
+	int 	band 	= 0; 		/**< 	Index of the band 						*/
+	int 	first 	= 0; 		/**< 	Smallest first plane of the band 		*/
+	int 	last 	= 0; 		/**< 	Largest first plane of the band 		*/
+	int 	x 		= 0; 		/**< 	x-Coordinate 							*/
+
+	/* Visiting the columns of a plane also takes time, even when they are empty */
+	for(x = 0; x < size; x++)
+	{
+		total += schedule->weights[x] + (size / COLUMN_WEIGHT);
+	}
+
+	x = 0;
+	schedule->bounds[0] = 0;
+	for(band = 1; band < schedule->count; band++)
+	{
+		/* Leave room for at least 2 planes in this band and in each of the bands after it */
+		first = schedule->bounds[band - 1] + 2;
+		last = size - 2 * (schedule->count - band);
+		while((x < last) && ((x < first) || (sum < total * band / schedule->count)))
+		{
+			sum += schedule->weights[x] + (size / COLUMN_WEIGHT);
+			x++;
+		}
+		schedule->bounds[band] = x;
+	}
+	schedule->bounds[schedule->count] = size;
+}
+
+/************************************************** SCHEDULE_CREATE **************************************************/
+/**
+ * Creates the bands of the cube for the number of threads used by OpenMP and returns them
+ *
+ * @param size 		Size of the sides of the cube
+ * @return 			Bands of the cube
+ */
+struct schedule * schedule_create(int size)
+{
+	struct schedule 	*schedule 	= NULL; 	/**< 	Bands of the cube 	*/
+
+	schedule = (struct schedule *) malloc(sizeof(struct schedule));
+	alloc_check(schedule);
+
+	/* The number of bands must be even so that the first and the last bands, which are also neighbors, have different colors */
+	schedule->count = 2 * BANDS_PER_THREAD * omp_get_max_threads();
+	if(schedule->count > size / 2)
+	{
+		schedule->count = (size / 4) * 2;
+	}
+	/* Cubes with less than 4 planes are processed as a single band */
+	if(schedule->count < 2)
+	{
+		schedule->count = 1;
+	}
+
+	schedule->bounds = (int *) calloc(schedule->count + 1, sizeof(int));
+	schedule->weights = (int *) calloc(size, sizeof(int));
+	schedule->busy = (double *) calloc(omp_get_max_threads(), sizeof(double));
+	schedule->tokens = (char *) calloc(schedule->count, sizeof(char));
+	alloc_check(schedule->tokens);
+	alloc_check(schedule->bounds);
+	alloc_check(schedule->weights);
+	alloc_check(schedule->busy);
+
+	return schedule;
+}
+
+/************************************************** SCHEDULE_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for the bands of the cube
+ *
+ * @param schedule 	Bands of the cube
+ */
+void schedule_destroy(struct schedule *schedule)
+{
+	free(schedule->bounds);
+	free(schedule->weights);
+	free(schedule->busy);
+	free(schedule->tokens);
+	free(schedule);
+}
+
+#ifdef PROFILE
+/************************************************** THREAD_TIME **************************************************/
+/**
+ * Returns the processor time used by the calling thread, which unlike the wall clock
+ * does not count the time the thread waits at a barrier or for a core
+ *
+ * @return 			Processor time of the thread in seconds
+ */
+double thread_time(void)
+{
+	struct timespec 	now; 	/**< 	Processor time of the thread 	*/
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+#endif
+
 /************************************************** MAIN **************************************************/
 int main(int argc, char *argv[])
 {
-	FILE 			*input_fd 			= NULL; 	/**< 	File descriptor for the input file 			*/
-	omp_lock_t 		**locks 			= NULL; 	/**< 	OpenMP locks, one for each [x][y] pair 		*/
 	struct node 	***cube 			= NULL; 	/**< 	Structure that contains the cells 			*/
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer for stdout 					*/
+	struct pool 	**pools 			= NULL; 	/**< 	Pools of nodes, one for each thread 		*/
+	struct schedule *schedule 			= NULL; 	/**< 	Bands of the cube given to the threads 		*/
+	char 			*tokens 			= NULL; 	/**< 	Dependences of the tasks of each band 		*/
+	int 			band 				= 0; 		/**< 	Index of the band 							*/
+	int 			count 				= 0; 		/**< 	Number of bands 							*/
+	int 			generation 			= 0; 		/**< 	Generation being computed 					*/
+	int 			num_threads 		= 0; 		/**< 	Number of threads used by OpenMP 			*/
+	int 			i 					= 0; 		/**< 	Index of the thread 						*/
 	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	int 			binary 				= 0; 		/**< 	Whether to print in the binary format 		*/
 	int 			iterations 			= 0; 		/**< 	Number of iterations to run the problem 	*/
+	int 			parallel 			= 0; 		/**< 	Whether the threads write the output at once 	*/
+	int 			rule 				= 0; 		/**< 	Lookup table of the rule 					*/
 	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
+#ifdef PROFILE
+	double 			busy 				= 0; 		/**< 	Time worked by the busiest thread 			*/
+	double 			total 				= 0; 		/**< 	Time worked by all the threads 				*/
+#endif
 
 	/* Read the arguments given to the program */
-	read_arguments(argc, argv, &input_filename, &iterations);
+	read_arguments(argc, argv, &input_filename, &iterations, &binary, &parallel, &rule);
 	/* Read the size of the problem */
-	input_fd = fopen(input_filename, "r");
-	size = read_size(input_fd);
+	input = input_map(input_filename);
+	size = read_size(input);
+	output = output_create(STDOUT_FILENO, binary, size, input->generation + iterations);
 	/* Create the data structure */
 	cube = cube_create(size);
-	/* Create the locks */
-	locks = locks_create(size);
+	/* Create a pool of nodes for each thread */
+	num_threads = omp_get_max_threads();
+	pools = (struct pool **) calloc(num_threads, sizeof(struct pool *));
+	alloc_check(pools);
+	for(i = 0; i < num_threads; i++)
+	{
+		pools[i] = pool_create();
+	}
 	/* Reads the input file and stores the given cells in the cube */
-	read_coordinates(input_fd, cube);
-	fclose(input_fd);
+	schedule = schedule_create(size);
+	read_coordinates(input, pools, cube, schedule->weights, size);
+	input_unmap(input);
+	schedule_balance(schedule, size);
 
-	/* Process the given problem */
+	/* Process the given problem as a pipeline of tasks, one to mark and one to determine each band in each generation.
+	 * Marking a band touches the bands next to it, so the even bands are marked before the odd ones, and a band is
+	 * determined as soon as it and its neighbors are marked. The marking of the next generation waits for the bands
+	 * whose lists it touches to be determined, so early bands can start a generation while later ones finish the last */
+	tokens = schedule->tokens;
+	count = schedule->count;
 	#pragma omp parallel
+	#pragma omp single
 	{
-		while(iterations > 0)
+		for(generation = 1; generation <= iterations; generation++)
 		{
 			/* Mark the neighbors of the currently alive cells */
-			mark_neighbors(locks, cube, size);
-			/* Go over all the cells and check which ones are alive in the next generation */
-			determine_next_generation(cube, size);
-			/* Go over all the cells and remove the dead ones */
-			cube_purge(cube, size);
-			/* Make sure that only one of the threads decreases the number of iterations */
-			#pragma omp single
-			iterations--;
+			for(band = 0; band < count; band += 2)
+			{
+				#pragma omp task firstprivate(band) depend(out: tokens[band])
+				mark_neighbors(pools, cube, schedule, band, size);
+			}
+			for(band = 1; band < count; band += 2)
+			{
+				#pragma omp task firstprivate(band) depend(in: tokens[band - 1], tokens[(band + 1) % count]) depend(out: tokens[band])
+				mark_neighbors(pools, cube, schedule, band, size);
+			}
+			/* Go over all the cells, check which ones are alive in the next generation and remove the dead ones */
+			for(band = 0; band < count; band++)
+			{
+				#pragma omp task firstprivate(band) depend(in: tokens[(band + count - 1) % count], tokens[band], tokens[(band + 1) % count])
+				determine_next_generation(pools, cube, schedule, band, size, rule);
+			}
+			/* Balancing the bands moves their bounds, so every task must be done first */
+			if((generation % BALANCE_INTERVAL == 0) && (generation < iterations))
+			{
+				#pragma omp taskwait
+				schedule_balance(schedule, size);
+			}
 		}
 	}
 
+#ifdef PROFILE
+	/* Report how long each thread worked, the imbalance is the busiest thread over the average */
+	busy = 0;
+	total = 0;
+	for(i = 0; i < num_threads; i++)
+	{
+		fprintf(stderr, "Thread %d busy for %.3fs\n", i, schedule->busy[i]);
+		busy = (schedule->busy[i] > busy) ? schedule->busy[i] : busy;
+		total += schedule->busy[i];
+	}
+	fprintf(stderr, "Imbalance %.2f\n", (total > 0) ? busy * num_threads / total : 1.0);
+#endif
+
 	/* Print the solution to stdout */
-	cube_print(cube, size);
+	cube_print(output, cube, size, parallel);
+	output_destroy(output);
 	/* Destroy the data structures */
-	cube_destroy(cube, size);
-	locks_destroy(locks, size);
+	cube_destroy(cube);
+	schedule_destroy(schedule);
+	for(i = 0; i < num_threads; i++)
+	{
+		pool_destroy(pools[i]);
+	}
+	free(pools);
 
 	return 0;
 }
\ No newline at end of file
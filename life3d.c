@@ -12,35 +12,146 @@
  * \date 		27/04/2017
  */
 /************************************************** INCLUDE **************************************************/
+/* madvise and the POSIX calls are not declared by the headers in strict ISO C modes */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /************************************************** DEFINE **************************************************/
 /************************************************** CONSTANTS **************************************************/
 #define ALIVE 				1		/** \def 	Macro to differentiate alive from dead cells 	*/
-#define BUFFER_SIZE			200		/** \def 	Size of the file reading buffer 				*/
+#define BINARY_DELTA 		1		/** \def 	Flag of the binary files with delta encoded keys */
+#define BINARY_HEADER_SIZE 	32		/** \def 	Size of the header of the binary files 			*/
+#define BINARY_MAGIC 		"L3DB"	/** \def 	First bytes of the binary files 				*/
+#define BINARY_MAX_SIZE 	(1 << 21)	/** \def 	Largest size whose keys fit in 64 bits 		*/
+#define BINARY_VERSION 		1		/** \def 	Version of the binary format 					*/
 #define DEAD 				0		/** \def 	Macro to differentiate alive from dead cells 	*/
+#define ENGINE_ARRAY 		1		/** \def 	Engine that stores each column in sorted arrays */
+#define ENGINE_LIST 		0		/** \def 	Engine that stores each column in a linked list */
 #define NEIGHBOR 			1		/** \def 	Macro to differentiate neighbor from new cells 	*/
-#define NEW 				0		/** \def 	Macro to differentiate neighbor from new cells 	*/
+#define OUTPUT_BUFFER_SIZE	65536	/** \def 	Size of the output buffer 						*/
+#define OUTPUT_LINE_SIZE 	36		/** \def 	Longest line of the output 						*/
+#define POOL_SLAB_SIZE		4096	/** \def 	Number of nodes allocated at once by the pool 	*/
+#define RULE_DEFAULT 		0x1c0c	/** \def 	Lookup table of the rule B23/S234 				*/
 
 /************************************************** OPERATORS **************************************************/
+#define COORDINATE(cell, axis) 	(((axis) == 0) ? (cell).x : (((axis) == 1) ? (cell).y : (cell).z))
 #define MOD(a, b) 			(((a) < 0) ? ((a) % (b) + (b)) : ((a) % (b)))
+#define RULE_NEXT(rule, alive, count) 	(((rule) >> (((alive) << 3) | (count))) & 1)
 
 /************************************************** PROTOTYPES **************************************************/
+struct 				column;
+struct 				coordinates;
+struct 				input;
 struct 				node;
+struct 				output;
+struct 				pool;
+struct 				slab;
+struct 				worklist;
 void 				alloc_check 				(void *ptr);
+void 				binary_error 				(struct input *input);
+uint64_t 			binary_get 					(unsigned char *ptr, int bytes);
+void 				binary_put 					(unsigned char *ptr, uint64_t value, int bytes);
+void 				binary_read_cell 			(struct input *input, int *coordinates, int size);
+int 				binary_read_header 			(struct input *input);
+int 				binary_split 				(uint64_t key, int *coordinates, int size);
+void 				column_merge 				(struct column *column, struct column *scratch, short *list, int length);
+void 				column_reserve 				(struct column *column, int capacity);
+struct column ** 	columns_create 				(int size);
+void 				columns_destroy 			(struct column **columns, int size);
+void 				columns_determine_next_generation 	(struct column **columns, int size, int rule);
+void 				columns_mark_neighbors 		(struct column **columns, struct column *scratch, short *list, int size);
+uint64_t 			columns_count 				(struct column **columns, int size);
+void 				columns_print 				(struct output *output, struct column **columns, int size);
+void 				columns_purge 				(struct column **columns, int size);
+void 				columns_read_coordinates 	(struct input *input, struct column **columns, int size);
+struct coordinates * 	coordinates_read 		(struct input *input, int *count, int size);
+void 				coordinates_sort 			(struct coordinates *cells, struct coordinates *buffer, int count, int size);
+void 				coordinates_sort_pass 		(struct coordinates *source, struct coordinates *destination, int *counts, int count, int size, int axis);
 struct node *** 	cube_create 				(int size);
-void 				cube_destroy 				(struct node ***cube, int size);
-void 				cube_print 					(struct node ***cube, int size);
-void 				cube_purge 					(struct node ***cube, int size);
-void 				determine_next_generation 	(struct node ***cube, int size);
-void 				mark_neighbors 				(struct node ***cube, int size);
-void 				node_add 					(struct node **head, short mode, short status, int z);
-struct node * 		node_create 				(short status, int z);
-void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations);
-void 				read_coordinates 			(FILE *input_fd, struct node ***cube);
-int 				read_size 					(FILE *input_fd);
+void 				cube_destroy 				(struct node ***cube);
+uint64_t 			cube_count 					(struct node ***cube, int size);
+void 				cube_print 					(struct output *output, struct node ***cube, int size);
+void 				cube_purge 					(struct pool *pool, struct node ***cube, struct worklist *worklist, int size);
+void 				determine_next_generation 	(struct node ***cube, struct worklist *worklist, int size, int rule);
+void 				input_error 				(struct input *input, char *ptr);
+struct input * 		input_map 					(char *input_filename);
+char * 				input_scan 					(char *ptr, char *end, int *values, int count);
+void 				input_unmap 				(struct input *input);
+void 				mark_neighbors 				(struct pool *pool, struct node ***cube, struct worklist *worklist, int size);
+struct node * 		node_create 				(struct pool *pool, short status, int z);
+void 				node_destroy 				(struct pool *pool, struct node *node);
+struct node ** 		node_mark 					(struct pool *pool, struct node **ptr, int z, int count);
+struct node * 		node_next_alive 			(struct node *node);
+void 				output_cell 				(struct output *output, int x, int y, int z);
+struct output * 	output_create 				(int fd, int binary, int size, uint64_t generation);
+void 				output_destroy 				(struct output *output);
+void 				output_flush 				(struct output *output);
+void 				output_header 				(struct output *output, uint64_t count);
+char * 				output_int 					(char *ptr, int value);
+void 				output_write 				(int fd, char *data, size_t length);
+struct pool * 		pool_create 				(void);
+void 				pool_destroy 				(struct pool *pool);
+void 				pool_grow 					(struct pool *pool);
+void 				read_arguments 				(int argc, char *argv[], char **input_filename, int *iterations, int *engine, int *binary, int *rule);
+void 				read_coordinates 			(struct input *input, struct pool *pool, struct node ***cube, int size);
+int 				read_rule 					(char *text);
+int 				read_size 					(struct input *input);
+struct worklist * 	worklist_create 			(struct node ***cube, int size);
+void 				worklist_destroy 			(struct worklist *worklist);
+void 				worklist_expand 			(struct worklist *worklist, int size);
+
+/************************************************** STRUCT COLUMN **************************************************/
+/** \struct
+ * Structure that represents all the cells with the same [x][y] coordinates
+ * used by the array engine. The cells are kept sorted by z in contiguous arrays
+ * so that marking the neighbors of a column becomes a merge of sorted arrays
+ */
+struct column
+{
+	short 			*alive_neighbors; 	/**<	Number of alive neighbors of each cell 						*/
+	char 			*status; 			/**<	Whether each cell is alive or dead 							*/
+	short 			*z; 				/**<	Sorted z-coordinates of the cells 							*/
+	int 			capacity; 			/**<	Number of cells the arrays have room for 					*/
+	int 			length; 			/**<	Number of cells in the column 								*/
+};
+
+/************************************************** STRUCT COORDINATES **************************************************/
+/** \struct
+ * Structure that represents the coordinates of a cell while the input file is loaded
+ */
+struct coordinates
+{
+	short 			x; 					/**<	x-coordinate of the cell 									*/
+	short 			y; 					/**<	y-coordinate of the cell 									*/
+	short 			z; 					/**<	z-coordinate of the cell 									*/
+};
+
+/************************************************** STRUCT INPUT **************************************************/
+/** \struct
+ * Structure that represents the input file mapped in memory, either in text or in the binary format.
+ * The parser walks the mapping directly instead of copying every line into a buffer
+ */
+struct input
+{
+	char 			*cursor; 			/**<	Start of the next line to parse 							*/
+	char 			*data; 				/**<	Contents of the file 										*/
+	char 			*end; 				/**<	End of the contents of the file 							*/
+	size_t 			length; 			/**<	Length of the file in bytes 								*/
+	uint64_t 		count; 				/**<	Number of cells of a binary file 							*/
+	uint64_t 		generation; 		/**<	Generation of the cells of a binary file 					*/
+	uint64_t 		key; 				/**<	Last key read from a binary file 							*/
+	int 			binary; 			/**<	Whether the file uses the binary format 					*/
+	int 			flags; 				/**<	Flags of the header of a binary file 						*/
+};
 
 /************************************************** STRUCT NODE **************************************************/
 /** \struct
@@ -56,6 +167,57 @@ struct node
 	struct node 	*next; 				/**< 	Pointer to another cell with the same [x][y] coordinates 	*/
 };
 
+/************************************************** STRUCT OUTPUT **************************************************/
+/** \struct
+ * Structure that buffers the formatted output so that it is written
+ * to the file descriptor in large blocks instead of one line at a time
+ */
+struct output
+{
+	char 			*buffer; 			/**<	Formatted text not written yet 								*/
+	size_t 			capacity; 			/**<	Size of the buffer 											*/
+	size_t 			length; 			/**<	Number of bytes in the buffer 								*/
+	int 			fd; 				/**<	File descriptor where the text is written 					*/
+	uint64_t 		generation; 		/**<	Generation written in the header of the binary format 		*/
+	int 			binary; 			/**<	Whether the output uses the binary format 					*/
+	int 			size; 				/**<	Size of the sides of the cube 								*/
+};
+
+/************************************************** STRUCT POOL **************************************************/
+/** \struct
+ * Structure that recycles the nodes removed from the cube.
+ * Dead cells are kept in a free list instead of being handed back to the
+ * allocator so that, once the population stabilizes, no generation touches the heap
+ */
+struct pool
+{
+	struct node 	*free_list; 		/**<	Nodes available to be reused 								*/
+	struct slab 	*slabs; 			/**<	Blocks of memory owned by the pool 							*/
+};
+
+/************************************************** STRUCT SLAB **************************************************/
+/** \struct
+ * Structure that represents a block of nodes allocated at once by the pool
+ */
+struct slab
+{
+	struct node 	nodes[POOL_SLAB_SIZE]; 	/**<	Nodes of this block 									*/
+	struct slab 	*next; 					/**<	Pointer to the previously allocated block 				*/
+};
+
+/************************************************** STRUCT WORKLIST **************************************************/
+/** \struct
+ * Structure that keeps the columns of the cube with alive cells, so that a generation only goes over them
+ * and the columns next to them instead of the whole size by size grid
+ */
+struct worklist
+{
+	int 			*columns; 			/**<	Columns to go over, as x * size + y 						*/
+	int 			*stamps; 			/**<	Generation in which each column was last added 				*/
+	int 			count; 				/**<	Number of columns in the list 								*/
+	int 			stamp; 				/**<	Current generation 											*/
+};
+
 /************************************************** ALLOC_CHECK **************************************************/
 /**
  * Checks if a given memory allocation was successful
@@ -66,292 +228,1432 @@ void alloc_check(void *ptr)
 {
 	if(ptr == NULL)
 	{
-		fprintf(stderr, "Error with memory allocation\n");
-		abort();
+		fprintf(stderr, "Error with memory allocation\n");
+		abort();
+	}
+}
+
+/************************************************** BINARY_ERROR **************************************************/
+/**
+ * Reports a binary input file that does not match the specifications and exits
+ *
+ * @param input 			Mapped input file
+ */
+void binary_error(struct input *input)
+{
+	fprintf(stderr, "Input file does not match specifications (byte %ld)\n", (long) (input->cursor - input->data));
+	exit(-1);
+}
+
+/************************************************** BINARY_GET **************************************************/
+/**
+ * Reads a little endian unsigned integer of the given number of bytes
+ *
+ * @param ptr 		Bytes of the integer
+ * @param bytes 	Number of bytes of the integer
+ * @return 			Integer
+ */
+uint64_t binary_get(unsigned char *ptr, int bytes)
+{
+	uint64_t 	value 	= 0; 		/**< 	Integer read 		*/
+	int 		i 		= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = bytes - 1; i >= 0; i--)
+	{
+		value = (value << 8) | ptr[i];
+	}
+
+	return value;
+}
+
+/************************************************** BINARY_PUT **************************************************/
+/**
+ * Writes a little endian unsigned integer with the given number of bytes
+ *
+ * @param ptr 		Where to write the integer
+ * @param value 	Integer to write
+ * @param bytes 	Number of bytes of the integer
+ */
+void binary_put(unsigned char *ptr, uint64_t value, int bytes)
+{
+	int 	i 	= 0; 		/**< 	Index of the byte 	*/
+
+	for(i = 0; i < bytes; i++)
+	{
+		ptr[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/************************************************** BINARY_READ_CELL **************************************************/
+/**
+ * Reads the next cell of a binary input file, either a fixed 8 byte key
+ * or a varint with the difference to the previous key
+ *
+ * @param input 			Mapped input file
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ */
+void binary_read_cell(struct input *input, int *coordinates, int size)
+{
+	unsigned char 	*end 	= (unsigned char *) input->end; 	/**< 	End of the file 					*/
+	unsigned char 	*ptr 	= (unsigned char *) input->cursor; 	/**< 	Next byte to read 					*/
+	uint64_t 		delta 	= 0; 								/**< 	Difference to the previous key 		*/
+	int 			shift 	= 0; 								/**< 	Position of the next 7 bits 		*/
+
+	if(input->flags & BINARY_DELTA)
+	{
+		do
+		{
+			if((ptr == end) || (shift > 63))
+			{
+				binary_error(input);
+			}
+			delta |= ((uint64_t) ((*ptr) & 0x7f)) << shift;
+			shift += 7;
+		} while((*(ptr++)) & 0x80);
+		input->key += delta;
+	}
+	else
+	{
+		if(end - ptr < 8)
+		{
+			binary_error(input);
+		}
+		input->key = binary_get(ptr, 8);
+		ptr += 8;
+	}
+
+	input->cursor = (char *) ptr;
+	if(binary_split(input->key, coordinates, size) == 0)
+	{
+		binary_error(input);
+	}
+}
+
+/************************************************** BINARY_READ_HEADER **************************************************/
+/**
+ * Reads the header of a binary input file and returns the size of the sides of the cube
+ *
+ * @param input 			Mapped input file
+ * @return 					Size of the sides of the cube
+ */
+int binary_read_header(struct input *input)
+{
+	unsigned char 	*header 	= (unsigned char *) input->data; 	/**< 	Header of the file 					*/
+	size_t 			room 		= 0; 								/**< 	Bytes after the header 				*/
+	uint64_t 		size 		= 0; 								/**< 	Size of the sides of the cube 		*/
+
+	if(binary_get(&header[4], 4) != BINARY_VERSION)
+	{
+		fprintf(stderr, "Unsupported version %d of the binary format\n", (int) binary_get(&header[4], 4));
+		exit(-1);
+	}
+	input->binary = 1;
+	input->flags = binary_get(&header[8], 4);
+	size = binary_get(&header[12], 4);
+	input->generation = binary_get(&header[16], 8);
+	input->count = binary_get(&header[24], 8);
+	input->key = 0;
+	input->cursor = input->data + BINARY_HEADER_SIZE;
+
+	/* Every cell takes at least 1 byte with the delta encoding and exactly 8 bytes without it */
+	room = input->length - BINARY_HEADER_SIZE;
+	if((size == 0) || (size > BINARY_MAX_SIZE) || (input->count > ((input->flags & BINARY_DELTA) ? room : room / 8)))
+	{
+		binary_error(input);
+	}
+
+	return (int) size;
+}
+
+/************************************************** BINARY_SPLIT **************************************************/
+/**
+ * Splits the key of a cell into its coordinates
+ *
+ * @param key 				Key of the cell, ((x * size) + y) * size + z
+ * @param coordinates 		Where to store the coordinates of the cell
+ * @param size 				Size of the sides of the cube
+ * @return 					Whether the key is inside the cube
+ */
+int binary_split(uint64_t key, int *coordinates, int size)
+{
+	coordinates[2] = key % size;
+	key /= size;
+	coordinates[1] = key % size;
+	key /= size;
+	coordinates[0] = (int) key;
+
+	return key < (uint64_t) size;
+}
+
+/************************************************** COLUMN_MERGE **************************************************/
+/**
+ * Merges a sorted list of z-coordinates of alive neighbors into a column,
+ * incrementing the neighbor count of the cells that already exist and
+ * adding dead cells for the ones that do not
+ *
+ * @param column 	Column that receives the neighbors
+ * @param scratch 	Column used as temporary storage for the merge
+ * @param list 		Sorted z-coordinates of the alive neighbors
+ * @param length 	Length of the list
+ */
+void column_merge(struct column *column, struct column *scratch, short *list, int length)
+{
+	int 	i 		= 0; 		/**< 	Index in the column 	*/
+	int 	j 		= 0; 		/**< 	Index in the list 		*/
+	int 	k 		= 0; 		/**< 	Index in the scratch 	*/
+
+	if(length == 0)
+	{
+		return;
+	}
+
+	while((i < column->length) || (j < length))
+	{
+		/* The cell exists and one of its neighbors is alive */
+		if((i < column->length) && (j < length) && (column->z[i] == list[j]))
+		{
+			scratch->z[k] = column->z[i];
+			scratch->alive_neighbors[k] = column->alive_neighbors[i] + NEIGHBOR;
+			scratch->status[k] = column->status[i];
+			i++;
+			j++;
+		}
+		/* The cell exists and it is not a neighbor of any cell in the list */
+		else if((j == length) || ((i < column->length) && (column->z[i] < list[j])))
+		{
+			scratch->z[k] = column->z[i];
+			scratch->alive_neighbors[k] = column->alive_neighbors[i];
+			scratch->status[k] = column->status[i];
+			i++;
+		}
+		/* The cell does not exist yet */
+		else
+		{
+			scratch->z[k] = list[j];
+			scratch->alive_neighbors[k] = NEIGHBOR;
+			scratch->status[k] = DEAD;
+			j++;
+		}
+		k++;
+	}
+
+	column_reserve(column, k);
+	memcpy(column->z, scratch->z, k * sizeof(short));
+	memcpy(column->alive_neighbors, scratch->alive_neighbors, k * sizeof(short));
+	memcpy(column->status, scratch->status, k * sizeof(char));
+	column->length = k;
+}
+
+/************************************************** COLUMN_RESERVE **************************************************/
+/**
+ * Guarantees that a column has room for at least the given number of cells.
+ * The capacity is doubled so that the columns stop growing after a few generations
+ *
+ * @param column 	Column
+ * @param capacity 	Number of cells the column must be able to hold
+ */
+void column_reserve(struct column *column, int capacity)
+{
+	if(column->capacity >= capacity)
+	{
+		return;
+	}
+
+	if(column->capacity * 2 > capacity)
+	{
+		capacity = column->capacity * 2;
+	}
+	column->z = (short *) realloc(column->z, capacity * sizeof(short));
+	column->alive_neighbors = (short *) realloc(column->alive_neighbors, capacity * sizeof(short));
+	column->status = (char *) realloc(column->status, capacity * sizeof(char));
+	alloc_check(column->z);
+	alloc_check(column->alive_neighbors);
+	alloc_check(column->status);
+	column->capacity = capacity;
+}
+
+/************************************************** COLUMNS_COUNT **************************************************/
+/**
+ * Counts the alive cells of the columns
+ *
+ * @param columns 	Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ * @return 			Number of alive cells
+ */
+uint64_t columns_count(struct column **columns, int size)
+{
+	struct column 	*column 	= NULL; 	/**< 	Column being counted 	*/
+	uint64_t 		count 		= 0; 		/**< 	Number of alive cells 	*/
+	int 			i 			= 0; 		/**< 	Index in the column 	*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 			*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 			*/
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &columns[x][y];
+			for(i = 0; i < column->length; i++)
+			{
+				count += (column->status[i] == ALIVE);
+			}
+		}
+	}
+
+	return count;
+}
+
+/************************************************** COLUMNS_CREATE **************************************************/
+/**
+ * Creates a 2D size by size matrix of empty columns and returns it
+ *
+ * @param size 		Size of the sides of the cube
+ * @return 			Columns
+ */
+struct column ** columns_create(int size)
+{
+	struct column 	**columns 		= NULL;
+	struct column 	*columns_mem 	= NULL;
+	int 			x 				= 0;
+
+	columns = (struct column **) calloc(size, sizeof(struct column *));
+	columns_mem = (struct column *) calloc(size * size, sizeof(struct column));
+	alloc_check(columns);
+	alloc_check(columns_mem);
+
+	for(x = 0; x < size; x++)
+	{
+		columns[x] = &columns_mem[size * x];
+	}
+
+	return columns;
+}
+
+/************************************************** COLUMNS_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for the columns
+ *
+ * @param columns 	Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ */
+void columns_destroy(struct column **columns, int size)
+{
+	int 	x 		= 0; 		/**< 	x-Coordinate 		*/
+	int 	y 		= 0; 		/**< 	y-Coordinate 		*/
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			free(columns[x][y].z);
+			free(columns[x][y].alive_neighbors);
+			free(columns[x][y].status);
+		}
+	}
+	free(columns[0]);
+	free(columns);
+}
+
+/************************************************** COLUMNS_DETERMINE_NEXT_GENERATION **************************************************/
+/**
+ * Iterates through all the cells in the columns and determines whether
+ * they live or die in the next generation
+ *
+ * @param columns 	Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ * @param rule 		Lookup table of the rule
+ */
+void columns_determine_next_generation(struct column **columns, int size, int rule)
+{
+	struct column 	*column 	= NULL; 	/**< 	Column being processed 		*/
+	int 			i 			= 0; 		/**< 	Index in the column 		*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 				*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 				*/
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &columns[x][y];
+			for(i = 0; i < column->length; i++)
+			{
+				/* The rule gives the next state from the current one and the number of neighbors, without branches */
+				column->status[i] = RULE_NEXT(rule, column->status[i], column->alive_neighbors[i]);
+				/* Reset the number of neighbors of all processed cells */
+				column->alive_neighbors[i] = 0;
+			}
+		}
+	}
+}
+
+/************************************************** COLUMNS_MARK_NEIGHBORS **************************************************/
+/**
+ * Increments the alive neighbors count of all the neighbors of all
+ * alive cells in the current generation. The alive cells of each column
+ * are merged at once into each of the neighboring columns
+ *
+ * @param columns 	Structure that contains the cells
+ * @param scratch 	Column used as temporary storage for the merges
+ * @param list 		Buffer with room for 2*size z-coordinates
+ * @param size 		Size of the sides of the cube
+ */
+void columns_mark_neighbors(struct column **columns, struct column *scratch, short *list, int size)
+{
+	struct column 	*column 	= NULL; 	/**< 	Column being processed 						*/
+	short 			*shifted 	= NULL; 	/**< 	Alive z-coordinates shifted by one in z 	*/
+	int 			i 			= 0; 		/**< 	Index in the column 						*/
+	int 			j 			= 0; 		/**< 	Index in the shifted list 					*/
+	int 			length 		= 0; 		/**< 	Number of alive cells in the column 		*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 								*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 								*/
+
+	shifted = &list[size];
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &columns[x][y];
+			/* Gather the alive cells of the column, ignoring the neighbors already added to it */
+			length = 0;
+			for(i = 0; i < column->length; i++)
+			{
+				if(column->status[i] == ALIVE)
+				{
+					list[length++] = column->z[i];
+				}
+			}
+			if(length == 0)
+			{
+				continue;
+			}
+
+			/* The neighbors in x and y share the z-coordinates of the alive cells */
+			column_merge(&columns[MOD((x+1), size)][y], scratch, list, length);
+			column_merge(&columns[MOD((x-1), size)][y], scratch, list, length);
+			column_merge(&columns[x][MOD((y+1), size)], scratch, list, length);
+			column_merge(&columns[x][MOD((y-1), size)], scratch, list, length);
+
+			/* The neighbors in z+1 are still sorted once the cell at size-1 wraps around to the front */
+			j = 0;
+			if(list[length - 1] == (size - 1))
+			{
+				shifted[j++] = 0;
+			}
+			for(i = 0; (i < length) && (list[i] != (size - 1)); i++)
+			{
+				shifted[j++] = list[i] + 1;
+			}
+			column_merge(column, scratch, shifted, length);
+
+			/* Likewise for the neighbors in z-1 once the cell at 0 wraps around to the back */
+			j = 0;
+			for(i = ((list[0] == 0) ? 1 : 0); i < length; i++)
+			{
+				shifted[j++] = list[i] - 1;
+			}
+			if(list[0] == 0)
+			{
+				shifted[j++] = size - 1;
+			}
+			column_merge(column, scratch, shifted, length);
+		}
+	}
+}
+
+/************************************************** COLUMNS_PRINT **************************************************/
+/**
+ * Prints the solution of the problem to the given output
+ *
+ * @param output 	Output buffer
+ * @param columns 	Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ */
+void columns_print(struct output *output, struct column **columns, int size)
+{
+	struct column 	*column 	= NULL; 	/**< 	Column being printed 	*/
+	int 			i 			= 0; 		/**< 	Index in the column 	*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 			*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 			*/
+
+	if(output->binary)
+	{
+		output_header(output, columns_count(columns, size));
+	}
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &columns[x][y];
+			for(i = 0; i < column->length; i++)
+			{
+				if(column->status[i] == ALIVE)
+				{
+					output_cell(output, x, y, column->z[i]);
+				}
+			}
+		}
+	}
+}
+
+/************************************************** COLUMNS_PURGE **************************************************/
+/**
+ * Clean up routine to remove dead cells from the columns by compacting
+ * the alive ones at their start
+ *
+ * @param columns 	Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ */
+void columns_purge(struct column **columns, int size)
+{
+	struct column 	*column 	= NULL; 	/**< 	Column being processed 			*/
+	int 			i 			= 0; 		/**< 	Index of the cell being read 	*/
+	int 			j 			= 0; 		/**< 	Index of the cell being kept 	*/
+	int 			x 			= 0; 		/**< 	x-Coordinate 					*/
+	int 			y 			= 0; 		/**< 	y-Coordinate 					*/
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			column = &columns[x][y];
+			j = 0;
+			for(i = 0; i < column->length; i++)
+			{
+				if(column->status[i] == ALIVE)
+				{
+					column->z[j] = column->z[i];
+					column->alive_neighbors[j] = column->alive_neighbors[i];
+					column->status[j] = ALIVE;
+					j++;
+				}
+			}
+			column->length = j;
+		}
+	}
+}
+
+/************************************************** COLUMNS_READ_COORDINATES **************************************************/
+/**
+ * Reads the input file and stores the given cells in the columns.
+ * The cells are sorted first so that every column is allocated once and
+ * filled in order, skipping the repeated cells
+ *
+ * @param input 			Mapped input file
+ * @param columns 			Structure that contains the cells
+ * @param size 				Size of the sides of the cube
+ */
+void columns_read_coordinates(struct input *input, struct column **columns, int size)
+{
+	struct column 		*column 	= NULL; 	/**< 	Column being filled 						*/
+	struct coordinates 	*buffer 	= NULL; 	/**< 	Sorted coordinates of the cells 			*/
+	struct coordinates 	*cells 		= NULL; 	/**< 	Coordinates of the cells read 				*/
+	int 				count 		= 0; 		/**< 	Number of cells read 						*/
+	int 				first 		= 0; 		/**< 	Index of the first cell of the column 		*/
+	int 				i 			= 0; 		/**< 	Index of the cell 							*/
+	int 				last 		= 0; 		/**< 	Index after the last cell of the column 	*/
+
+	cells = coordinates_read(input, &count, size);
+	buffer = (struct coordinates *) malloc((count + 1) * sizeof(struct coordinates));
+	alloc_check(buffer);
+	coordinates_sort(cells, buffer, count, size);
+
+	for(first = 0; first < count; first = last)
+	{
+		/* Find where the column ends to reserve room for all of its cells at once */
+		last = first + 1;
+		while((last < count) && (buffer[last].x == buffer[first].x) && (buffer[last].y == buffer[first].y))
+		{
+			last++;
+		}
+		column = &(columns[buffer[first].x][buffer[first].y]);
+		column_reserve(column, last - first);
+		for(i = first; i < last; i++)
+		{
+			/* Ignore repeated cells */
+			if((column->length > 0) && (column->z[column->length - 1] == buffer[i].z))
+			{
+				continue;
+			}
+			column->z[column->length] = buffer[i].z;
+			column->alive_neighbors[column->length] = 0;
+			column->status[column->length] = ALIVE;
+			column->length++;
+		}
+	}
+
+	free(cells);
+	free(buffer);
+}
+
+/************************************************** COORDINATES_READ **************************************************/
+/**
+ * Reads the input file into a flat array of coordinates, checking that every cell lies inside the cube.
+ * The cells of binary files are decoded from their keys.
+ * Every line takes at least 6 bytes, so the length of the file bounds the number of cells
+ *
+ * @param input 			Mapped input file
+ * @param count 			Number of cells read
+ * @param size 				Size of the sides of the cube
+ * @return 					Coordinates of the cells, in the order of the file
+ */
+struct coordinates * coordinates_read(struct input *input, int *count, int size)
+{
+	struct coordinates 	*cells 			= NULL; 			/**< 	Coordinates of the cells read 		*/
+	char 				*next 			= NULL; 			/**< 	Start of the next line 				*/
+	char 				*ptr 			= input->cursor; 	/**< 	Start of the current line 			*/
+	int 				coordinates[3] 	= {0}; 				/**< 	Coordinates of the current line 	*/
+
+	if(input->binary)
+	{
+		cells = (struct coordinates *) malloc((input->count + 1) * sizeof(struct coordinates));
+		alloc_check(cells);
+		for((*count) = 0; (*count) < (int) input->count; (*count)++)
+		{
+			binary_read_cell(input, coordinates, size);
+			cells[(*count)].x = coordinates[0];
+			cells[(*count)].y = coordinates[1];
+			cells[(*count)].z = coordinates[2];
+		}
+		return cells;
+	}
+
+	cells = (struct coordinates *) malloc(((input->end - ptr) / 6 + 1) * sizeof(struct coordinates));
+	alloc_check(cells);
+
+	(*count) = 0;
+	while(ptr < input->end)
+	{
+		next = input_scan(ptr, input->end, coordinates, 3);
+		if((next == NULL) || (coordinates[0] < 0) || (coordinates[0] >= size) || (coordinates[1] < 0) || (coordinates[1] >= size) || (coordinates[2] < 0) || (coordinates[2] >= size))
+		{
+			input_error(input, ptr);
+		}
+		cells[(*count)].x = coordinates[0];
+		cells[(*count)].y = coordinates[1];
+		cells[(*count)].z = coordinates[2];
+		(*count)++;
+		ptr = next;
+	}
+	input->cursor = ptr;
+
+	return cells;
+}
+
+/************************************************** COORDINATES_SORT **************************************************/
+/**
+ * Sorts the cells by x, then y, then z with a least significant digit radix sort,
+ * one counting sort pass per coordinate, so that the columns can be built in one go
+ *
+ * @param cells 			Coordinates of the cells
+ * @param buffer 			Room for as many cells, where the sorted cells end up
+ * @param count 			Number of cells
+ * @param size 				Size of the sides of the cube
+ */
+void coordinates_sort(struct coordinates *cells, struct coordinates *buffer, int count, int size)
+{
+	int 	*counts 	= NULL; 	/**< 	Number of cells with each value of the coordinate 	*/
+
+	counts = (int *) malloc(size * sizeof(int));
+	alloc_check(counts);
+
+	coordinates_sort_pass(cells, buffer, counts, count, size, 2);
+	coordinates_sort_pass(buffer, cells, counts, count, size, 1);
+	coordinates_sort_pass(cells, buffer, counts, count, size, 0);
+
+	free(counts);
+}
+
+/************************************************** COORDINATES_SORT_PASS **************************************************/
+/**
+ * Stable counting sort of the cells by one of their coordinates
+ *
+ * @param source 			Cells to sort
+ * @param destination 		Where to store the sorted cells
+ * @param counts 			Room for size counters
+ * @param count 			Number of cells
+ * @param size 				Size of the sides of the cube
+ * @param axis 				Coordinate to sort by: 0 for x, 1 for y and 2 for z
+ */
+void coordinates_sort_pass(struct coordinates *source, struct coordinates *destination, int *counts, int count, int size, int axis)
+{
+	int 	i 		= 0; 		/**< 	Index of the cell 							*/
+	int 	key 	= 0; 		/**< 	Value of the coordinate of the cell 		*/
+	int 	total 	= 0; 		/**< 	Running sum of the counters 				*/
+	int 	tmp 	= 0; 		/**< 	Temporary variable to swap the counters 	*/
+
+	memset(counts, 0, size * sizeof(int));
+	for(i = 0; i < count; i++)
+	{
+		counts[COORDINATE(source[i], axis)]++;
+	}
+	/* Turn the counters into the position of the first cell with each value */
+	for(key = 0; key < size; key++)
+	{
+		tmp = counts[key];
+		counts[key] = total;
+		total += tmp;
+	}
+	for(i = 0; i < count; i++)
+	{
+		destination[counts[COORDINATE(source[i], axis)]++] = source[i];
+	}
+}
+
+/************************************************** CUBE_COUNT **************************************************/
+/**
+ * Counts the alive cells of the cube
+ *
+ * @param cube 		Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ * @return 			Number of alive cells
+ */
+uint64_t cube_count(struct node ***cube, int size)
+{
+	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 		*/
+	uint64_t 		count 	= 0; 		/**< 	Number of alive cells 	*/
+	int 			x 		= 0; 		/**< 	x-Coordinate 			*/
+	int 			y 		= 0; 		/**< 	y-Coordinate 			*/
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			for(aux = cube[x][y]; aux != NULL; aux = aux->next)
+			{
+				count += (aux->status == ALIVE);
+			}
+		}
+	}
+
+	return count;
+}
+
+/************************************************** CUBE_CREATE **************************************************/
+/**
+ * Creates a 2D size by size "cube" of pointers to nodes and returns it
+ *
+ * @param size 		Size of the sides of the cube
+ * @return 			"Cube"
+ */
+struct node *** cube_create(int size)
+{
+	struct node 	***cube 		= NULL;
+	struct node 	**cube_mem 		= NULL;
+	int 			x 				= 0;
+
+	cube = (struct node ***) calloc(size, sizeof(struct node **));
+	cube_mem = (struct node **) calloc(size * size, sizeof(struct node *));
+	alloc_check(cube);
+	alloc_check(cube_mem);
+
+	for(x = 0; x < size; x++)
+	{
+		cube[x] = &cube_mem[size * x];
+	}
+
+	return cube;
+}
+
+/************************************************** CUBE_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for the structure required for the problem.
+ * The nodes themselves belong to the pool and are released by pool_destroy
+ *
+ * @param cube 		Structure that contains the cells
+ */
+void cube_destroy(struct node ***cube)
+{
+	free(cube[0]);
+	free(cube);
+}
+
+/************************************************** CUBE_PRINT **************************************************/
+/**
+ * Prints the solution of the problem to the given output
+ *
+ * @param output 	Output buffer
+ * @param cube 		Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ */
+void cube_print(struct output *output, struct node ***cube, int size)
+{
+	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
+	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
+	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+
+	if(output->binary)
+	{
+		output_header(output, cube_count(cube, size));
+	}
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			aux = cube[x][y];
+			while(aux != NULL)
+			{
+				if(aux->status == ALIVE)
+				{
+					output_cell(output, x, y, aux->z);
+				}
+				aux = aux->next;
+			}
+		}
+	}
+}
+
+/************************************************** CUBE_PURGE **************************************************/
+/**
+ * Clean up routine to remove dead cells from the already processed
+ * structure as a way to speed up the next iteration.
+ * The columns left empty are dropped from the worklist, which then only holds the columns with alive cells
+ *
+ * @param pool 		Pool where the removed nodes are kept for reuse
+ * @param cube 		Structure that contains the cells
+ * @param worklist 	Columns that may hold cells
+ * @param size 		Size of the sides of the cube
+ */
+void cube_purge(struct pool *pool, struct node ***cube, struct worklist *worklist, int size)
+{
+	struct node 	**ptr 	= NULL; 	/**< 	Dereferencing pointer 				*/
+	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 					*/
+	int 			count 	= 0; 		/**< 	Number of columns with alive cells 	*/
+	int 			i 		= 0; 		/**< 	Position in the worklist 			*/
+	int 			x 		= 0; 		/**< 	x-Coordinate 						*/
+	int 			y 		= 0; 		/**< 	y-Coordinate 						*/
+
+	for(i = 0; i < worklist->count; i++)
+	{
+		x = worklist->columns[i] / size;
+		y = worklist->columns[i] % size;
+		ptr = &cube[x][y];
+		aux = *ptr;
+		while(aux != NULL)
+		{
+			if(aux->status == DEAD)
+			{
+				*ptr = aux->next;
+				node_destroy(pool, aux);
+			}
+			else
+			{
+				ptr = &aux->next;
+			}
+			aux = *ptr;
+		}
+		if(cube[x][y] != NULL)
+		{
+			worklist->columns[count++] = worklist->columns[i];
+		}
+	}
+	worklist->count = count;
+}
+
+/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
+/**
+ * Iterates through all the cells in the cube and determines whether
+ * they live or die in the next generation
+ *
+ * @param cube 		Structure that contains the cells
+ * @param worklist 	Columns that may hold cells
+ * @param size 		Size of the sides of the cube
+ * @param rule 		Lookup table of the rule
+ */
+void determine_next_generation(struct node ***cube, struct worklist *worklist, int size, int rule)
+{
+	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 			*/
+	int 			i 		= 0; 		/**< 	Position in the worklist 	*/
+
+	for(i = 0; i < worklist->count; i++)
+	{
+		aux = cube[worklist->columns[i] / size][worklist->columns[i] % size];
+		while(aux != NULL)
+		{
+			/* The rule gives the next state from the current one and the number of neighbors, without branches */
+			aux->status = RULE_NEXT(rule, aux->status, aux->alive_neighbors);
+			/* Reset the number of neighbors of all processed cells */
+			aux->alive_neighbors = 0;
+			aux = aux->next;
+		}
+	}
+}
+
+/************************************************** INPUT_ERROR **************************************************/
+/**
+ * Reports a line of the input file that does not match the specifications and exits.
+ * The line number is only needed here, so it is found by counting the newlines before
+ * the offending position instead of being tracked while parsing
+ *
+ * @param input 			Mapped input file
+ * @param ptr 				Position of the offending line
+ */
+void input_error(struct input *input, char *ptr)
+{
+	char 	*cursor 	= input->data;
+	int 	line 		= 1;
+
+	while((cursor < ptr) && ((cursor = memchr(cursor, '\n', ptr - cursor)) != NULL))
+	{
+		cursor++;
+		line++;
+	}
+
+	fprintf(stderr, "Input file does not match specifications (line %d)\n", line);
+	exit(-1);
+}
+
+/************************************************** INPUT_MAP **************************************************/
+/**
+ * Maps the whole input file in memory and returns it, the file is only
+ * ever read once from beginning to end so the kernel is told to read ahead
+ *
+ * @param input_filename 	Name of the input file
+ * @return 					Mapped input file
+ */
+struct input * input_map(char *input_filename)
+{
+	struct input 	*input 	= NULL;
+	struct stat 	info;
+	int 			fd 		= 0;
+
+	input = (struct input *) calloc(1, sizeof(struct input));
+	alloc_check(input);
+
+	fd = open(input_filename, O_RDONLY);
+	if((fd < 0) || (fstat(fd, &info) != 0))
+	{
+		fprintf(stderr, "Error opening given file\n");
+		exit(-1);
+	}
+
+	input->length = info.st_size;
+	if(input->length > 0)
+	{
+		input->data = (char *) mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(input->data == MAP_FAILED)
+		{
+			fprintf(stderr, "Error mapping given file\n");
+			exit(-1);
+		}
+		madvise(input->data, input->length, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	input->cursor = input->data;
+	input->end = input->data + input->length;
+
+	return input;
+}
+
+/************************************************** INPUT_SCAN **************************************************/
+/**
+ * Parses count non-negative integers separated by blanks from the line that starts at ptr.
+ * Anything after the last integer is ignored, like sscanf did before
+ *
+ * @param ptr 				Start of the line
+ * @param end 				End of the mapped file
+ * @param values 			Where to store the integers
+ * @param count 			Number of integers to parse
+ * @return 					Start of the next line or NULL if the line does not match
+ */
+char * input_scan(char *ptr, char *end, int *values, int count)
+{
+	unsigned int 	digit 	= 0;
+	int 			i 		= 0;
+	int 			value 	= 0;
+
+	for(i = 0; i < count; i++)
+	{
+		while((ptr < end) && ((*ptr == ' ') || (*ptr == '\t')))
+		{
+			ptr++;
+		}
+		if((ptr == end) || ((unsigned int) (*ptr - '0') > 9))
+		{
+			return NULL;
+		}
+
+		value = 0;
+		while((ptr < end) && ((digit = (unsigned int) (*ptr - '0')) < 10))
+		{
+			/* Stop before the value no longer fits in an int, which would wrap it around */
+			if(value > (INT_MAX - (int) digit) / 10)
+			{
+				return NULL;
+			}
+			value = value * 10 + digit;
+			ptr++;
+		}
+		values[i] = value;
+	}
+
+	ptr = memchr(ptr, '\n', end - ptr);
+	return (ptr == NULL) ? end : ptr + 1;
+}
+
+/************************************************** INPUT_UNMAP **************************************************/
+/**
+ * Unmaps the input file and frees its structure
+ *
+ * @param input 			Mapped input file
+ */
+void input_unmap(struct input *input)
+{
+	if(input->length > 0)
+	{
+		munmap(input->data, input->length);
+	}
+	free(input);
+}
+
+/************************************************** MARK_NEIGHBORS **************************************************/
+/**
+ * Increments the alive neighbors count of all the neighbors of all
+ * alive cells in the current generation.
+ * Instead of adding the 6 neighbors of every alive cell, the neighbors of each
+ * column are gathered in a single linear merge of the sorted alive cells of
+ * the 4 adjacent columns and of the column itself shifted by +1 and -1 in z.
+ * Only the column being processed is modified, the adjacent ones are just read,
+ * and only the columns of the worklist, which also holds the columns next to the alive cells, are processed
+ *
+ * @param pool 		Pool from which new nodes are taken
+ * @param cube 		Structure that contains the cells
+ * @param worklist 	Columns that may get cells
+ * @param size 		Size of the sides of the cube
+ */
+void mark_neighbors(struct pool *pool, struct node ***cube, struct worklist *worklist, int size)
+{
+	struct node 	*adjacent[4]; 				/**< 	Alive cells of the adjacent columns being merged 		*/
+	struct node 	**next_x 		= NULL; 	/**< 	Columns with the x-coordinate after the current one 	*/
+	struct node 	**previous_x 	= NULL; 	/**< 	Columns with the x-coordinate before the current one 	*/
+	struct node 	**ptr 			= NULL; 	/**< 	Position of the merge in the column being processed 	*/
+	struct node 	*down 			= NULL; 	/**< 	Alive cell whose z-1 neighbor is being merged 			*/
+	struct node 	*up 			= NULL; 	/**< 	Alive cell whose z+1 neighbor is being merged 			*/
+	int 			count 			= 0; 		/**< 	Number of alive neighbors of the merged cell 			*/
+	int 			entry 			= 0; 		/**< 	Position in the worklist 								*/
+	int 			i 				= 0; 		/**< 	Index of the adjacent column 							*/
+	int 			wrap_down 		= 0; 		/**< 	Whether the cell at z=0 is alive 						*/
+	int 			wrap_up 		= 0; 		/**< 	Whether the cell at z=size-1 is alive 					*/
+	int 			x 				= 0; 		/**< 	x-Coordinate 											*/
+	int 			y 				= 0; 		/**< 	y-Coordinate 											*/
+	int 			z 				= 0; 		/**< 	z-Coordinate 											*/
+
+	for(entry = 0; entry < worklist->count; entry++)
+	{
+		x = worklist->columns[entry] / size;
+		y = worklist->columns[entry] % size;
+		next_x = cube[MOD((x+1), size)];
+		previous_x = cube[MOD((x-1), size)];
+		adjacent[0] = next_x[y];
+		adjacent[1] = previous_x[y];
+		adjacent[2] = cube[x][(y == (size - 1)) ? 0 : (y + 1)];
+		adjacent[3] = cube[x][(y == 0) ? (size - 1) : (y - 1)];
+		up = cube[x][y];
+		for(i = 0; i < 4; i++)
+		{
+			adjacent[i] = node_next_alive(adjacent[i]);
+		}
+		/* The column itself only holds alive cells as no other column adds nodes to it */
+		down = up;
+		/* The z-1 neighbor of the cell at 0 and the z+1 neighbor of the cell at size-1 wrap around,
+		   so they are left out of the merge to keep it sorted and added at the end */
+		wrap_down = ((down != NULL) && (down->z == 0));
+		wrap_up = 0;
+		if(wrap_down)
+		{
+			down = node_next_alive(down->next);
+		}
+		ptr = &cube[x][y];
+
+		while(1)
+		{
+			if((up != NULL) && (up->z == (size - 1)))
+			{
+				wrap_up = 1;
+				up = NULL;
+			}
+			/* Find the smallest z-coordinate among all the lists being merged */
+			z = size;
+			for(i = 0; i < 4; i++)
+			{
+				if((adjacent[i] != NULL) && (adjacent[i]->z < z))
+				{
+					z = adjacent[i]->z;
+				}
+			}
+			if((up != NULL) && ((up->z + 1) < z))
+			{
+				z = up->z + 1;
+			}
+			if((down != NULL) && ((down->z - 1) < z))
+			{
+				z = down->z - 1;
+			}
+			if(z == size)
+			{
+				break;
+			}
+			/* Count and skip all the alive neighbors of the cell at that z-coordinate */
+			count = 0;
+			for(i = 0; i < 4; i++)
+			{
+				if((adjacent[i] != NULL) && (adjacent[i]->z == z))
+				{
+					count += NEIGHBOR;
+					adjacent[i] = node_next_alive(adjacent[i]->next);
+				}
+			}
+			if((up != NULL) && ((up->z + 1) == z))
+			{
+				count += NEIGHBOR;
+				up = node_next_alive(up->next);
+			}
+			if((down != NULL) && ((down->z - 1) == z))
+			{
+				count += NEIGHBOR;
+				down = node_next_alive(down->next);
+			}
+			ptr = node_mark(pool, ptr, z, count);
+		}
+
+		if(wrap_down)
+		{
+			ptr = node_mark(pool, ptr, size - 1, NEIGHBOR);
+		}
+		if(wrap_up)
+		{
+			node_mark(pool, &cube[x][y], 0, NEIGHBOR);
+		}
+	}
+}
+
+/************************************************** NODE_CREATE **************************************************/
+/**
+ * Creates a node that represent a cell in the game, reusing one
+ * from the pool and only growing it when it runs out of nodes
+ *
+ * @param pool 		Pool from which the node is taken
+ * @param status 	Status of the cell to create
+ * @param z 		z-coordinate of the cell to create
+ * @return 			Pointer to the cell created
+ */
+struct node * node_create(struct pool *pool, short status, int z)
+{
+	struct node 	*new 	= NULL; 	/**< 	Pointer to the new node 	*/
+
+	if(pool->free_list == NULL)
+	{
+		pool_grow(pool);
+	}
+	new = pool->free_list;
+	pool->free_list = new->next;
+
+	new->alive_neighbors = 0;
+	new->status = status;
+	new->z = z;
+	new->next = NULL;
+
+	return new;
+}
+
+/************************************************** NODE_DESTROY **************************************************/
+/**
+ * Gives a node that is no longer in use back to the pool
+ *
+ * @param pool 		Pool where the node is kept for reuse
+ * @param node 		Node to give back
+ */
+void node_destroy(struct pool *pool, struct node *node)
+{
+	node->next = pool->free_list;
+	pool->free_list = node;
+}
+
+/************************************************** NODE_MARK **************************************************/
+/**
+ * Adds a number of alive neighbors to the cell with the given z-coordinate,
+ * creating it if it does not exist. The search starts at the given position
+ * of a sorted list so that a sequence of increasing z-coordinates is merged
+ * into the list in a single pass
+ *
+ * @param pool 		Pool from which new nodes are taken
+ * @param ptr 		Position of the list where to start the search
+ * @param z 		z-coordinate of the cell
+ * @param count 	Number of alive neighbors to add
+ * @return 			Position of the list where the cell is
+ */
+struct node ** node_mark(struct pool *pool, struct node **ptr, int z, int count)
+{
+	struct node 	*new 	= NULL; 	/**< 	Pointer to a new node 	*/
+
+	while(((*ptr) != NULL) && ((*ptr)->z < z))
+	{
+		ptr = &((*ptr)->next);
+	}
+	if(((*ptr) != NULL) && ((*ptr)->z == z))
+	{
+		(*ptr)->alive_neighbors += count;
+	}
+	else
+	{
+		new = node_create(pool, DEAD, z);
+		new->alive_neighbors = count;
+		new->next = (*ptr);
+		(*ptr) = new;
+	}
+
+	return ptr;
+}
+
+/************************************************** NODE_NEXT_ALIVE **************************************************/
+/**
+ * Returns the first alive cell of a list starting at the given node
+ *
+ * @param node 		Node where to start the search
+ * @return 			Alive cell or NULL if there is none
+ */
+struct node * node_next_alive(struct node *node)
+{
+	while((node != NULL) && (node->status != ALIVE))
+	{
+		node = node->next;
+	}
+
+	return node;
+}
+
+/************************************************** OUTPUT_CELL **************************************************/
+/**
+ * Formats the coordinates of a cell as a line of the output, or as its key in the binary format, writing the buffer out first if it is full
+ *
+ * @param output 	Output buffer
+ * @param x 		x-coordinate of the cell
+ * @param y 		y-coordinate of the cell
+ * @param z 		z-coordinate of the cell
+ */
+void output_cell(struct output *output, int x, int y, int z)
+{
+	char 	*ptr 	= NULL; 	/**< 	Where to format the next character 	*/
+
+	if(output->capacity - output->length < OUTPUT_LINE_SIZE)
+	{
+		output_flush(output);
+	}
+
+	if(output->binary)
+	{
+		binary_put((unsigned char *) &(output->buffer[output->length]), ((uint64_t) x * output->size + y) * output->size + z, 8);
+		output->length += 8;
+		return;
 	}
+
+	ptr = &(output->buffer[output->length]);
+	ptr = output_int(ptr, x);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, y);
+	*(ptr++) = ' ';
+	ptr = output_int(ptr, z);
+	*(ptr++) = '\n';
+	output->length = ptr - output->buffer;
 }
 
-/************************************************** CUBE_CREATE **************************************************/
+/************************************************** OUTPUT_CREATE **************************************************/
 /**
- * Creates a 2D size by size "cube" of pointers to nodes and returns it
+ * Creates an empty output buffer for the given file descriptor and returns it
  *
+ * @param fd 		File descriptor where the output is written
+ * @param binary 	Whether the output uses the binary format
  * @param size 		Size of the sides of the cube
- * @return 			"Cube"
+ * @param generation 	Generation of the cells written
+ * @return 			Output buffer
  */
-struct node *** cube_create(int size)
+struct output * output_create(int fd, int binary, int size, uint64_t generation)
 {
-	struct node 	***cube 		= NULL;
-	struct node 	**cube_mem 		= NULL;
-	int 			x 				= 0;
-
-	cube = (struct node ***) calloc(size, sizeof(struct node **));
-	cube_mem = (struct node **) calloc(size * size, sizeof(struct node *));
-	alloc_check(cube);
-	alloc_check(cube_mem);
+	struct output 	*output 	= NULL; 	/**< 	Output buffer 	*/
 
-	for(x = 0; x < size; x++)
-	{
-		cube[x] = &cube_mem[size * x];
-	}
+	output = (struct output *) malloc(sizeof(struct output));
+	alloc_check(output);
+	output->buffer = (char *) malloc(OUTPUT_BUFFER_SIZE);
+	alloc_check(output->buffer);
+	output->capacity = OUTPUT_BUFFER_SIZE;
+	output->length = 0;
+	output->fd = fd;
+	output->binary = binary;
+	output->generation = generation;
+	output->size = size;
 
-	return cube;
+	return output;
 }
 
-/************************************************** CUBE_DESTROY **************************************************/
+/************************************************** OUTPUT_DESTROY **************************************************/
 /**
- * Frees the memory allocated for the structure required for the problem
+ * Writes out what is left in the output buffer and frees it
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @param output 	Output buffer
  */
-void cube_destroy(struct node ***cube, int size)
+void output_destroy(struct output *output)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	output_flush(output);
+	free(output->buffer);
+	free(output);
+}
 
-	for(x = 0; x < size; x++)
-	{
-		for(y = 0; y < size; y++)
-		{
-			while(cube[x][y] != NULL)
-			{
-				aux = cube[x][y];
-				cube[x][y] = cube[x][y]->next;
-				free(aux);
-			}
-		}
-	}
-	free(cube[0]);
-	free(cube);
+/************************************************** OUTPUT_FLUSH **************************************************/
+/**
+ * Writes the contents of the output buffer to its file descriptor and empties it
+ *
+ * @param output 	Output buffer
+ */
+void output_flush(struct output *output)
+{
+	output_write(output->fd, output->buffer, output->length);
+	output->length = 0;
 }
 
-/************************************************** CUBE_PRINT **************************************************/
+/************************************************** OUTPUT_HEADER **************************************************/
 /**
- * Prints the solution of the problem to stdout
+ * Writes the header of the binary format to the output buffer
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @param output 	Output buffer
+ * @param count 	Number of cells that follow the header
  */
-void cube_print(struct node ***cube, int size)
+void output_header(struct output *output, uint64_t count)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	unsigned char 	*header 	= NULL; 	/**< 	Where to write the header 	*/
 
-	for(x = 0; x < size; x++)
+	if(output->capacity - output->length < BINARY_HEADER_SIZE)
 	{
-		for(y = 0; y < size; y++)
-		{
-			aux = cube[x][y];
-			while(aux != NULL)
-			{
-				if(aux->status == ALIVE)
-				{
-					fprintf(stdout, "%d %d %d\n", x, y, aux->z);
-				}
-				aux = aux->next;
-			}
-		}
+		output_flush(output);
 	}
+
+	header = (unsigned char *) &(output->buffer[output->length]);
+	memcpy(header, BINARY_MAGIC, 4);
+	binary_put(&header[4], BINARY_VERSION, 4);
+	binary_put(&header[8], 0, 4);
+	binary_put(&header[12], output->size, 4);
+	binary_put(&header[16], output->generation, 8);
+	binary_put(&header[24], count, 8);
+	output->length += BINARY_HEADER_SIZE;
 }
 
-/************************************************** CUBE_PURGE **************************************************/
+/************************************************** OUTPUT_INT **************************************************/
 /**
- * Clean up routine to remove dead cells from the already processed
- * structure as a way to speed up the next iteration
+ * Formats a non-negative integer in decimal, without going through printf
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @param ptr 		Where to format the integer
+ * @param value 	Integer to format
+ * @return 			Position right after the last digit
  */
-void cube_purge(struct node ***cube, int size)
+char * output_int(char *ptr, int value)
 {
-	struct node 	**ptr 	= NULL; 	/**< 	Dereferencing pointer 	*/
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 		*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 			*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 			*/
+	char 	digits[12] 	= {0}; 		/**< 	Digits of the integer, from the least significant 	*/
+	int 	length 		= 0; 		/**< 	Number of digits 									*/
 
-	for(x = 0; x < size; x++)
+	do
 	{
-		for(y = 0; y < size; y++)
-		{
-			ptr = &cube[x][y];
-			aux = *ptr;
-			while(aux != NULL)
-			{
-				if(aux->status == DEAD)
-				{
-					*ptr = aux->next;
-					free(aux);
-				}
-				else
-				{
-					ptr = &aux->next;
-				}
-				aux = *ptr;
-			}
-		}
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	while(length > 0)
+	{
+		*(ptr++) = digits[--length];
 	}
+
+	return ptr;
 }
 
-/************************************************** DETERMINE_NEXT_GENERATION **************************************************/
+/************************************************** OUTPUT_WRITE **************************************************/
 /**
- * Iterates through all the cells in the cube and determines whether
- * they live or die in the next generation
+ * Writes the given data to a file descriptor, retrying after partial writes and interruptions
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @param fd 		File descriptor
+ * @param data 		Data to write
+ * @param length 	Number of bytes to write
  */
-void determine_next_generation(struct node ***cube, int size)
+void output_write(int fd, char *data, size_t length)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
+	ssize_t 	written 	= 0; 		/**< 	Number of bytes written by the last call 	*/
 
-	for(x = 0; x < size; x++)
+	while(length > 0)
 	{
-		for(y = 0; y < size; y++)
+		written = write(fd, data, length);
+		if(written < 0)
 		{
-			aux = cube[x][y];
-			while(aux != NULL)
+			if(errno == EINTR)
 			{
-				/* If the cell is alive and has less than 2 or more than 4 neighbors it dies */
-				if(aux->status == ALIVE)
-				{
-					if(aux->alive_neighbors < 2 || aux->alive_neighbors > 4)
-					{
-						aux->status = DEAD;
-					}
-				}
-				/* If the cell is dead and has either 2 or 3 neighbors it comes to life */
-				else
-				{
-					if(aux->alive_neighbors == 2 || aux->alive_neighbors == 3)
-					{
-						aux->status = ALIVE;
-					}
-				}
-				/* Reset the number of neighbors of all processed cells */
-				aux->alive_neighbors = 0;
-				aux = aux->next;
+				continue;
 			}
+			fprintf(stderr, "Error writing the output\n");
+			exit(-1);
 		}
+		data += written;
+		length -= written;
 	}
 }
 
-/************************************************** MARK_NEIGHBORS **************************************************/
+/************************************************** POOL_CREATE **************************************************/
 /**
- * Increments the alive neighbors count of all the neighbors of all
- * alive cells in the current generation
+ * Creates an empty pool of nodes and returns it
  *
- * @param cube 		Structure that contains the cells
- * @param size 		Size of the sides of the cube
+ * @return 			Pool
  */
-void mark_neighbors(struct node ***cube, int size)
+struct pool * pool_create(void)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
-	int 			x 		= 0; 		/**< 	x-Coordinate 		*/
-	int 			y 		= 0; 		/**< 	y-Coordinate 		*/
-	int 			z 		= 0; 		/**< 	z-Coordinate 		*/
+	struct pool 	*pool 	= NULL; 	/**< 	Pointer to the new pool 	*/
 
-	for(x = 0; x < size; x++)
-	{
-		for(y = 0; y < size; y++)
-		{
-			aux = cube[x][y];
-			while(aux != NULL)
-			{
-				/* For every alive cell, add each of its 6 neighbors to the cube and/or increment their neighbor count */
-				if(aux->status == ALIVE)
-				{
-					z = aux->z;
-					node_add(&(cube[MOD((x+1), size)][y]), NEIGHBOR, DEAD, z);
-					node_add(&(cube[MOD((x-1), size)][y]), NEIGHBOR, DEAD, z);
-					node_add(&(cube[x][MOD((y+1), size)]), NEIGHBOR, DEAD, z);
-					node_add(&(cube[x][MOD((y-1), size)]), NEIGHBOR, DEAD, z);
-					node_add(&(cube[x][y]), NEIGHBOR, DEAD, MOD((z+1), size));
-					node_add(&(cube[x][y]), NEIGHBOR, DEAD, MOD((z-1), size));
-				}
-				aux = aux->next;
-			}
-		}
-	}
+	pool = (struct pool *) calloc(1, sizeof(struct pool));
+	alloc_check(pool);
+
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+
+	return pool;
 }
 
-/************************************************** NODE_ADD **************************************************/
+/************************************************** POOL_DESTROY **************************************************/
 /**
- * Adds a node to the given list
+ * Frees all the memory owned by the pool, including the nodes still in use
  *
- * @param head 		Head of the list where to insert the node
- * @param mode 		A way to differentiate whether we're adding neighbors of alive cells or alive cells themselves.
- *					It could be suppressed by creating an almost identical function for each case
- * @param status 	Status of the cell to add
- * @param z 		z-coordinate of the cell to add
+ * @param pool 		Pool to destroy
  */
-void node_add(struct node **head, short mode, short status, int z)
+void pool_destroy(struct pool *pool)
 {
-	struct node 	*aux 	= NULL; 	/**< 	Auxilliary pointer 		*/
-	struct node 	*new 	= NULL; 	/**< 	Pointer to a new node 	*/
+	struct slab 	*aux 	= NULL; 	/**< 	Auxilliary pointer 	*/
 
-	/* Add the node at the start of the list if its either empty or if it has the smallest z-coordinate */
-	if(((*head) == NULL) || ((*head)->z > z))
+	while(pool->slabs != NULL)
 	{
-		new = node_create(status, z);
-		new->alive_neighbors += mode;
-		new->next = (*head);
-		(*head) = new;
-	}
-	/* If we're adding a neighbor and the z-coordinate matches one already existing, increment the neighbor count */
-	else if((*head)->z == z)
-	{
-		(*head)->alive_neighbors += mode;
-	}
-	/* Remaining cases */
-	else
-	{
-		aux = (*head);
-		/* Go through the list until it either ends or we find a node with a greater z-coordinate */
-		while((aux->next != NULL) && (aux->next->z <= z))
-		{
-			aux = aux->next;
-		}
-		/* Increment the neighbor count if the node we are inserting already exists */
-		if(aux->z == z)
-		{
-			aux->alive_neighbors += mode;
-		}
-		/* Otherwise add the node */
-		else
-		{
-			new = node_create(status, z);
-			new->alive_neighbors += mode;
-			new->next = aux->next;
-			aux->next = new;
-		}
+		aux = pool->slabs;
+		pool->slabs = pool->slabs->next;
+		free(aux);
 	}
+	free(pool);
 }
 
-/************************************************** NODE_CREATE **************************************************/
+/************************************************** POOL_GROW **************************************************/
 /**
- * Creates a node that represent a cell in the game
+ * Allocates a new slab of nodes and chains all of them in the free list of the pool
  *
- * @param status 	Status of the cell to create
- * @param z 		z-coordinate of the cell to create
- * @return 			Pointer to the cell created
+ * @param pool 		Pool to grow
  */
-struct node * node_create(short status, int z)
+void pool_grow(struct pool *pool)
 {
-	struct node 	*new 	= NULL; 	/**< 	Pointer to the new node 	*/
+	struct slab 	*slab 	= NULL; 	/**< 	Pointer to the new slab 	*/
+	int 			i 		= 0; 		/**< 	Index of the node in the slab 	*/
 
-	new = (struct node *) calloc(1, sizeof(struct node));
-	alloc_check(new);
+	slab = (struct slab *) malloc(sizeof(struct slab));
+	alloc_check(slab);
 
-	new->alive_neighbors = 0;
-	new->status = status;
-	new->z = z;
-	new->next = NULL;
+	for(i = 0; i < (POOL_SLAB_SIZE - 1); i++)
+	{
+		slab->nodes[i].next = &(slab->nodes[i+1]);
+	}
+	slab->nodes[POOL_SLAB_SIZE - 1].next = pool->free_list;
+	pool->free_list = &(slab->nodes[0]);
 
-	return new;
+	slab->next = pool->slabs;
+	pool->slabs = slab;
 }
 
 /************************************************** READ_ARGUMENTS **************************************************/
@@ -362,17 +1664,64 @@ struct node * node_create(short status, int z)
  * @param argv				Command line arguments
  * @param input_filename	Name of the file specified in the arguments
  * @param iterations 		Number of iterations specified in the arguments
+ * @param engine 			Engine specified in the arguments, the linked lists by default
+ * @param binary 			Whether to print the solution in the binary format
+ * @param rule 				Lookup table of the rule specified in the arguments, B23/S234 by default
  */
-void read_arguments(int argc, char *argv[], char **input_filename, int *iterations)
+void read_arguments(int argc, char *argv[], char **input_filename, int *iterations, int *engine, int *binary, int *rule)
 {
 	FILE 	*input_fd 	= NULL;
+	int 	i 			= 0;
 
-	if(argc != 3)
+	if(argc < 3)
 	{
-		fprintf(stderr, "Program is run with ./life3d [name-of-input-file] [number-of-iterations]\n");
+		fprintf(stderr, "Program is run with ./life3d [name-of-input-file] [number-of-iterations] [--engine list|array] [--rule B../S..] [--binary]\n");
 		exit(-1);
 	}
 
+	(*engine) = ENGINE_LIST;
+	(*binary) = 0;
+	(*rule) = RULE_DEFAULT;
+	for(i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--binary") == 0)
+		{
+			(*binary) = 1;
+		}
+		else if((strcmp(argv[i], "--engine") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if(strcmp(argv[i], "list") == 0)
+			{
+				(*engine) = ENGINE_LIST;
+			}
+			else if(strcmp(argv[i], "array") == 0)
+			{
+				(*engine) = ENGINE_ARRAY;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown engine %s\n", argv[i]);
+				exit(-1);
+			}
+		}
+		else if((strcmp(argv[i], "--rule") == 0) && (i + 1 < argc))
+		{
+			(*rule) = read_rule(argv[++i]);
+			/* Only the cells next to alive ones are ever looked at, so none can be born without neighbors */
+			if(RULE_NEXT((*rule), DEAD, 0))
+			{
+				fprintf(stderr, "Rules with B0 are only supported by life3d-dense\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
 	(*input_filename) = argv[1];
 	input_fd = fopen((*input_filename), "r");
 	if(input_fd == NULL)
@@ -392,88 +1741,298 @@ void read_arguments(int argc, char *argv[], char **input_filename, int *iteratio
 
 /************************************************** READ_COORDINATES **************************************************/
 /**
- * Reads the input file and stores the given cells in the cube
+ * Reads the input file and stores the given cells in the cube.
+ * The cells are sorted first so that every list is built in order, appending
+ * each node at its tail and skipping the repeated cells, instead of searching
+ * the list for the position of every cell
  *
+ * @param input 			Mapped input file
+ * @param pool 				Pool from which new nodes are taken
  * @param cube 				Structure that contains the cells
- * @param input_filename 	Name of the input file
  * @param size 				Size of the sides of the cube
  */
-void read_coordinates(FILE *input_fd, struct node ***cube)
+void read_coordinates(struct input *input, struct pool *pool, struct node ***cube, int size)
+{
+	struct coordinates 	*buffer 	= NULL; 	/**< 	Sorted coordinates of the cells 			*/
+	struct coordinates 	*cells 		= NULL; 	/**< 	Coordinates of the cells read 				*/
+	struct node 		**tail 		= NULL; 	/**< 	Where to link the next node of the list 	*/
+	int 				count 		= 0; 		/**< 	Number of cells read 						*/
+	int 				i 			= 0; 		/**< 	Index of the cell 							*/
+
+	cells = coordinates_read(input, &count, size);
+	buffer = (struct coordinates *) malloc((count + 1) * sizeof(struct coordinates));
+	alloc_check(buffer);
+	coordinates_sort(cells, buffer, count, size);
+
+	for(i = 0; i < count; i++)
+	{
+		/* A new column starts whenever x or y change */
+		if((i == 0) || (buffer[i].x != buffer[i-1].x) || (buffer[i].y != buffer[i-1].y))
+		{
+			tail = &(cube[buffer[i].x][buffer[i].y]);
+		}
+		/* Ignore repeated cells */
+		else if(buffer[i].z == buffer[i-1].z)
+		{
+			continue;
+		}
+		(*tail) = node_create(pool, ALIVE, buffer[i].z);
+		tail = &((*tail)->next);
+	}
+
+	free(cells);
+	free(buffer);
+}
+
+/************************************************** READ_RULE **************************************************/
+/**
+ * Parses a rule written as B followed by the numbers of neighbors that bring a dead cell to life,
+ * a slash and S followed by the numbers of neighbors that keep an alive cell alive, like B23/S234,
+ * and returns its lookup table. The table has a bit per state and number of neighbors,
+ * bit alive * 8 + count, set when the cell is alive in the next generation
+ *
+ * @param text 				Rule given in the arguments
+ * @return 					Lookup table of the rule
+ */
+int read_rule(char *text)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	x 						= 0;
-	int 	y 						= 0;
-	int 	z 						= 0;
+	char 	*ptr 	= text;
+	int 	rule 	= 0;
+	int 	valid 	= 0;
 
-	while(fgets(buffer, BUFFER_SIZE, input_fd) != NULL)
+	if((*ptr) == 'B')
 	{
-		if((sscanf(buffer,"%d %d %d", &x, &y, &z)) != 3)
+		for(ptr++; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
 		{
-			fprintf(stderr, "Input file does not match specifications\n");
-			exit(-1);
+			rule |= 1 << ((*ptr) - '0');
+		}
+		if((ptr[0] == '/') && (ptr[1] == 'S'))
+		{
+			for(ptr += 2; ((*ptr) >= '0') && ((*ptr) <= '6'); ptr++)
+			{
+				rule |= 1 << (8 + (*ptr) - '0');
+			}
+			valid = ((*ptr) == '\0');
 		}
-		node_add(&(cube[x][y]), NEW, ALIVE, z);
 	}
+
+	if(!valid)
+	{
+		fprintf(stderr, "Invalid rule %s, it must look like B23/S234 with numbers of neighbors from 0 to 6\n", text);
+		exit(-1);
+	}
+
+	return rule;
 }
 
 /************************************************** READ_SIZE **************************************************/
 /**
  * Reads the input file and returns the declared size of the sides of the cube
  *
- * @param input_fd 			File descriptor for the input file
+ * @param input 			Mapped input file
  * @return size 			Size of the sides of the cube
  */
-int read_size(FILE *input_fd)
+int read_size(struct input *input)
 {
-	char 	buffer[BUFFER_SIZE] 	= {0};
-	int 	size 					= 0;
+	char 	*next 	= NULL;
+	int 	size 	= 0;
 
-	fgets(buffer, BUFFER_SIZE, input_fd);
-	if((sscanf(buffer, "%d", &size)) != 1)
+	/* Binary files start with a header instead of a line with the size */
+	if((input->length >= BINARY_HEADER_SIZE) && (memcmp(input->data, BINARY_MAGIC, 4) == 0))
 	{
-		fprintf(stderr, "Input file does not match specifications\n");
-		exit(-1);
+		return binary_read_header(input);
+	}
+
+	next = input_scan(input->cursor, input->end, &size, 1);
+	if(next == NULL)
+	{
+		input_error(input, input->cursor);
 	}
+	input->cursor = next;
 
 	return size;
 }
 
+/************************************************** WORKLIST_CREATE **************************************************/
+/**
+ * Creates the worklist of a cube with the columns that hold cells
+ *
+ * @param cube 		Structure that contains the cells
+ * @param size 		Size of the sides of the cube
+ * @return 			Worklist
+ */
+struct worklist * worklist_create(struct node ***cube, int size)
+{
+	struct worklist 	*worklist 	= NULL; 	/**< 	Pointer to the new worklist 	*/
+	int 				x 			= 0; 		/**< 	x-Coordinate 					*/
+	int 				y 			= 0; 		/**< 	y-Coordinate 					*/
+
+	worklist = (struct worklist *) calloc(1, sizeof(struct worklist));
+	alloc_check(worklist);
+	worklist->columns = (int *) malloc((size_t) size * size * sizeof(int));
+	worklist->stamps = (int *) calloc((size_t) size * size, sizeof(int));
+	alloc_check(worklist->columns);
+	alloc_check(worklist->stamps);
+
+	for(x = 0; x < size; x++)
+	{
+		for(y = 0; y < size; y++)
+		{
+			if(cube[x][y] != NULL)
+			{
+				worklist->columns[worklist->count++] = x * size + y;
+			}
+		}
+	}
+
+	return worklist;
+}
+
+/************************************************** WORKLIST_DESTROY **************************************************/
+/**
+ * Frees the memory allocated for the worklist
+ *
+ * @param worklist 	Worklist to destroy
+ */
+void worklist_destroy(struct worklist *worklist)
+{
+	free(worklist->columns);
+	free(worklist->stamps);
+	free(worklist);
+}
+
+/************************************************** WORKLIST_EXPAND **************************************************/
+/**
+ * Adds to the worklist the 4 columns next to each of its columns, which are the only
+ * other ones where cells can be born in the next generation. Every column is added once,
+ * as the generation in which a column was last added tells whether it already is in the list
+ *
+ * @param worklist 	Worklist with the columns that hold alive cells
+ * @param size 		Size of the sides of the cube
+ */
+void worklist_expand(struct worklist *worklist, int size)
+{
+	int 	adjacent[4]; 		/**< 	Columns next to the current one 				*/
+	int 	count 		= 0; 	/**< 	Number of columns with alive cells 				*/
+	int 	i 			= 0; 	/**< 	Position in the worklist 						*/
+	int 	j 			= 0; 	/**< 	Index of the adjacent column 					*/
+	int 	x 			= 0; 	/**< 	x-Coordinate 									*/
+	int 	y 			= 0; 	/**< 	y-Coordinate 									*/
+
+	count = worklist->count;
+	worklist->stamp++;
+	for(i = 0; i < count; i++)
+	{
+		worklist->stamps[worklist->columns[i]] = worklist->stamp;
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		x = worklist->columns[i] / size;
+		y = worklist->columns[i] % size;
+		adjacent[0] = MOD((x+1), size) * size + y;
+		adjacent[1] = MOD((x-1), size) * size + y;
+		adjacent[2] = x * size + ((y == (size - 1)) ? 0 : (y + 1));
+		adjacent[3] = x * size + ((y == 0) ? (size - 1) : (y - 1));
+		for(j = 0; j < 4; j++)
+		{
+			if(worklist->stamps[adjacent[j]] != worklist->stamp)
+			{
+				worklist->stamps[adjacent[j]] = worklist->stamp;
+				worklist->columns[worklist->count++] = adjacent[j];
+			}
+		}
+	}
+}
+
 /************************************************** MAIN **************************************************/
 int main(int argc, char *argv[])
 {
-	FILE 			*input_fd 			= NULL; 	/**< 	File descriptor for the input file 			*/
-	struct node 	***cube 			= NULL; 	/**< 	Structure that contains the cells 			*/
+	struct column 	**columns 			= NULL; 	/**< 	Structure that contains the cells (arrays) 	*/
+	struct column 	scratch; 						/**< 	Temporary storage for the merges 			*/
+	struct node 	***cube 			= NULL; 	/**< 	Structure that contains the cells (lists) 	*/
+	struct input 	*input 				= NULL; 	/**< 	Mapped input file 							*/
+	struct output 	*output 			= NULL; 	/**< 	Output buffer for stdout 					*/
+	struct pool 	*pool 				= NULL; 	/**< 	Pool of nodes shared by every generation 	*/
+	struct worklist *worklist 			= NULL; 	/**< 	Columns the generations go over 			*/
 	char 			*input_filename 	= NULL; 	/**< 	Name of the input file 						*/
+	short 			*list 				= NULL; 	/**< 	Alive z-coordinates of a column 			*/
+	int 			binary 				= 0; 		/**< 	Whether to print in the binary format 		*/
+	int 			engine 				= 0; 		/**< 	Engine used to solve the problem 			*/
 	int 			iterations 			= 0; 		/**< 	Number of iterations to run the problem 	*/
+	int 			rule 				= 0; 		/**< 	Lookup table of the rule 					*/
 	int 			size 				= 0; 		/**< 	Size of the sides of the cube 				*/
 
 	/* Read the arguments given to the program */
-	read_arguments(argc, argv, &input_filename, &iterations);
+	read_arguments(argc, argv, &input_filename, &iterations, &engine, &binary, &rule);
 	/* Read the size of the problem */
-	input_fd = fopen(input_filename, "r");
-	size = read_size(input_fd);
-	/* Create the data structure */
+	input = input_map(input_filename);
+	size = read_size(input);
+	output = output_create(STDOUT_FILENO, binary, size, input->generation + iterations);
+
+	if(engine == ENGINE_ARRAY)
+	{
+		/* Create the data structures, the scratch column can hold a full column of the cube */
+		columns = columns_create(size);
+		memset(&scratch, 0, sizeof(struct column));
+		column_reserve(&scratch, size);
+		list = (short *) calloc(2 * size, sizeof(short));
+		alloc_check(list);
+		/* Reads the input file and stores the given cells in the columns */
+		columns_read_coordinates(input, columns, size);
+		input_unmap(input);
+
+		/* Process the given problem */
+		while(iterations > 0)
+		{
+			columns_mark_neighbors(columns, &scratch, list, size);
+			columns_determine_next_generation(columns, size, rule);
+			columns_purge(columns, size);
+			iterations--;
+		}
+
+		/* Print the solution to stdout */
+		columns_print(output, columns, size);
+		output_destroy(output);
+		/* Destroy the data structures */
+		columns_destroy(columns, size);
+		free(scratch.z);
+		free(scratch.alive_neighbors);
+		free(scratch.status);
+		free(list);
+
+		return 0;
+	}
+
+	/* Create the data structures */
 	cube = cube_create(size);
+	pool = pool_create();
 	/* Reads the input file and stores the given cells in the cube */
-	read_coordinates(input_fd, cube);
-	fclose(input_fd);
+	read_coordinates(input, pool, cube, size);
+	input_unmap(input);
+	worklist = worklist_create(cube, size);
 
 	/* Process the given problem */
 	while(iterations > 0)
 	{
+		/* Add the columns where cells can be born to the ones with alive cells */
+		worklist_expand(worklist, size);
 		/* Mark the neighbors of the currently alive cells */
-		mark_neighbors(cube, size);
+		mark_neighbors(pool, cube, worklist, size);
 		/* Go over all the cells and check which ones are alive in the next generation */
-		determine_next_generation(cube, size);
+		determine_next_generation(cube, worklist, size, rule);
 		/* Go over all the cells and remove the dead ones */
-		cube_purge(cube, size);
+		cube_purge(pool, cube, worklist, size);
 		iterations--;
 	}
 
 	/* Print the solution to stdout */
-	cube_print(cube, size);
-	/* Destroy the data structure */
-	cube_destroy(cube, size);
+	cube_print(output, cube, size);
+	output_destroy(output);
+	/* Destroy the data structures */
+	cube_destroy(cube);
+	worklist_destroy(worklist);
+	pool_destroy(pool);
 
 	return 0;
 }
\ No newline at end of file